@@ -0,0 +1,83 @@
+//============================================================ (c) A.Kolesov ===
+// Сравнение ожидания flash опросом SR_BSY и сном WFI (SETTINGS_STORE_FLASH_IRQ)
+// на CH32V003. Собирается в двух вариантах (platformio.ini):
+//   pio run -e flashwait_poll -t upload -t monitor
+//   pio run -e flashwait_irq -t upload -t monitor
+// Каждый save() стирает и программирует 16 страниц. Печатаются: время save() по SysTick,
+// такты ожидания по типам операций, из них такты во сне WFI, пробуждения другими
+// прерываниями и оценка энергии. Второй проход - с прерыванием SysTick раз в 1 мс:
+// пробуждения им не должны превращать сон в опрос.
+// Ток для проверки оценки - амперметром в цепи питания во время прохода (save() в цикле).
+//------------------------------------------------------------------------------
+#include <SettingsStore.h>
+#include <debug.h>
+
+#define BENCH_SAVES 8 // save() в каждом проходе
+
+static uint8_t data[1024];                                     // 16 страниц
+static SettingsStore store(data, sizeof(data), false, true); // Без CRC, запись всегда
+static volatile uint32_t ticks = 0;                           // Прерывания SysTick
+static uint32_t tickPeriod = 0;                               // Период прерывания SysTick, такты
+
+//==============================================================================
+// Прерывание SysTick: следующее сравнение через период, CNT не сбрасывается
+//------------------------------------------------------------------------------
+extern "C" void SysTick_Handler(void) __attribute__((interrupt));
+extern "C" void SysTick_Handler(void) {
+  SysTick->CMP += tickPeriod;
+  SysTick->SR = 0;
+  ticks++;
+}
+
+//==============================================================================
+// Проход: BENCH_SAVES раз save() с измененными данными
+//  @param name - название прохода для печати
+//------------------------------------------------------------------------------
+static void benchPass(const char *name) {
+  uint32_t mhz = SystemCoreClock / 1000000;
+  SettingsStats before = store.getStats();
+  uint32_t total = 0;
+  for (uint8_t i = 0; i < BENCH_SAVES; ++i) {
+    memset(data, i, sizeof(data));
+    uint32_t start = SysTick->CNT;
+    store.save();
+    total += SysTick->CNT - start;
+  }
+  SettingsStats after = store.getStats();
+  printf("%s: save %lu us, erase %lu us, program %lu us, load %lu us, sleep %lu us, wakeups %lu, energy %lu nJ\r\n",
+         name, (unsigned long)(total / BENCH_SAVES / mhz),
+         (unsigned long)((after.busyCycles[FLASH_OP_ERASE] - before.busyCycles[FLASH_OP_ERASE]) / BENCH_SAVES / mhz),
+         (unsigned long)((after.busyCycles[FLASH_OP_PROGRAM] - before.busyCycles[FLASH_OP_PROGRAM]) / BENCH_SAVES / mhz),
+         (unsigned long)((after.busyCycles[FLASH_OP_LOAD] - before.busyCycles[FLASH_OP_LOAD]) / BENCH_SAVES / mhz),
+         (unsigned long)((after.sleepCycles - before.sleepCycles) / BENCH_SAVES / mhz),
+         (unsigned long)((after.wakeups - before.wakeups) / BENCH_SAVES), (unsigned long)after.lastSaveEnergy);
+}
+
+//==============================================================================
+int main(void) {
+  SystemCoreClockUpdate();
+  USART_Printf_Init(115200);
+#ifdef SETTINGS_STORE_FLASH_IRQ
+  printf("Flash wait: WFI (SETTINGS_STORE_FLASH_IRQ), %ldHz\r\n", SystemCoreClock);
+#else
+  printf("Flash wait: SR_BSY polling, %ldHz\r\n", SystemCoreClock);
+#endif
+
+  // SysTick - свободный счетчик от HCLK (Delay_*() SDK его останавливают и не используются)
+  SysTick->CTLR = 0;
+  SysTick->SR = 0;
+  SysTick->CNT = 0;
+  SysTick->CTLR = 0x5; // STE | STCLK (HCLK)
+
+  benchPass("quiet");
+
+  tickPeriod = SystemCoreClock / 1000;
+  SysTick->CMP = SysTick->CNT + tickPeriod;
+  SysTick->CTLR |= 0x2; // STIE
+  NVIC_EnableIRQ(SysTicK_IRQn);
+  benchPass("systick 1 ms");
+  printf("SysTick interrupts: %lu\r\n", (unsigned long)ticks);
+
+  while (1)
+    ;
+}
@@ -0,0 +1,72 @@
+// AppConfig.h
+// Сгенерировано ssgen из AppConfig.schema - не редактировать вручную.
+#ifndef APP_CONFIG_GEN_H
+#define APP_CONFIG_GEN_H
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef SSGEN_BITS_DEFINED
+#define SSGEN_BITS_DEFINED
+// Чтение/запись битового поля шириной width с бита offset массива p
+static inline uint32_t ssgenGetBits(const uint8_t *p, unsigned offset, unsigned width) {
+  uint32_t v = 0;
+  for (unsigned i = 0; i < width; ++i, ++offset) {
+    v |= (uint32_t)(p[offset >> 3] >> (offset & 7) & 1) << i;
+  }
+  return v;
+}
+
+static inline void ssgenSetBits(uint8_t *p, unsigned offset, unsigned width, uint32_t v) {
+  for (unsigned i = 0; i < width; ++i, ++offset) {
+    uint8_t mask = (uint8_t)(1u << (offset & 7));
+    p[offset >> 3] = (v >> i & 1) ? (uint8_t)(p[offset >> 3] | mask) : (uint8_t)(p[offset >> 3] & ~mask);
+  }
+}
+#endif
+
+// Размер 23 байт, во flash 64 байт (1 стр. по 64 байт)
+struct __attribute__((packed)) AppConfig {
+  static constexpr uint32_t SCHEMA_HASH = 0x2FB2B25Du; // Хеш схемы (раскладки)
+  static constexpr uint32_t SIZE = 23; // sizeof()
+  static constexpr uint32_t ALIGNED_SIZE = 64; // Размер во flash
+  static constexpr bool USE_CRC = true; // Параметр useCrc для SettingsStore
+
+  static constexpr float GAIN_DEFAULT = 1.5f;
+  static constexpr int16_t FREQ_DEFAULT = 1050;
+  static constexpr uint8_t VOLUME_DEFAULT = 7u;
+  static constexpr uint8_t IDX_DEFAULT = 5u;
+  static constexpr bool MUTE_DEFAULT = false;
+  static constexpr uint8_t BAND_DEFAULT = 2u;
+
+  uint32_t schemaHash = SCHEMA_HASH; // Хеш схемы, с которой записаны данные
+  float gain = GAIN_DEFAULT;
+  int16_t freq = FREQ_DEFAULT;
+  uint8_t volume = VOLUME_DEFAULT;
+  uint8_t idx = IDX_DEFAULT;
+  uint8_t name[8] = {0x72, 0x61, 0x64, 0x69, 0x6F, 0x00, 0x00, 0x00};
+  uint8_t bits[1] = {0x04}; // mute:1@0, band:3@1
+  uint16_t crc = 0; // CRC16, заполняется SettingsStore::save()
+
+  float getGain() const { return gain; }
+  void setGain(float v) { gain = v; }
+  int16_t getFreq() const { return freq; }
+  void setFreq(int16_t v) { freq = v; }
+  uint8_t getVolume() const { return volume; }
+  void setVolume(uint8_t v) { volume = v; }
+  uint8_t getIdx() const { return idx; }
+  void setIdx(uint8_t v) { idx = v; }
+  const uint8_t *getName() const { return name; }
+  void setName(const void *v, size_t len) {
+    memset(name, 0, sizeof(name));
+    memcpy(name, v, len < sizeof(name) ? len : sizeof(name));
+  }
+  bool getMute() const { return ssgenGetBits(bits, 0, 1) != 0; }
+  void setMute(bool v) { ssgenSetBits(bits, 0, 1, (uint32_t)v); }
+  uint8_t getBand() const { return (uint8_t)ssgenGetBits(bits, 1, 3); }
+  void setBand(uint8_t v) { ssgenSetBits(bits, 1, 3, (uint32_t)v); }
+};
+
+static_assert(sizeof(AppConfig) == AppConfig::SIZE, "AppConfig layout mismatch");
+
+#endif // APP_CONFIG_GEN_H
@@ -0,0 +1,118 @@
+// AppConfigCodec.h
+// Сгенерировано ssgen из AppConfig.schema - не редактировать вручную.
+#ifndef APP_CONFIG_CODEC_GEN_H
+#define APP_CONFIG_CODEC_GEN_H
+
+#include <stdint.h>
+#include <string.h>
+
+struct AppConfigCodec {
+  static constexpr uint32_t SCHEMA_HASH = 0x2FB2B25Du;
+  static constexpr uint32_t SIZE = 23;
+  static constexpr uint32_t ALIGNED_SIZE = 64;
+
+  struct Values {
+    uint8_t volume;
+    int16_t freq;
+    uint8_t idx;
+    bool mute;
+    uint8_t band;
+    float gain;
+    uint8_t name[8];
+  };
+
+  // Значения по умолчанию
+  static Values defaults() {
+    Values v;
+    v.volume = 7u;
+    v.freq = 1050;
+    v.idx = 5u;
+    v.mute = false;
+    v.band = 2u;
+    v.gain = 1.5f;
+    static const uint8_t nameDefault[8] = {0x72, 0x61, 0x64, 0x69, 0x6F, 0x00, 0x00, 0x00};
+    memcpy(v.name, nameDefault, sizeof(v.name));
+    return v;
+  }
+
+  // CRC16-CCITT, как SettingsStore::crc16()
+  static uint16_t crc16(const uint8_t *p, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; ++i) {
+      crc ^= (uint16_t)(p[i] << 8);
+      for (int j = 0; j < 8; ++j) {
+        crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+      }
+    }
+    return crc;
+  }
+
+  static void put(uint8_t *p, uint32_t v, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      p[i] = (uint8_t)(v >> (8 * i));
+    }
+  }
+
+  static uint32_t get(const uint8_t *p, size_t n) {
+    uint32_t v = 0;
+    for (size_t i = 0; i < n; ++i) {
+      v |= (uint32_t)p[i] << (8 * i);
+    }
+    return v;
+  }
+
+  // Образ области настроек (ALIGNED_SIZE байт), как после SettingsStore::save()
+  static void encode(const Values &v, uint8_t *img) {
+    memset(img, 0xFF, ALIGNED_SIZE);
+    memset(img, 0, SIZE);
+    uint32_t raw;
+    put(img, SCHEMA_HASH, 4);
+    memcpy(&raw, &v.gain, 4);
+    put(img + 4, raw, 4);
+    put(img + 8, (uint32_t)v.freq, 2);
+    put(img + 10, (uint32_t)v.volume, 1);
+    put(img + 11, (uint32_t)v.idx, 1);
+    memcpy(img + 12, v.name, 8);
+    raw = (uint32_t)v.mute;
+    for (unsigned i = 0; i < 1; ++i) {
+      img[20 + (0 + i) / 8] |= (uint8_t)((raw >> i & 1) << ((0 + i) % 8));
+    }
+    raw = (uint32_t)v.band;
+    for (unsigned i = 0; i < 3; ++i) {
+      img[20 + (1 + i) / 8] |= (uint8_t)((raw >> i & 1) << ((1 + i) % 8));
+    }
+    (void)raw;
+    put(img + 21, crc16(img, 21), 2);
+  }
+
+  // Разбор образа; false - не совпала CRC или хеш схемы
+  static bool decode(const uint8_t *img, Values &v) {
+    if (get(img + 21, 2) != crc16(img, 21)) {
+      return false;
+    }
+    if (get(img, 4) != SCHEMA_HASH) {
+      return false;
+    }
+    uint32_t raw;
+    raw = get(img + 4, 4);
+    memcpy(&v.gain, &raw, 4);
+    v.freq = (int16_t)get(img + 8, 2);
+    v.volume = (uint8_t)get(img + 10, 1);
+    v.idx = (uint8_t)get(img + 11, 1);
+    memcpy(v.name, img + 12, 8);
+    raw = 0;
+    for (unsigned i = 0; i < 1; ++i) {
+      raw |= (uint32_t)(img[20 + (0 + i) / 8] >> ((0 + i) % 8) & 1) << i;
+    }
+    v.mute = raw != 0;
+    raw = 0;
+    for (unsigned i = 0; i < 3; ++i) {
+      raw |= (uint32_t)(img[20 + (1 + i) / 8] >> ((1 + i) % 8) & 1) << i;
+    }
+    v.band = (uint8_t)raw;
+    (void)raw;
+    return true;
+  }
+};
+
+#endif // APP_CONFIG_CODEC_GEN_H
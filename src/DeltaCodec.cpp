@@ -0,0 +1,274 @@
+//============================================================= (c) A.Kolesov ==
+// DeltaCodec.cpp
+// Кодек записей журналов: zig-zag varint разности с базой на каждой странице,
+// дозапись во flash по словам.
+//
+// Пример (запись: время и показание, страницы пишутся подряд от 0x08002000):
+//   DeltaEncoder enc(2);
+//   uint32_t addr = 0x08002000;          // После сброса - последняя начатая страница (findPage())
+//   enc.open(addr);                      // Продолжение записи в страницу
+//   int32_t rec[2] = {now, temperature};
+//   if (!enc.add(rec)) {                 // Страница заполнена
+//     addr += FLASH_PAGE_SIZE;
+//     SettingsFlash::unlock();
+//     SettingsFlash::erasePage(addr);
+//     SettingsFlash::lock();
+//     enc.open(addr);
+//     enc.add(rec);
+//   }
+//   ...
+//   DeltaDecoder dec(2);
+//   int32_t page = DeltaDecoder::findPage(0x08002000, 32, from);
+//   for (; page >= 0 && page < 32 && dec.seek(SettingsFlash::ptr(0x08002000 + page * FLASH_PAGE_SIZE)); ++page) {
+//     while (dec.next(rec)) { ... }
+//   }
+//------------------------------------------------------------------------------
+
+#include "DeltaCodec.h"
+
+#define DC_VARINT_MAX 5 // Байт varint для 32 бит
+
+//==============================================================================
+// Zig-zag: малые по модулю числа любого знака - в малые беззнаковые
+//------------------------------------------------------------------------------
+static inline uint32_t zigzag(uint32_t v) {
+  return (v << 1) ^ (uint32_t)((int32_t)v >> 31);
+}
+
+static inline uint32_t unzigzag(uint32_t v) {
+  return (v >> 1) ^ (0U - (v & 1));
+}
+
+//==============================================================================
+// Конструктор кодера. До open() запись невозможна.
+//  @param fields - полей в записи, 1..DC_MAX_FIELDS
+//------------------------------------------------------------------------------
+DeltaEncoder::DeltaEncoder(uint8_t fields) : addr(0), used(0), count(0), opened(false) {
+  this->fields = fields > DC_MAX_FIELDS ? DC_MAX_FIELDS : (fields ? fields : 1);
+}
+
+//==============================================================================
+// Начало записи в страницу. Страница должна быть стерта или начата этим же кодером
+// (тогда записи дописываются после имеющихся - так запись продолжается после сброса).
+// Если после последней записи страница не стерта (прервана запись), страница считается
+// заполненной: add() вернет false, и запись перейдет на следующую страницу.
+//  @param pageAddr - адрес начала страницы
+//  @return         - false, если страница не во flash или начата с другим числом полей
+//------------------------------------------------------------------------------
+bool DeltaEncoder::open(uint32_t pageAddr) {
+  this->opened = false;
+  if (pageAddr % FLASH_PAGE_SIZE != 0 || !SettingsFlash::valid(pageAddr, FLASH_PAGE_SIZE)) {
+    return false;
+  }
+  const uint8_t *page = SettingsFlash::ptr(pageAddr);
+  const uint8_t *tail = page; // Конец записей
+  this->count = 0;
+  this->used = 0;
+  if (((const DeltaPageHeader *)page)->fields != DC_BLANK) {
+    DeltaDecoder dec(this->fields);
+    if (!dec.seek(page)) {
+      return false; // Страница другого журнала
+    }
+    this->prev[0] = ((const DeltaPageHeader *)page)->base; // Если записей еще нет
+    for (uint8_t f = 1; f < this->fields; ++f) {
+      this->prev[f] = 0;
+    }
+    while (dec.next(this->prev)) {
+      this->count++;
+    }
+    tail = dec.tell();
+    this->used = (uint8_t)(tail - page);
+  }
+  for (const uint8_t *p = tail; p < page + FLASH_PAGE_SIZE; ++p) {
+    if (*p != 0xFF) {
+      this->used = FLASH_PAGE_SIZE; // Прерванная запись: дописывать поверх нельзя
+      break;
+    }
+  }
+  this->addr = pageAddr;
+  this->opened = true;
+  return true;
+}
+
+//==============================================================================
+// Программирование слов полусловами (стертые 0xFFFF пропускаются). Первое полуслово -
+// последним: пока оно не записано, слово для декодера стерто.
+//  @param at   - адрес (выровнен на слово)
+//  @param data - данные
+//  @param len  - байт, кратно 4
+//------------------------------------------------------------------------------
+void DeltaEncoder::program(uint32_t at, const uint8_t *data, uint8_t len) {
+  SettingsFlash::unlock();
+  for (uint8_t i = 2; i < len; i += 2) {
+    uint16_t value = (uint16_t)(data[i] | data[i + 1] << 8);
+    if (value != 0xFFFF) {
+      SettingsFlash::programHalfWord(at + i, value);
+    }
+  }
+  SettingsFlash::programHalfWord(at, (uint16_t)(data[0] | data[1] << 8));
+  SettingsFlash::lock();
+}
+
+//==============================================================================
+// Запись сразу во flash. Первая запись страницы сначала пишет заголовок с base.
+//  @param values - поля записи
+//  @return       - false, если запись не помещается (пора открыть следующую страницу)
+//                  или страница не открыта
+//------------------------------------------------------------------------------
+bool DeltaEncoder::add(const int32_t *values) {
+  if (!this->opened) {
+    return false;
+  }
+  bool first = this->used == 0; // Заголовок еще не записан
+  if (first) {
+    this->prev[0] = values[0];
+    for (uint8_t f = 1; f < this->fields; ++f) {
+      this->prev[f] = 0;
+    }
+  }
+
+  uint8_t rec[(1 + DC_RECORD_MAX + 3) & ~3];
+  uint8_t len = 1;
+  for (uint8_t f = 0; f < this->fields; ++f) {
+    uint32_t v = zigzag((uint32_t)values[f] - (uint32_t)this->prev[f]);
+    while (v >= 0x80) {
+      rec[len++] = (uint8_t)(v | 0x80);
+      v >>= 7;
+    }
+    rec[len++] = (uint8_t)v;
+  }
+  rec[0] = (uint8_t)(len - 1);
+  uint8_t size = (uint8_t)((len + 3) & ~3);
+  memset(rec + len, 0xFF, size - len);
+
+  uint8_t at = first ? DC_HEADER : this->used;
+  if (at + size > FLASH_PAGE_SIZE) {
+    return false;
+  }
+  if (first) {
+    DeltaPageHeader hdr;
+    hdr.base = values[0];
+    hdr.fields = this->fields;
+    memset(hdr.pad, 0xFF, sizeof(hdr.pad));
+    // fields - во втором слове, оно пишется последним: без него base не видна
+    program(this->addr, (const uint8_t *)&hdr, 4);
+    program(this->addr + 4, (const uint8_t *)&hdr + 4, 4);
+  }
+  program(this->addr + at, rec, size);
+  memcpy(this->prev, values, this->fields * sizeof(int32_t));
+  this->used = (uint8_t)(at + size);
+  this->count++;
+  return true;
+}
+
+//==============================================================================
+// Конструктор декодера
+//  @param fields - полей в записи (как у кодера)
+//------------------------------------------------------------------------------
+DeltaDecoder::DeltaDecoder(uint8_t fields) : pos(nullptr), end(nullptr) {
+  this->fields = fields > DC_MAX_FIELDS ? DC_MAX_FIELDS : (fields ? fields : 1);
+}
+
+//==============================================================================
+// Начало распаковки страницы (обычно прямо во flash - SettingsFlash::ptr())
+//  @param page - начало страницы (выровнено на слово)
+//  @return     - false, если страница не начата, заголовок не подходит или page == nullptr
+//------------------------------------------------------------------------------
+bool DeltaDecoder::seek(const uint8_t *page) {
+  const DeltaPageHeader *hdr = (const DeltaPageHeader *)page;
+  this->pos = this->end = nullptr;
+  if (hdr == nullptr || hdr->fields != this->fields) {
+    return false;
+  }
+  this->pos = page + DC_HEADER;
+  this->end = page + FLASH_PAGE_SIZE;
+  this->prev[0] = hdr->base;
+  for (uint8_t f = 1; f < this->fields; ++f) {
+    this->prev[f] = 0;
+  }
+  return true;
+}
+
+//==============================================================================
+// Следующая запись страницы. Записи кончаются на первом стертом слове (len == 0xFF)
+// или в конце страницы; на поврежденной записи распаковка останавливается на ней.
+//  @param values - поля записи (fields значений)
+//  @return       - false, если записи кончились или данные повреждены
+//------------------------------------------------------------------------------
+bool DeltaDecoder::next(int32_t *values) {
+  if (this->pos >= this->end) {
+    return false;
+  }
+  uint8_t len = this->pos[0];
+  const uint8_t *data = this->pos + 1;
+  const uint8_t *stop = data + len;
+  if (len == 0 || len > DC_RECORD_MAX || stop > this->end) {
+    return false; // Стертое слово (DC_BLANK) или повреждение
+  }
+  int32_t rec[DC_MAX_FIELDS];
+  for (uint8_t f = 0; f < this->fields; ++f) {
+    uint32_t v = 0;
+    uint8_t shift = 0;
+    uint8_t b;
+    do {
+      if (data >= stop || shift >= 7 * DC_VARINT_MAX) {
+        return false;
+      }
+      b = *data++;
+      v |= (uint32_t)(b & 0x7F) << shift;
+      shift += 7;
+    } while (b & 0x80);
+    rec[f] = (int32_t)((uint32_t)this->prev[f] + unzigzag(v));
+  }
+  if (data != stop) {
+    return false;
+  }
+  memcpy(this->prev, rec, this->fields * sizeof(int32_t));
+  memcpy(values, rec, this->fields * sizeof(int32_t));
+  this->pos += (1 + len + 3) & ~3;
+  return true;
+}
+
+//==============================================================================
+// Двоичный поиск страницы по base: страницы пишутся подряд, поле 0 не убывает.
+// Читаются только заголовки страниц. Последняя начатая страница (key = INT32_MAX) - та,
+// в которую после сброса продолжается запись (DeltaEncoder::open()).
+//  @param startAddr - адрес первой страницы
+//  @param pages     - количество страниц
+//  @param key       - искомое значение поля 0
+//  @return          - последняя записанная страница с base <= key (с нее начинать
+//                     распаковку); 0, если key меньше base первой; -1, если страниц нет
+//                     (или они не во flash)
+//------------------------------------------------------------------------------
+int32_t DeltaDecoder::findPage(uint32_t startAddr, uint16_t pages, int32_t key) {
+  if (!SettingsFlash::valid(startAddr, (size_t)pages * FLASH_PAGE_SIZE)) {
+    return -1;
+  }
+  // Записанные страницы идут подряд с начала: сначала ищется их количество
+  uint16_t lo = 0, hi = pages;
+  while (lo < hi) {
+    uint16_t mid = (uint16_t)((lo + hi) / 2);
+    const DeltaPageHeader *hdr = (const DeltaPageHeader *)SettingsFlash::ptr(startAddr + mid * FLASH_PAGE_SIZE);
+    if (hdr->fields != DC_BLANK) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo == 0) {
+    return -1;
+  }
+  uint16_t written = lo;
+  lo = 0;
+  hi = written;
+  while (hi - lo > 1) {
+    uint16_t mid = (uint16_t)((lo + hi) / 2);
+    const DeltaPageHeader *hdr = (const DeltaPageHeader *)SettingsFlash::ptr(startAddr + mid * FLASH_PAGE_SIZE);
+    if (hdr->base <= key) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
@@ -0,0 +1,78 @@
+#ifndef DELTA_CODEC_H
+#define DELTA_CODEC_H
+
+// Сжатие записей журналов во flash: разности с предыдущей записью в zig-zag varint.
+// Метки времени и медленно меняющиеся показания занимают 1-2 байта вместо 4.
+//
+// Запись - до DC_MAX_FIELDS полей int32. Страница - журнал с дозаписью, каждая
+// страница самодостаточна:
+//   заголовок: base (4) | fields (1) | 0xFF (3)
+//   записи:    len (1) | данные (len байт) | 0xFF до конца слова
+// - base - поле 0 первой записи страницы (базовое значение), разности считаются от
+//   {base, 0, 0, ...}, поэтому декодирование можно начать с любой страницы;
+// - заголовок пишется один раз, с первой записью страницы, и потом не меняется: счетчиков
+//   записей в нем нет;
+// - add() сразу программирует слова записи во flash (полусловами, без стирания), полуслово
+//   с len - последним: прерванная сбросом запись не видна. len - 1..DC_RECORD_MAX, никогда
+//   не 0xFF, поэтому декодер останавливается на первом стертом слове;
+// - по base страниц (поле 0 - обычно время) нужная страница ищется двоичным поиском
+//   без распаковки (findPage()).
+// Память не выделяется: кодер держит позицию на странице и предыдущую запись, декодер -
+// только указатели. При сбросе теряется только прерванная запись.
+
+#include "SettingsFlash.h"
+#include <string.h>
+
+#ifndef DC_MAX_FIELDS
+#define DC_MAX_FIELDS 4 // Максимум полей в записи
+#endif
+
+#define DC_HEADER 8                                  // Заголовок страницы
+#define DC_DATA_MAX (FLASH_PAGE_SIZE - DC_HEADER)    // Место под записи на странице
+#define DC_RECORD_MAX (5 * DC_MAX_FIELDS)            // Максимум байт данных записи (varint int32 - до 5 байт)
+#define DC_BLANK 0xFF                                // fields / len стертого слова
+
+static_assert(((1 + DC_RECORD_MAX + 3) & ~3) <= DC_DATA_MAX, "DC_MAX_FIELDS: record does not fit a page");
+
+// Заголовок страницы
+struct DeltaPageHeader {
+  int32_t base;   // Поле 0 первой записи
+  uint8_t fields; // Полей в записи (DC_BLANK - страница не начата)
+  uint8_t pad[3]; // 0xFF
+};
+
+class DeltaEncoder {
+  private:
+  uint32_t addr;               // Адрес текущей страницы
+  uint8_t used;                // Занято байт страницы (кратно слову; 0 - заголовок не записан)
+  uint16_t count;              // Записей на странице
+  int32_t prev[DC_MAX_FIELDS]; // Предыдущая запись
+  uint8_t fields;              // Полей в записи
+  bool opened;                 // open() прошел успешно
+
+  public:
+  DeltaEncoder(uint8_t fields);
+  bool open(uint32_t pageAddr);        // Начало или продолжение (после сброса) записи в страницу
+  bool add(const int32_t *values);     // Запись сразу во flash; false - не помещается или страница не открыта
+  uint16_t getCount(void) const { return count; } // Записей на странице
+
+  private:
+  void program(uint32_t at, const uint8_t *data, uint8_t len); // Программирование слов (len кратно 4)
+};
+
+class DeltaDecoder {
+  private:
+  const uint8_t *pos;          // Следующая запись
+  const uint8_t *end;          // Конец страницы
+  int32_t prev[DC_MAX_FIELDS]; // Предыдущая запись
+  uint8_t fields;              // Полей в записи
+
+  public:
+  DeltaDecoder(uint8_t fields);
+  bool seek(const uint8_t *page);  // Начало распаковки страницы; false - страница пуста или неверна
+  bool next(int32_t *values);      // Следующая запись; false - записи на странице кончились
+  const uint8_t *tell(void) const { return pos; } // Позиция после последней прочитанной записи
+  static int32_t findPage(uint32_t startAddr, uint16_t pages, int32_t key); // Страница, где может быть key
+};
+
+#endif // DELTA_CODEC_H
@@ -0,0 +1,344 @@
+//============================================================= (c) A.Kolesov ==
+// FlashKv.cpp
+// Журнальное хранилище "ключ - значение" во flash с фильтрами Блума в заголовках
+// страниц: поиск отсутствующего ключа обычно не просматривает ни одной страницы.
+//
+// Пример:
+//   FlashKv kv(0x08003000, 16); // 16 страниц под настройками
+//   kv.open();
+//   kv.set(KEY_BAUD, &baud, sizeof(baud));
+//   ...
+//   uint16_t len;
+//   const uint8_t *p = kv.find(KEY_BAUD, &len); // Прямо во flash, nullptr - ключа нет
+//------------------------------------------------------------------------------
+
+#include "FlashKv.h"
+
+#define FKV_FLAGS 2 // Смещение flags
+#define FKV_BLOOM 4 // Смещение фильтра
+
+//==============================================================================
+// Конструктор
+//  @param startAddr - адрес первой страницы (кратен FLASH_PAGE_SIZE)
+//  @param pages     - количество страниц, не меньше 2
+//  @param useBloom  - пропускать страницы по фильтрам (false - только для сравнения)
+//------------------------------------------------------------------------------
+FlashKv::FlashKv(uint32_t startAddr, uint16_t pages, bool useBloom)
+    : startAddr(startAddr), pages(pages), useBloom(useBloom), pagesScanned(0) {
+  this->headPage = pages ? pages - 1 : 0;
+  this->headOff = FLASH_PAGE_SIZE;
+  this->headSeq = FKV_SEQ_MOD - 1;
+}
+
+//==============================================================================
+// Поиск конца журнала по содержимому flash (после сброса): последняя страница -
+// занятая, за которой идет стертая или страница не со следующим номером.
+//  @return - false, если параметры неверны или страницы не во flash
+//------------------------------------------------------------------------------
+bool FlashKv::open() {
+  if (this->pages < 2 || (this->startAddr % FLASH_PAGE_SIZE) ||
+      !SettingsFlash::valid(this->startAddr, (size_t)this->pages * FLASH_PAGE_SIZE)) {
+    return false;
+  }
+  this->headPage = this->pages - 1;
+  this->headOff = FLASH_PAGE_SIZE; // Журнал пуст: первая запись начнет страницу 0
+  this->headSeq = FKV_SEQ_MOD - 1;
+  for (uint16_t p = 0; p < this->pages; ++p) {
+    uint16_t seq = read16(pageAddr(p));
+    if (seq == FKV_FREE) {
+      continue;
+    }
+    uint16_t nextSeq = read16(pageAddr((p + 1) % this->pages));
+    if (nextSeq != (seq + 1) % FKV_SEQ_MOD) {
+      this->headPage = p;
+      this->headSeq = seq;
+      scanPage(p, FKV_FREE, &this->headOff);
+      break;
+    }
+  }
+  return true;
+}
+
+//==============================================================================
+// Значение ключа прямо во flash, без копирования
+//  @param key - ключ
+//  @param len - сюда пишется длина значения (если не nullptr)
+//  @return    - указатель на значение; nullptr, если ключа нет или он удален
+//------------------------------------------------------------------------------
+const uint8_t *FlashKv::find(uint16_t key, uint16_t *len) {
+  uint32_t addr = findRecord(key);
+  if (addr == 0) {
+    return nullptr;
+  }
+  uint16_t recLen = read16(addr + 2);
+  if (recLen == FKV_TOMBSTONE) {
+    return nullptr;
+  }
+  if (len) {
+    *len = recLen;
+  }
+  return SettingsFlash::ptr(addr) + FKV_RECORD_HEADER; // Пустое значение в конце страницы - указатель за ее конец
+}
+
+//==============================================================================
+// Копия значения ключа в буфер
+//  @param key  - ключ
+//  @param buf  - буфер
+//  @param size - размер буфера (лишнее не копируется)
+//  @return     - длина значения; -1, если ключа нет
+//------------------------------------------------------------------------------
+int16_t FlashKv::get(uint16_t key, void *buf, uint16_t size) {
+  uint16_t len;
+  const uint8_t *value = find(key, &len);
+  if (value == nullptr) {
+    return -1;
+  }
+  memcpy(buf, value, len < size ? len : size);
+  return (int16_t)len;
+}
+
+//==============================================================================
+// Запись значения. Если значение не изменилось, во flash ничего не пишется.
+//  @param key  - ключ, кроме FKV_FREE
+//  @param data - значение
+//  @param len  - длина, не больше FKV_MAX_VALUE
+//  @return     - false, если параметры неверны или место кончилось
+//------------------------------------------------------------------------------
+bool FlashKv::set(uint16_t key, const void *data, uint16_t len) {
+  if (key == FKV_FREE || len > FKV_MAX_VALUE) {
+    return false;
+  }
+  uint16_t oldLen;
+  const uint8_t *old = find(key, &oldLen);
+  if (old && oldLen == len && ss_compare(old, data, len) == 0) {
+    return true;
+  }
+  return append(key, data, len);
+}
+
+//==============================================================================
+// Удаление ключа (запись-отметка)
+//  @return - false, если место кончилось
+//------------------------------------------------------------------------------
+bool FlashKv::remove(uint16_t key) {
+  if (find(key) == nullptr) {
+    return true;
+  }
+  return append(key, nullptr, FKV_TOMBSTONE);
+}
+
+//==============================================================================
+// Чтение полуслова из flash
+//------------------------------------------------------------------------------
+uint16_t FlashKv::read16(uint32_t addr) const {
+  uint16_t value;
+  memcpy(&value, SettingsFlash::ptr(addr), 2);
+  return value;
+}
+
+//==============================================================================
+// Биты ключа в фильтре: FKV_BLOOM_HASHES позиций из перемешанного ключа
+// (только сдвиги, сложения и xor - без умножения на RV32EC)
+//------------------------------------------------------------------------------
+uint32_t FlashKv::bloomMask(uint16_t key) const {
+  uint32_t x = key;
+  x += x << 10;
+  x ^= x >> 6;
+  x += x << 3;
+  x ^= x >> 11;
+  x += x << 15;
+  uint32_t mask = 0;
+  for (uint8_t i = 0; i < FKV_BLOOM_HASHES; ++i) {
+    mask |= 1UL << ((x >> (i * 8)) & (FKV_BLOOM_BITS - 1));
+  }
+  return mask;
+}
+
+//==============================================================================
+// Проверка фильтра страницы: записанный ключ сбрасывает свои биты в 0
+//  @return - false, если ключа на странице точно нет
+//------------------------------------------------------------------------------
+bool FlashKv::bloomMayContain(uint16_t page, uint32_t mask) const {
+  uint32_t addr = pageAddr(page);
+  if (read16(addr + FKV_FLAGS) != FKV_FREE) {
+    return true; // Фильтр страницы недостоверен
+  }
+  uint32_t bloom = 0;
+  memcpy(&bloom, SettingsFlash::ptr(addr + FKV_BLOOM), FKV_BLOOM_BYTES);
+  return (bloom & mask) == 0;
+}
+
+//==============================================================================
+// Поиск последней записи ключа: от последней страницы к первой, страницы, фильтр
+// которых ключ исключает, не просматриваются.
+//  @return - адрес записи; 0, если записей ключа нет
+//------------------------------------------------------------------------------
+uint32_t FlashKv::findRecord(uint16_t key) {
+  uint32_t mask = bloomMask(key);
+  uint16_t page = this->headPage;
+  for (uint16_t i = 0; i < this->pages; ++i) {
+    if (read16(pageAddr(page)) == FKV_FREE) {
+      break; // Дальше журнал не идет
+    }
+    if (!this->useBloom || bloomMayContain(page, mask)) {
+      this->pagesScanned++;
+      uint16_t end;
+      uint32_t addr = scanPage(page, key, &end);
+      if (addr) {
+        return addr;
+      }
+    }
+    page = page ? page - 1 : this->pages - 1;
+  }
+  return 0;
+}
+
+//==============================================================================
+// Просмотр записей страницы
+//  @param page - номер страницы
+//  @param key  - искомый ключ (FKV_FREE - только поиск конца)
+//  @param end  - сюда пишется смещение свободного места
+//  @return     - адрес последней записи ключа на странице; 0 - нет
+//------------------------------------------------------------------------------
+uint32_t FlashKv::scanPage(uint16_t page, uint16_t key, uint16_t *end) const {
+  uint32_t addr = pageAddr(page);
+  uint32_t found = 0;
+  uint16_t off = FKV_HEADER;
+  while (off + FKV_RECORD_HEADER <= FLASH_PAGE_SIZE) {
+    uint16_t len = read16(addr + off + 2);
+    if (len == FKV_FREE) {
+      break;
+    }
+    uint16_t dataLen = len == FKV_TOMBSTONE ? 0 : len;
+    if (dataLen > FKV_MAX_VALUE) {
+      off = FLASH_PAGE_SIZE; // Поврежденная запись: страница больше не дописывается
+      break;
+    }
+    if (key != FKV_FREE && read16(addr + off) == key) {
+      found = addr + off; // Запись, прерванная сбросом (key = FKV_FREE), не совпадет
+    }
+    off += FKV_RECORD_HEADER + ((dataLen + 1) & ~1);
+  }
+  *end = off;
+  return found;
+}
+
+//==============================================================================
+// Дозапись записи в журнал, при необходимости - на следующую страницу
+//  @param len - длина значения или FKV_TOMBSTONE
+//------------------------------------------------------------------------------
+bool FlashKv::append(uint16_t key, const void *data, uint16_t len) {
+  uint16_t dataLen = len == FKV_TOMBSTONE ? 0 : len;
+  uint16_t need = FKV_RECORD_HEADER + ((dataLen + 1) & ~1);
+  if (this->headOff + need > FLASH_PAGE_SIZE) {
+    if (!nextPage() || this->headOff + need > FLASH_PAGE_SIZE) {
+      return false; // После переноса действующих записей места все равно нет
+    }
+  }
+  return write(key, data, len);
+}
+
+//==============================================================================
+// Запись в текущую страницу (место проверено): фильтр, len, данные, key
+//------------------------------------------------------------------------------
+bool FlashKv::write(uint16_t key, const void *data, uint16_t len) {
+  uint16_t dataLen = len == FKV_TOMBSTONE ? 0 : len;
+  uint32_t addr = pageAddr(this->headPage) + this->headOff;
+  const uint8_t *src = (const uint8_t *)data;
+  SettingsFlash::unlock();
+  clearBloom(this->headPage, bloomMask(key));
+  SettingsFlash::programHalfWord(addr + 2, len);
+  for (uint16_t i = 0; i < dataLen; i += 2) {
+    uint16_t value = src[i];
+    value |= (uint16_t)(i + 1 < dataLen ? src[i + 1] : 0xFF) << 8;
+    SettingsFlash::programHalfWord(addr + FKV_RECORD_HEADER + i, value);
+  }
+  SettingsFlash::programHalfWord(addr, key);
+  SettingsFlash::lock();
+  this->headOff += FKV_RECORD_HEADER + ((dataLen + 1) & ~1);
+  return true;
+}
+
+//==============================================================================
+// Переход на следующую страницу. Если после этого не осталось стертых страниц,
+// самая старая освобождается сразу: место для следующего перехода есть всегда.
+//  @return - false, если действующие записи не помещаются (хранилище заполнено)
+//------------------------------------------------------------------------------
+bool FlashKv::nextPage() {
+  uint16_t next = (this->headPage + 1) % this->pages;
+  if (read16(pageAddr(next)) != FKV_FREE && !collect(next)) {
+    return false; // Освобождение было прервано сбросом и не помещается в текущую страницу
+  }
+  startPage(next);
+  uint16_t oldest = (next + 1) % this->pages;
+  if (read16(pageAddr(oldest)) != FKV_FREE) {
+    return collect(oldest);
+  }
+  return true;
+}
+
+//==============================================================================
+// Освобождение самой старой страницы: действующие записи (последние для своего ключа)
+// дописываются в текущую страницу, удаленные ключи отбрасываются (старше записей нет),
+// затем страница стирается.
+//  @return - false, если записи не поместились (страница не стирается)
+//------------------------------------------------------------------------------
+bool FlashKv::collect(uint16_t page) {
+  uint32_t addr = pageAddr(page);
+  uint16_t end;
+  scanPage(page, FKV_FREE, &end);
+  for (uint16_t off = FKV_HEADER; off < end;) {
+    uint16_t key = read16(addr + off);
+    uint16_t len = read16(addr + off + 2);
+    uint16_t dataLen = len == FKV_TOMBSTONE ? 0 : len;
+    uint16_t need = FKV_RECORD_HEADER + ((dataLen + 1) & ~1);
+    if (key != FKV_FREE && len != FKV_TOMBSTONE && findRecord(key) == addr + off) {
+      if (this->headOff + need > FLASH_PAGE_SIZE) {
+        return false;
+      }
+      write(key, SettingsFlash::ptr(addr + off) + FKV_RECORD_HEADER, len);
+    }
+    off += need;
+  }
+  SettingsFlash::unlock();
+  SettingsFlash::erasePage(addr);
+  SettingsFlash::lock();
+  return true;
+}
+
+//==============================================================================
+// Начало новой страницы: стирание (если не стерта) и запись seq
+//------------------------------------------------------------------------------
+void FlashKv::startPage(uint16_t page) {
+  uint32_t addr = pageAddr(page);
+  this->headSeq = (this->headSeq + 1) % FKV_SEQ_MOD;
+  SettingsFlash::unlock();
+  if (!ss_blank(SettingsFlash::ptr(addr), FLASH_PAGE_SIZE)) {
+    SettingsFlash::erasePage(addr);
+  }
+  SettingsFlash::programHalfWord(addr, this->headSeq);
+  SettingsFlash::lock();
+  this->headPage = page;
+  this->headOff = FKV_HEADER;
+}
+
+//==============================================================================
+// Сброс битов ключа в фильтре страницы (запись разблокирована). Полуслово фильтра
+// программируется повторно; если биты не сбросились, фильтр страницы отключается.
+//------------------------------------------------------------------------------
+void FlashKv::clearBloom(uint16_t page, uint32_t mask) {
+  uint32_t addr = pageAddr(page);
+  for (uint8_t i = 0; i < FKV_BLOOM_BYTES / 2; ++i) {
+    uint32_t bloomAddr = addr + FKV_BLOOM + i * 2;
+    uint16_t bits = (uint16_t)(mask >> (i * 16));
+    uint16_t current = read16(bloomAddr);
+    uint16_t wanted = current & ~bits;
+    if (wanted == current) {
+      continue;
+    }
+    SettingsFlash::programHalfWord(bloomAddr, wanted);
+    if (read16(bloomAddr) != wanted && read16(addr + FKV_FLAGS) == FKV_FREE) {
+      SettingsFlash::programHalfWord(addr + FKV_FLAGS, 0);
+    }
+  }
+}
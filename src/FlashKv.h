@@ -0,0 +1,75 @@
+#ifndef FLASH_KV_H
+#define FLASH_KV_H
+
+// Журнальное хранилище "ключ - значение" во flash: новые значения дописываются в конец
+// журнала, действует последнее. Поиск идет от новых страниц к старым; в заголовке каждой
+// страницы - фильтр Блума, по которому страницы без искомого ключа пропускаются без
+// просмотра записей (отсутствующий ключ обычно не требует чтения ни одной записи).
+//
+// Кольцо страниц. Страница:
+//   seq (2) | flags (2) | bloom (FKV_BLOOM_BYTES) | запись | запись | ...
+// запись:
+//   key (2) | len (2) | данные (len байт, дополненные до четного)
+// - запись пишется полусловами: фильтр, len, данные и последним key (запись, прерванная
+//   сбросом, пропускается по len);
+// - при дозаписи в фильтре страницы только сбрасываются биты (1 -> 0, как у NOR), полуслово
+//   фильтра программируется повторно. Если flash не дала сбросить биты (повторное
+//   программирование запрещено), flags = 0 и фильтр этой страницы не используется;
+// - удаление - запись с len = FKV_TOMBSTONE;
+// - перед переходом на последнюю стертую страницу самая старая страница освобождается:
+//   ее действующие записи переносятся в новую страницу, затем она стирается.
+
+#include "SettingsFlash.h"
+#include "SettingsKernels.h"
+#include <string.h>
+
+#ifndef FKV_BLOOM_BYTES
+#define FKV_BLOOM_BYTES 4 // Размер фильтра Блума страницы (четный)
+#endif
+#if FKV_BLOOM_BYTES != 2 && FKV_BLOOM_BYTES != 4
+#error "FKV_BLOOM_BYTES: 2 or 4"
+#endif
+#define FKV_BLOOM_BITS (FKV_BLOOM_BYTES * 8)
+#define FKV_BLOOM_HASHES 2 // Битов фильтра на ключ
+
+#define FKV_HEADER (4 + FKV_BLOOM_BYTES)              // seq + flags + фильтр
+#define FKV_RECORD_HEADER 4                           // key + len
+#define FKV_MAX_VALUE (FLASH_PAGE_SIZE - FKV_HEADER - FKV_RECORD_HEADER) // Максимальная длина значения
+#define FKV_FREE 0xFFFF      // Стертое полуслово (key = FKV_FREE недопустим)
+#define FKV_TOMBSTONE 0x8000 // len удаленного ключа
+#define FKV_SEQ_MOD 0xFFFF   // Номера страниц 0..0xFFFE
+
+class FlashKv {
+  private:
+  uint32_t startAddr; // Начало диапазона страниц
+  uint16_t pages;     // Количество страниц (не меньше 2)
+  uint16_t headPage;  // Страница, в которую идет запись
+  uint16_t headOff;   // Смещение свободного места на ней
+  uint16_t headSeq;   // seq страницы headPage
+  bool useBloom;      // Использовать фильтры при поиске
+
+  public:
+  FlashKv(uint32_t startAddr, uint16_t pages, bool useBloom = true);
+  bool open(void);                                            // Поиск конца журнала после сброса
+  const uint8_t *find(uint16_t key, uint16_t *len = nullptr); // Значение прямо во flash (nullptr - нет ключа)
+  int16_t get(uint16_t key, void *buf, uint16_t size);        // Копия значения; -1 - нет ключа
+  bool set(uint16_t key, const void *data, uint16_t len);     // Запись значения
+  bool remove(uint16_t key);                                  // Удаление ключа
+  uint32_t pagesScanned;                                      // Страниц, записи которых просмотрены при поиске
+
+  private:
+  uint32_t pageAddr(uint16_t page) const { return startAddr + (uint32_t)page * FLASH_PAGE_SIZE; }
+  uint16_t read16(uint32_t addr) const;                        // Чтение полуслова из flash
+  uint32_t bloomMask(uint16_t key) const;                      // Биты ключа в фильтре
+  bool bloomMayContain(uint16_t page, uint32_t mask) const;    // Ключ может быть на странице
+  uint32_t findRecord(uint16_t key);                           // Адрес последней записи ключа (0 - нет)
+  uint32_t scanPage(uint16_t page, uint16_t key, uint16_t *end) const; // Последняя запись ключа на странице
+  bool append(uint16_t key, const void *data, uint16_t len);   // Дозапись в журнал
+  bool write(uint16_t key, const void *data, uint16_t len);    // Запись в текущую страницу
+  bool nextPage(void);                                         // Переход на следующую страницу
+  bool collect(uint16_t page);                                 // Перенос действующих записей страницы и ее стирание
+  void startPage(uint16_t page);                               // Стирание и разметка страницы
+  void clearBloom(uint16_t page, uint32_t mask);               // Сброс битов фильтра страницы
+};
+
+#endif // FLASH_KV_H
@@ -0,0 +1,317 @@
+//============================================================= (c) A.Kolesov ==
+// FlashQueue.cpp
+// Очередь записей во flash: дозапись полусловами, извлечение отметками без стирания,
+// поиск начала и конца после сброса за O(log n).
+//
+// Пример:
+//   FlashQueue queue(0x08003000, 16, 8); // 16 страниц под настройками, записи по 8 байт
+//   queue.open();
+//   queue.push(&msg);
+//   ...
+//   while (const uint8_t *rec = queue.front()) {
+//     if (!send(rec)) break;
+//     queue.pop();
+//   }
+//------------------------------------------------------------------------------
+
+#include "FlashQueue.h"
+
+#define FQ_PAGE_HEADER 2 // seq
+#define FQ_SLOT_HEADER 4 // commit + consumed
+
+//==============================================================================
+// Конструктор
+//  @param startAddr  - адрес первой страницы (кратен FLASH_PAGE_SIZE)
+//  @param pages      - количество страниц
+//  @param recordSize - размер записи, четный
+//  @param overwrite  - при заполнении стирать самые старые записи вместо отказа
+//------------------------------------------------------------------------------
+FlashQueue::FlashQueue(uint32_t startAddr, uint16_t pages, uint16_t recordSize, bool overwrite)
+    : startAddr(startAddr), pages(pages), recordSize(recordSize), overwrite(overwrite), opened(false) {
+  this->slotSize = FQ_SLOT_HEADER + recordSize;
+  this->slotsPerPage = (uint8_t)((FLASH_PAGE_SIZE - FQ_PAGE_HEADER) / this->slotSize);
+  this->tailPage = pages ? pages - 1 : 0;
+  this->tailSlot = this->slotsPerPage;
+  this->tailSeq = FQ_SEQ_MOD;
+  this->headPage = this->tailPage;
+  this->headSlot = this->tailSlot;
+}
+
+//==============================================================================
+// Поиск начала и конца очереди по содержимому flash (после сброса).
+// 1. Последняя страница - последняя в ряду 0..t, где seq[i] = seq[0] + i (двоичный поиск).
+// 2. Страницы от самой старой (t + 1) до t: сначала полностью извлеченные, потом с
+//    неизвлеченными записями - первая такая тоже ищется двоичным поиском.
+//  @return - false, если параметры очереди неверны или страницы не во flash
+//------------------------------------------------------------------------------
+bool FlashQueue::open() {
+  this->opened = false;
+  if (this->pages == 0 || this->slotsPerPage == 0 || (this->recordSize & 1) || (this->startAddr % FLASH_PAGE_SIZE) ||
+      !SettingsFlash::valid(this->startAddr, (size_t)this->pages * FLASH_PAGE_SIZE)) {
+    return false;
+  }
+  this->tailPage = this->pages - 1;
+  this->tailSlot = this->slotsPerPage;
+  this->tailSeq = FQ_SEQ_MOD;
+  this->headPage = this->tailPage;
+  this->headSlot = this->tailSlot;
+
+  // Опорная страница - 0, а если она стерта (сброс между стиранием и записью seq
+  // при повторном использовании) - 1: такая страница в кольце может быть только одна
+  uint16_t ref = (seq(0) == FQ_FREE && this->pages > 1) ? 1 : 0;
+  uint16_t seqRef = seq(ref);
+  this->opened = true;
+  if (seqRef == FQ_FREE) {
+    return true; // Очередь еще не использовалась
+  }
+
+  // Последняя записанная страница
+  uint16_t lo = ref, hi = this->pages - 1;
+  while (lo < hi) {
+    uint16_t mid = (uint16_t)((lo + hi + 1) / 2);
+    uint16_t s = seq(mid);
+    if (s != FQ_FREE && seqDistance(seqRef, s) == mid - ref) {
+      lo = mid;
+    } else {
+      hi = mid - 1;
+    }
+  }
+  this->tailPage = lo;
+  this->tailSeq = seq(lo);
+  this->tailSlot = this->slotsPerPage;
+  while (this->tailSlot > 0 && !slotUsed(lo, this->tailSlot - 1)) {
+    this->tailSlot--;
+  }
+
+  // Первая страница с неизвлеченными записями, считая от самой старой
+  lo = 0;
+  hi = this->pages; // == pages - неизвлеченных записей нет
+  while (lo < hi) {
+    uint16_t mid = (uint16_t)((lo + hi) / 2);
+    if (pageLive((uint16_t)((this->tailPage + 1 + mid) % this->pages))) {
+      hi = mid;
+    } else {
+      lo = mid + 1;
+    }
+  }
+  if (lo < this->pages) {
+    this->headPage = (uint16_t)((this->tailPage + 1 + lo) % this->pages);
+    this->headSlot = 0;
+    advanceHead();
+  } else {
+    this->headPage = this->tailPage;
+    this->headSlot = this->tailSlot;
+  }
+  return true;
+}
+
+//==============================================================================
+// Запись в конец очереди. При переходе на следующую страницу кольца она стирается,
+// если все ее записи уже извлечены; иначе очередь полна (в режиме overwrite страница
+// стирается вместе с самыми старыми записями).
+//  @param record - recordSize байт данных
+//  @return       - false, если очередь полна или не открыта (open() проверяет и четность
+//                  recordSize: запись пишется полусловами)
+//------------------------------------------------------------------------------
+bool FlashQueue::push(const void *record) {
+  if (!this->opened) {
+    return false; // До open() позиция конца неизвестна: запись могла бы стереть живые записи
+  }
+  bool wasEmpty = empty();
+  SettingsFlash::unlock();
+  if (this->tailSlot >= this->slotsPerPage) { // Страница заполнена - переходим на следующую
+    uint16_t next = (uint16_t)((this->tailPage + 1) % this->pages);
+    if (pageLive(next)) {
+      if (!this->overwrite) {
+        SettingsFlash::lock();
+        return false;
+      }
+      // Самые старые записи теряются: head - на начало следующей за ними страницы
+      this->headPage = (uint16_t)((next + 1) % this->pages);
+      this->headSlot = 0;
+      wasEmpty = this->pages == 1; // Единственная страница - очередь опустела
+    }
+    uint32_t addr = this->startAddr + (uint32_t)next * FLASH_PAGE_SIZE;
+    const uint8_t *page = SettingsFlash::ptr(addr);
+    for (uint16_t i = 0; i < FLASH_PAGE_SIZE; ++i) {
+      if (page[i] != 0xFF) {
+        SettingsFlash::erasePage(addr);
+        break;
+      }
+    }
+    this->tailSeq = (uint16_t)((this->tailSeq + 1) % FQ_SEQ_MOD);
+    SettingsFlash::programHalfWord(addr, this->tailSeq);
+    this->tailPage = next;
+    this->tailSlot = 0;
+  }
+
+  // Данные полусловами (0xFFFF не пишем - оно уже такое), затем отметка commit
+  uint32_t slot = slotAddr(this->tailPage, this->tailSlot);
+  const uint8_t *data = (const uint8_t *)record;
+  for (uint16_t i = 0; i < this->recordSize; i += 2) {
+    uint16_t value = (uint16_t)(data[i] | data[i + 1] << 8);
+    if (value != FQ_FREE) {
+      SettingsFlash::programHalfWord(slot + FQ_SLOT_HEADER + i, value);
+    }
+  }
+  SettingsFlash::programHalfWord(slot, FQ_MARK);
+  SettingsFlash::lock();
+  if (wasEmpty) { // head - на новую запись
+    this->headPage = this->tailPage;
+    this->headSlot = this->tailSlot;
+  }
+  this->tailSlot++;
+  advanceHead(); // После стирания старой страницы head мог попасть на прерванную запись
+  return true;
+}
+
+//==============================================================================
+// Первая запись очереди прямо во flash, без копирования
+//  @return - указатель на recordSize байт или nullptr, если очередь пуста
+//------------------------------------------------------------------------------
+const uint8_t *FlashQueue::front() {
+  if (empty()) {
+    return nullptr;
+  }
+  return SettingsFlash::ptr(slotAddr(this->headPage, this->headSlot) + FQ_SLOT_HEADER);
+}
+
+//==============================================================================
+// Извлечение первой записи: только отметка consumed, без стирания
+//  @return - false, если очередь пуста или не открыта
+//------------------------------------------------------------------------------
+bool FlashQueue::pop() {
+  if (!this->opened || empty()) {
+    return false;
+  }
+  SettingsFlash::unlock();
+  SettingsFlash::programHalfWord(slotAddr(this->headPage, this->headSlot) + 2, FQ_MARK);
+  SettingsFlash::lock();
+  this->headSlot++;
+  advanceHead();
+  return true;
+}
+
+//==============================================================================
+// Очередь пуста
+//------------------------------------------------------------------------------
+bool FlashQueue::empty() {
+  return this->headPage == this->tailPage && this->headSlot >= this->tailSlot;
+}
+
+//==============================================================================
+// Переход head к первой неизвлеченной записи, пропуская извлеченные и прерванные
+//------------------------------------------------------------------------------
+void FlashQueue::advanceHead() {
+  FlashQueueIter it = {this->headPage, this->headSlot};
+  seek(it);
+  this->headPage = it.page;
+  this->headSlot = it.slot;
+}
+
+//==============================================================================
+// Перебор записей от старых к новым прямо во flash, без извлечения
+//  @param it - позиция перебора (заполняется)
+//  @return   - первая запись или nullptr, если очередь пуста
+//------------------------------------------------------------------------------
+const uint8_t *FlashQueue::begin(FlashQueueIter &it) {
+  it.page = this->headPage;
+  it.slot = this->headSlot;
+  return seek(it);
+}
+
+//==============================================================================
+// Следующая запись при переборе
+//  @param it - позиция перебора после begin()/next()
+//  @return   - запись или nullptr, если записи кончились
+//------------------------------------------------------------------------------
+const uint8_t *FlashQueue::next(FlashQueueIter &it) {
+  it.slot++;
+  return seek(it);
+}
+
+// ******************** Вспомогательные функции ********************
+
+//==============================================================================
+// Первая неизвлеченная запись, начиная с позиции it (позиция сдвигается на нее)
+//------------------------------------------------------------------------------
+const uint8_t *FlashQueue::seek(FlashQueueIter &it) {
+  while (!(it.page == this->tailPage && it.slot >= this->tailSlot)) {
+    if (it.slot >= this->slotsPerPage) {
+      it.page = (uint16_t)((it.page + 1) % this->pages);
+      it.slot = 0;
+      continue;
+    }
+    if (slotLive(it.page, it.slot)) {
+      return SettingsFlash::ptr(slotAddr(it.page, it.slot) + FQ_SLOT_HEADER);
+    }
+    it.slot++;
+  }
+  return nullptr;
+}
+
+//==============================================================================
+// Адрес слота
+//------------------------------------------------------------------------------
+uint32_t FlashQueue::slotAddr(uint16_t page, uint8_t slot) const {
+  return this->startAddr + (uint32_t)page * FLASH_PAGE_SIZE + FQ_PAGE_HEADER + (uint32_t)slot * this->slotSize;
+}
+
+//==============================================================================
+// Чтение полуслова из flash
+//------------------------------------------------------------------------------
+uint16_t FlashQueue::read16(uint32_t addr) const {
+  uint16_t value;
+  memcpy(&value, SettingsFlash::ptr(addr), 2);
+  return value;
+}
+
+//==============================================================================
+// Номер страницы в кольце (FQ_FREE - страница стерта и не использовалась)
+//------------------------------------------------------------------------------
+uint16_t FlashQueue::seq(uint16_t page) const {
+  return read16(this->startAddr + (uint32_t)page * FLASH_PAGE_SIZE);
+}
+
+//==============================================================================
+// Слот занят: есть отметки или данные (в т.ч. запись, прерванная сбросом)
+//------------------------------------------------------------------------------
+bool FlashQueue::slotUsed(uint16_t page, uint8_t slot) const {
+  const uint8_t *p = SettingsFlash::ptr(slotAddr(page, slot));
+  for (uint16_t i = 0; i < this->slotSize; ++i) {
+    if (p[i] != 0xFF) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//==============================================================================
+// Запись в слоте завершена (commit) и еще не извлечена (consumed)
+//------------------------------------------------------------------------------
+bool FlashQueue::slotLive(uint16_t page, uint8_t slot) const {
+  uint32_t addr = slotAddr(page, slot);
+  return read16(addr) != FQ_FREE && read16(addr + 2) == FQ_FREE;
+}
+
+//==============================================================================
+// На странице есть неизвлеченные записи
+//------------------------------------------------------------------------------
+bool FlashQueue::pageLive(uint16_t page) const {
+  if (seq(page) == FQ_FREE) {
+    return false;
+  }
+  for (uint8_t slot = 0; slot < this->slotsPerPage; ++slot) {
+    if (slotLive(page, slot)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+//==============================================================================
+// Расстояние от номера from до номера to по модулю FQ_SEQ_MOD
+//------------------------------------------------------------------------------
+uint16_t FlashQueue::seqDistance(uint16_t from, uint16_t to) const {
+  return (uint16_t)(((uint32_t)to + FQ_SEQ_MOD - from) % FQ_SEQ_MOD);
+}
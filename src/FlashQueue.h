@@ -0,0 +1,74 @@
+#ifndef FLASH_QUEUE_H
+#define FLASH_QUEUE_H
+
+// Очередь (FIFO) записей фиксированного размера во flash, сохраняющаяся при сбросе:
+// буфер исходящих сообщений на время пропадания связи.
+//
+// Занимает отдельный диапазон страниц (кольцо). Страница:
+//   seq (2 байта) | слот 0 | слот 1 | ...
+// слот:
+//   commit (2) | consumed (2) | данные (recordSize байт)
+// - push() пишет данные полусловами, затем commit = 0 (запись прерванная сбросом не
+//   считается записанной);
+// - pop() только пишет consumed = 0 - при извлечении ничего не стирается;
+// - страница стирается, когда кольцо доходит до нее снова, и только если все ее записи
+//   уже извлечены (иначе очередь полна).
+// Номера seq страниц идут подряд по кольцу, поэтому open() находит последнюю страницу,
+// а затем первую непрочитанную двоичным поиском: O(log n) чтений заголовков страниц.
+// Каждое полуслово программируется не больше одного раза после стирания.
+// В режиме overwrite заполненная очередь не отказывает в записи, а стирает страницу с самыми
+// старыми записями (кольцевой журнал). begin()/next() перебирают записи от старых к новым
+// прямо во flash, не извлекая их.
+
+#include "SettingsFlash.h"
+#include <string.h>
+
+#define FQ_FREE 0xFFFF    // Стертое полуслово
+#define FQ_MARK 0x0000    // Отметка commit / consumed
+#define FQ_SEQ_MOD 0xFFFF // Номера страниц 0..0xFFFE (0xFFFF - стертая страница)
+
+// Позиция перебора записей (begin()/next())
+struct FlashQueueIter {
+  uint16_t page;
+  uint8_t slot;
+};
+
+class FlashQueue {
+  private:
+  uint32_t startAddr;    // Начало диапазона страниц
+  uint16_t pages;        // Количество страниц
+  uint16_t recordSize;   // Размер записи (четный)
+  uint16_t slotSize;     // Размер слота: отметки + запись
+  uint8_t slotsPerPage;  // Слотов на странице
+  uint16_t headPage;     // Первая непрочитанная запись (или == tail, если очередь пуста)
+  uint8_t headSlot;
+  uint16_t tailPage;     // Место для следующей записи; tailSlot == slotsPerPage - страница заполнена
+  uint8_t tailSlot;
+  uint16_t tailSeq;      // seq страницы tailPage (FQ_SEQ_MOD - страниц еще не было)
+  bool overwrite;        // При заполнении стирать самые старые записи
+  bool opened;           // open() прошел успешно: параметры верны, head и tail найдены
+
+  public:
+  FlashQueue(uint32_t startAddr, uint16_t pages, uint16_t recordSize, bool overwrite = false);
+  bool open(void);                     // Поиск начала и конца очереди после сброса
+  bool push(const void *record);       // Запись в конец; false - очередь полна или не открыта
+  const uint8_t *front(void);          // Первая запись прямо во flash (nullptr - очередь пуста)
+  bool pop(void);                      // Извлечение первой записи
+  bool empty(void);                    // Очередь пуста
+  const uint8_t *begin(FlashQueueIter &it);     // Первая запись для перебора (nullptr - пусто)
+  const uint8_t *next(FlashQueueIter &it);      // Следующая запись (nullptr - записи кончились)
+  uint16_t getSlotsPerPage(void) const { return slotsPerPage; } // Записей на странице
+
+  private:
+  uint32_t slotAddr(uint16_t page, uint8_t slot) const;      // Адрес слота
+  uint16_t read16(uint32_t addr) const;                      // Чтение полуслова из flash
+  uint16_t seq(uint16_t page) const;                         // Номер страницы (FQ_FREE - не использована)
+  bool slotUsed(uint16_t page, uint8_t slot) const;          // Слот занят (в т.ч. прерванной записью)
+  bool slotLive(uint16_t page, uint8_t slot) const;          // Запись записана и не извлечена
+  bool pageLive(uint16_t page) const;                        // На странице есть неизвлеченные записи
+  uint16_t seqDistance(uint16_t from, uint16_t to) const;    // Расстояние между номерами по модулю
+  void advanceHead(void);                                    // Переход head к первой неизвлеченной записи
+  const uint8_t *seek(FlashQueueIter &it);                   // Первая неизвлеченная запись от позиции it
+};
+
+#endif // FLASH_QUEUE_H
@@ -0,0 +1,303 @@
+//============================================================= (c) A.Kolesov ==
+// FlashTable.cpp
+// Неизменяемая отсортированная таблица во flash: двоичный поиск прямо по flash,
+// пересборка в теневую область с переключением записью заголовка.
+//
+// Пример (белый список: ключ - 4 байта адреса старшим байтом вперед, значение - 2 байта):
+//   FlashTable whitelist(0x08002000, 0x08002800, 32, 4, 2);
+//   whitelist.open();
+//   ...
+//   const uint8_t *channel = whitelist.find(addrBE); // nullptr - устройства нет в списке
+//   ...
+//   FlashTableBuilder builder(whitelist);           // Пересборка по командам с шлюза
+//   builder.begin(n);
+//   for (...) builder.add(key, value);              // Ключи по возрастанию
+//   builder.commit();
+//------------------------------------------------------------------------------
+
+#include "FlashTable.h"
+#include <stddef.h>
+
+//==============================================================================
+// Конструктор
+//  @param regionA     - адрес области A (кратен FLASH_PAGE_SIZE)
+//  @param regionB     - адрес области B (теневая для A и наоборот)
+//  @param regionPages - страниц в каждой области
+//  @param keySize     - размер ключа, 1..FT_MAX_KEY
+//  @param valueSize   - размер значения (0 - таблица только из ключей)
+//------------------------------------------------------------------------------
+FlashTable::FlashTable(uint32_t regionA, uint32_t regionB, uint16_t regionPages, uint8_t keySize, uint16_t valueSize)
+    : regionPages(regionPages), keySize(keySize), valueSize(valueSize), active(-1) {
+  this->region[0] = regionA;
+  this->region[1] = regionB;
+}
+
+//==============================================================================
+// Выбор действующей таблицы: из областей с верным заголовком - с большим поколением
+//  @return - false, если таблицы нет ни в одной области или области не во flash
+//------------------------------------------------------------------------------
+bool FlashTable::open() {
+  size_t size = (size_t)this->regionPages * FLASH_PAGE_SIZE;
+  if (!SettingsFlash::valid(this->region[0], size) || !SettingsFlash::valid(this->region[1], size)) {
+    this->active = -1;
+    return false;
+  }
+  const FlashTableHeader *a = header(0);
+  const FlashTableHeader *b = header(1);
+  if (a && b) {
+    this->active = (int16_t)(b->gen - a->gen) > 0 ? 1 : 0;
+  } else {
+    this->active = a ? 0 : (b ? 1 : -1);
+  }
+  return this->active >= 0;
+}
+
+//==============================================================================
+// Поиск значения по ключу: сначала по сводке (если есть), затем двоичный поиск
+// по ключам прямо во flash.
+//  @param key - ключ (keySize байт)
+//  @return    - указатель на значение во flash (на ключ, если valueSize = 0);
+//               nullptr, если ключа нет
+//------------------------------------------------------------------------------
+const uint8_t *FlashTable::find(const void *key) {
+  if (this->active < 0) {
+    return nullptr;
+  }
+  const FlashTableHeader *hdr = (const FlashTableHeader *)SettingsFlash::ptr(this->region[this->active]);
+  uint32_t base = this->region[this->active];
+  const uint8_t *keys = SettingsFlash::ptr(base + (hdr->summary ? 2 : 1) * FLASH_PAGE_SIZE);
+  uint16_t lo = 0, hi = hdr->count;
+
+  if (hdr->summary) {
+    // Последний ключ сводки <= key задает отрезок из step ключей
+    const uint8_t *summary = SettingsFlash::ptr(base + FLASH_PAGE_SIZE);
+    uint16_t slo = 0, shi = hdr->summary;
+    while (slo < shi) {
+      uint16_t mid = (uint16_t)((slo + shi) / 2);
+      if (memcmp(summary + mid * this->keySize, key, this->keySize) <= 0) {
+        slo = mid + 1;
+      } else {
+        shi = mid;
+      }
+    }
+    if (slo == 0) {
+      return nullptr;
+    }
+    lo = (uint16_t)((slo - 1) * hdr->step);
+    hi = hdr->count - lo < hdr->step ? hdr->count : lo + hdr->step;
+  }
+
+  while (lo < hi) {
+    uint16_t mid = (uint16_t)((lo + hi) / 2);
+    int c = memcmp(keys + mid * this->keySize, key, this->keySize);
+    if (c == 0) {
+      return value(mid);
+    }
+    if (c < 0) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return nullptr;
+}
+
+//==============================================================================
+// Количество записей действующей таблицы
+//------------------------------------------------------------------------------
+uint16_t FlashTable::size() {
+  if (this->active < 0) {
+    return 0;
+  }
+  return ((const FlashTableHeader *)SettingsFlash::ptr(this->region[this->active]))->count;
+}
+
+//==============================================================================
+// Ключ по номеру записи (записи упорядочены по возрастанию ключей)
+//  @param index - номер записи, меньше size()
+//------------------------------------------------------------------------------
+const uint8_t *FlashTable::key(uint16_t index) {
+  if (index >= size()) {
+    return nullptr;
+  }
+  const FlashTableHeader *hdr = (const FlashTableHeader *)SettingsFlash::ptr(this->region[this->active]);
+  return SettingsFlash::ptr(this->region[this->active] + (hdr->summary ? 2 : 1) * FLASH_PAGE_SIZE + index * this->keySize);
+}
+
+//==============================================================================
+// Значение по номеру записи
+//  @param index - номер записи, меньше size()
+//------------------------------------------------------------------------------
+const uint8_t *FlashTable::value(uint16_t index) {
+  if (this->valueSize == 0) {
+    return key(index);
+  }
+  if (index >= size()) {
+    return nullptr;
+  }
+  const FlashTableHeader *hdr = (const FlashTableHeader *)SettingsFlash::ptr(this->region[this->active]);
+  return SettingsFlash::ptr(this->region[this->active] + hdr->valuesPage * FLASH_PAGE_SIZE + (uint32_t)index * this->valueSize);
+}
+
+//==============================================================================
+// Заголовок области, если он верен
+//  @param r - номер области (0 - A, 1 - B)
+//------------------------------------------------------------------------------
+const FlashTableHeader *FlashTable::header(int8_t r) const {
+  const FlashTableHeader *hdr = (const FlashTableHeader *)SettingsFlash::ptr(this->region[r]);
+  return headerValid(hdr) ? hdr : nullptr;
+}
+
+//==============================================================================
+// Проверка заголовка: метка, CRC, размеры записей и границы области
+//------------------------------------------------------------------------------
+bool FlashTable::headerValid(const FlashTableHeader *hdr) const {
+  if (hdr->magic != FT_MAGIC || hdr->crc != ss_crc16(0xFFFF, hdr, offsetof(FlashTableHeader, crc))) {
+    return false;
+  }
+  if (hdr->keySize != this->keySize || hdr->valueSize != this->valueSize) {
+    return false;
+  }
+  uint32_t valuesEnd = hdr->valuesPage + ((uint32_t)hdr->count * hdr->valueSize + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+  return valuesEnd <= this->regionPages;
+}
+
+//==============================================================================
+// Конструктор сборщика
+//  @param table - таблица, которую нужно пересобрать
+//------------------------------------------------------------------------------
+FlashTableBuilder::FlashTableBuilder(FlashTable &table) : table(table), target(-1), count(0), added(0), failed(true) {
+}
+
+//==============================================================================
+// Начало пересборки: разметка теневой (недействующей) области и стирание ее заголовка.
+// Действующая таблица остается доступной до commit().
+//  @param count   - количество записей новой таблицы
+//  @param summary - строить страницу сводки (если ключи не помещаются на одну страницу)
+//  @return        - false, если таблица не помещается в область
+//------------------------------------------------------------------------------
+bool FlashTableBuilder::begin(uint16_t count, bool summary) {
+  uint8_t ks = this->table.keySize;
+  this->failed = true;
+  if (ks == 0 || ks > FT_MAX_KEY) {
+    return false;
+  }
+  this->count = count;
+  this->added = 0;
+  this->summaryMax = 0;
+  this->step = 0;
+  uint16_t perPage = FLASH_PAGE_SIZE / ks;
+  if (summary && count > perPage) {
+    this->step = (uint16_t)((count + perPage - 1) / perPage);
+    this->summaryMax = (uint8_t)((count + this->step - 1) / this->step);
+  }
+  this->keysPage = this->summaryMax ? 2 : 1;
+  this->valuesPage = (uint16_t)(this->keysPage + ((uint32_t)count * ks + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE);
+  uint32_t end = this->valuesPage + ((uint32_t)count * this->table.valueSize + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+  if (end > this->table.regionPages) {
+    return false;
+  }
+  size_t size = (size_t)this->table.regionPages * FLASH_PAGE_SIZE;
+  if (!SettingsFlash::valid(this->table.region[0], size) || !SettingsFlash::valid(this->table.region[1], size)) {
+    return false; // Области не во flash
+  }
+
+  this->target = this->table.active == 0 ? 1 : 0;
+  SettingsFlash::unlock();
+  SettingsFlash::erasePage(this->table.region[this->target]); // Старая таблица в этой области больше не действует
+  SettingsFlash::lock();
+  memset(this->keyBuf, 0xFF, FLASH_PAGE_SIZE);
+  memset(this->valueBuf, 0xFF, FLASH_PAGE_SIZE);
+  memset(this->summaryBuf, 0xFF, FLASH_PAGE_SIZE);
+  this->failed = false;
+  return true;
+}
+
+//==============================================================================
+// Добавление записи. Заполненные страницы сразу пишутся во flash.
+//  @param key   - ключ; ключи должны идти строго по возрастанию (memcmp)
+//  @param value - значение (не используется при valueSize = 0)
+//  @return      - false при нарушении порядка или лишней записи (сборка прерывается)
+//------------------------------------------------------------------------------
+bool FlashTableBuilder::add(const void *key, const void *value) {
+  uint8_t ks = this->table.keySize;
+  uint16_t vs = this->table.valueSize;
+  if (this->failed || this->added >= this->count || (this->added && memcmp(key, this->lastKey, ks) <= 0)) {
+    this->failed = true;
+    return false;
+  }
+  put(this->keyBuf, this->keysPage, (uint32_t)this->added * ks, key, ks);
+  if (vs) {
+    put(this->valueBuf, this->valuesPage, (uint32_t)this->added * vs, value, vs);
+  }
+  if (this->summaryMax && this->added % this->step == 0) {
+    memcpy(this->summaryBuf + this->added / this->step * ks, key, ks);
+  }
+  memcpy(this->lastKey, key, ks);
+  this->added++;
+  return true;
+}
+
+//==============================================================================
+// Окончание пересборки: запись неполных страниц, сводки и, последним, заголовка
+// с новым поколением. Сброс до записи заголовка оставляет действующей старую таблицу.
+//  @return - false, если добавлены не все объявленные записи или была ошибка
+//------------------------------------------------------------------------------
+bool FlashTableBuilder::commit() {
+  if (this->failed || this->added != this->count) {
+    return false;
+  }
+  uint32_t base = this->table.region[this->target];
+  uint32_t keyBytes = (uint32_t)this->count * this->table.keySize;
+  uint32_t valueBytes = (uint32_t)this->count * this->table.valueSize;
+  if (keyBytes % FLASH_PAGE_SIZE) {
+    SettingsFlash::writePage(base + (this->keysPage + keyBytes / FLASH_PAGE_SIZE) * FLASH_PAGE_SIZE, this->keyBuf);
+  }
+  if (valueBytes % FLASH_PAGE_SIZE) {
+    SettingsFlash::writePage(base + (this->valuesPage + valueBytes / FLASH_PAGE_SIZE) * FLASH_PAGE_SIZE, this->valueBuf);
+  }
+  if (this->summaryMax) {
+    SettingsFlash::writePage(base + FLASH_PAGE_SIZE, this->summaryBuf);
+  }
+
+  // Заголовок собирается в буфере сводки: она уже записана
+  uint8_t *page = this->summaryBuf;
+  memset(page, 0xFF, FLASH_PAGE_SIZE);
+  FlashTableHeader hdr;
+  const FlashTableHeader *old = this->table.active >= 0 ? this->table.header(this->table.active) : nullptr;
+  hdr.magic = FT_MAGIC;
+  hdr.gen = old ? old->gen + 1 : 1;
+  hdr.count = this->count;
+  hdr.valueSize = this->table.valueSize;
+  hdr.keySize = this->table.keySize;
+  hdr.summary = this->summaryMax;
+  hdr.step = this->step;
+  hdr.valuesPage = this->valuesPage;
+  hdr.crc = ss_crc16(0xFFFF, &hdr, offsetof(FlashTableHeader, crc));
+  memcpy(page, &hdr, sizeof(hdr));
+  SettingsFlash::writePage(base, page);
+
+  this->table.active = this->target;
+  this->failed = true; // Следующая пересборка - снова через begin()
+  return true;
+}
+
+//==============================================================================
+// Дозапись байт в поток страниц: заполненная страница буфера пишется во flash
+//  @param buf       - буфер текущей страницы потока
+//  @param firstPage - первая страница потока от начала области
+//  @param offset    - смещение данных от начала потока
+//  @param data      - данные
+//  @param len       - количество байт
+//------------------------------------------------------------------------------
+void FlashTableBuilder::put(uint8_t *buf, uint16_t firstPage, uint32_t offset, const void *data, uint16_t len) {
+  const uint8_t *src = (const uint8_t *)data;
+  for (uint16_t i = 0; i < len; ++i, ++offset) {
+    buf[offset % FLASH_PAGE_SIZE] = src[i];
+    if (offset % FLASH_PAGE_SIZE == FLASH_PAGE_SIZE - 1) {
+      uint32_t page = firstPage + offset / FLASH_PAGE_SIZE;
+      SettingsFlash::writePage(this->table.region[this->target] + page * FLASH_PAGE_SIZE, buf);
+      memset(buf, 0xFF, FLASH_PAGE_SIZE);
+    }
+  }
+}
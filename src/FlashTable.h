@@ -0,0 +1,91 @@
+#ifndef FLASH_TABLE_H
+#define FLASH_TABLE_H
+
+// Неизменяемая отсортированная таблица во flash (белые списки устройств, таблицы каналов):
+// поиск двоичным поиском прямо по flash, без копирования в RAM.
+//
+// Таблица занимает одну из двух областей (A/B) по regionPages страниц. Область:
+//   заголовок (страница) | сводка (страница, по желанию) | ключи | значения
+// - ключи фиксированного размера лежат подряд отдельно от значений: последние шаги поиска
+//   читают соседние слова, а значение читается один раз для найденного ключа;
+// - ключи сравниваются побайтно (memcmp), числовые ключи храните старшим байтом вперед;
+// - сводка - каждый step-й ключ на одной странице: сначала поиск по ней, затем по
+//   отрезку из step ключей;
+// - пересборка (FlashTableBuilder) пишет новую таблицу в другую область постранично,
+//   заголовок - последним. До записи заголовка действует старая таблица, после - новая
+//   (с большим номером поколения).
+// Страницы пишутся через SettingsFlash::writePage(), как SettingsStore::writePage().
+
+#include "SettingsFlash.h"
+#include "SettingsKernels.h"
+#include <string.h>
+
+#define FT_MAGIC 0x5446 // Метка заголовка таблицы
+
+#ifndef FT_MAX_KEY
+#define FT_MAX_KEY 16 // Максимальный размер ключа, байт
+#endif
+
+// Заголовок таблицы (начало первой страницы области)
+struct FlashTableHeader {
+  uint16_t magic;      // FT_MAGIC
+  uint16_t gen;        // Поколение: действует таблица с большим номером
+  uint16_t count;      // Количество записей
+  uint16_t valueSize;  // Размер значения (0 - только ключи, множество)
+  uint8_t keySize;     // Размер ключа
+  uint8_t summary;     // Ключей в сводке (0 - без сводки)
+  uint16_t step;       // Шаг выборки ключей в сводку
+  uint16_t valuesPage; // Первая страница значений от начала области
+  uint16_t crc;        // CRC16 предыдущих полей
+};
+
+class FlashTable {
+  private:
+  uint32_t region[2];   // Адреса областей A и B
+  uint16_t regionPages; // Страниц в каждой области
+  uint8_t keySize;      // Размер ключа
+  uint16_t valueSize;   // Размер значения
+  int8_t active;        // Действующая область (-1 - таблицы нет)
+
+  friend class FlashTableBuilder;
+
+  public:
+  FlashTable(uint32_t regionA, uint32_t regionB, uint16_t regionPages, uint8_t keySize, uint16_t valueSize);
+  bool open(void);                       // Выбор действующей области после сброса
+  const uint8_t *find(const void *key);  // Значение по ключу прямо во flash (nullptr - не найден)
+  uint16_t size(void);                   // Количество записей
+  const uint8_t *key(uint16_t index);    // Ключ по номеру (по возрастанию)
+  const uint8_t *value(uint16_t index);  // Значение по номеру
+
+  private:
+  const FlashTableHeader *header(int8_t r) const; // Заголовок области (nullptr - неверный)
+  bool headerValid(const FlashTableHeader *hdr) const;   // Проверка заголовка
+};
+
+class FlashTableBuilder {
+  private:
+  FlashTable &table;                   // Пересобираемая таблица
+  int8_t target;                       // Область, в которую пишется новая таблица
+  uint16_t count;                      // Объявленное количество записей
+  uint16_t added;                      // Добавлено записей
+  uint16_t step;                       // Шаг сводки
+  uint8_t summaryMax;                  // Ключей в сводке (0 - без сводки)
+  uint16_t keysPage;                   // Первая страница ключей
+  uint16_t valuesPage;                 // Первая страница значений
+  uint8_t keyBuf[FLASH_PAGE_SIZE];     // Текущая страница ключей
+  uint8_t valueBuf[FLASH_PAGE_SIZE];   // Текущая страница значений
+  uint8_t summaryBuf[FLASH_PAGE_SIZE]; // Страница сводки
+  uint8_t lastKey[FT_MAX_KEY];         // Предыдущий ключ (проверка порядка)
+  bool failed;                         // Ошибка при добавлении
+
+  public:
+  FlashTableBuilder(FlashTable &table);
+  bool begin(uint16_t count, bool summary = true); // Начало пересборки в теневую область
+  bool add(const void *key, const void *value);    // Следующая запись (ключи по возрастанию)
+  bool commit(void);                               // Запись заголовка: новая таблица начинает действовать
+
+  private:
+  void put(uint8_t *buf, uint16_t firstPage, uint32_t offset, const void *data, uint16_t len); // Поток байт в страницы
+};
+
+#endif // FLASH_TABLE_H
@@ -0,0 +1,215 @@
+#ifndef PERFECT_HASH_H
+#define PERFECT_HASH_H
+
+// Совершенное хеширование фиксированного набора ключей-строк, построенное компилятором.
+// Для набора ключей, известного при сборке, компилятор строит таблицу, в которой у каждого
+// ключа свой слот из M (M - степень двойки не меньше числа ключей; при N = 2^k таблица
+// минимальная). Таблица - constexpr-объект в .rodata, индекса в RAM нет.
+// - PH_SLOT(table, "key") - номер слота ключа, вычисляется при компиляции (неизвестный ключ -
+//   ошибка компиляции); значение лежит по фиксированному смещению slot * sizeof(значения);
+// - table.find(name) - поиск строки во время работы: один хеш строки и одно сравнение.
+// Строковые литералы не могут быть параметрами шаблона в C++17, поэтому вместо get<"key">()
+// используется макрос PH_SLOT, дающий ту же константу времени компиляции.
+//
+// Построение - хеш со смещениями (hash and displace): ключи делятся хешем на корзины, для
+// каждой корзины (от больших к меньшим) подбирается смещение 0..255, при котором ее ключи
+// попадают в свободные слоты. Хеш строки - умножение на 33 и xor, без умножения и деления
+// во время работы (у RV32EC нет инструкций M).
+//
+// Пример (значения - массив uint32_t из M слотов, сохраняемый через SettingsStore):
+//   static constexpr const char *keyNames[] = {"baud", "addr", "mode", "timeout"};
+//   PH_TABLE(keyHash, keyNames);                            // constexpr-таблица на 4 слота
+//   uint32_t values[keyHash.size()];
+//   SettingsStore settings(values, sizeof(values), false, false);
+//   const uint32_t *flashValues = (const uint32_t *)settings.view();
+//   uint32_t baud = flashValues[PH_SLOT(keyHash, "baud")]; // Смещение известно при компиляции
+//   int16_t slot = keyHash.find(name, len);                 // Имя из команды: -1 - нет такого ключа
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PH_FREE 0xFF // Свободный слот
+
+//==============================================================================
+// Хеш строки: h * 33 ^ c (умножение на 33 - сдвиг и сложение)
+//  @param s   - строка
+//  @param len - длина строки
+//------------------------------------------------------------------------------
+constexpr uint32_t ph_hash(const char *s, size_t len) {
+  uint32_t h = 5381;
+  for (size_t i = 0; i < len; ++i) {
+    h = ((h << 5) + h) ^ (uint8_t)s[i];
+  }
+  return h;
+}
+
+//==============================================================================
+// Перемешивание (сдвиги, xor и сложения, как в финале хеша Дженкинса): младшие биты
+// результата зависят от всех битов x. Сложения делают его нелинейным - иначе разность
+// слотов двух ключей корзины не зависела бы от смещения.
+//------------------------------------------------------------------------------
+constexpr uint32_t ph_mix(uint32_t x) {
+  x ^= x >> 16;
+  x += x << 3;
+  x ^= x >> 11;
+  x += x << 15;
+  x ^= x >> 13;
+  return x;
+}
+
+// Слот ключа с перемешанным хешем m при смещении корзины d
+constexpr uint32_t ph_slot(uint32_t m, uint8_t d) {
+  return ph_mix(m ^ ((uint32_t)d * 0x01010101U));
+}
+
+constexpr size_t ph_strlen(const char *s) {
+  size_t len = 0;
+  while (s[len]) {
+    len++;
+  }
+  return len;
+}
+
+constexpr bool ph_equal(const char *a, const char *b, size_t len) {
+  for (size_t i = 0; i < len; ++i) {
+    if (a[i] != b[i]) {
+      return false;
+    }
+  }
+  return a[len] == 0;
+}
+
+// Степень двойки не меньше n
+constexpr uint16_t ph_pow2(uint16_t n) {
+  uint16_t m = 1;
+  while (m < n) {
+    m <<= 1;
+  }
+  return m;
+}
+
+// Не constexpr: вызов при построении таблицы или в PH_SLOT - ошибка компиляции
+void ph_error_no_displacement_duplicate_key_or_increase_table_size(void);
+void ph_error_key_not_in_table(void);
+
+template <uint16_t N, uint16_t M, uint16_t B = ph_pow2(N)>
+class PerfectHash {
+  static_assert(N > 0 && N < PH_FREE && M >= N, "PerfectHash: 1..254 keys, M >= number of keys");
+  static_assert((M & (M - 1)) == 0 && (B & (B - 1)) == 0, "PerfectHash: M and B must be powers of two");
+
+  private:
+  const char *const *keys; // Ключи (в .rodata)
+  uint8_t slots[M];        // Номер ключа в слоте (PH_FREE - свободен)
+  uint8_t disp[B];         // Смещение корзины
+
+  public:
+  //============================================================================
+  // Построение таблицы (при компиляции)
+  //  @param keys - массив из N ключей
+  //----------------------------------------------------------------------------
+  constexpr PerfectHash(const char *const (&keys)[N]) : keys(keys), slots(), disp() {
+    uint32_t mixed[N] = {};
+    uint8_t bucketSize[B] = {};
+    uint8_t maxSize = 0;
+    for (uint16_t k = 0; k < N; ++k) {
+      mixed[k] = ph_mix(ph_hash(keys[k], ph_strlen(keys[k])));
+      uint8_t size = ++bucketSize[mixed[k] & (B - 1)];
+      maxSize = size > maxSize ? size : maxSize;
+    }
+    for (uint16_t i = 0; i < M; ++i) {
+      this->slots[i] = PH_FREE;
+    }
+
+    // Корзины от больших к меньшим: большие проще разместить, пока свободных слотов много
+    for (uint8_t size = maxSize; size > 0; --size) {
+      for (uint16_t b = 0; b < B; ++b) {
+        if (bucketSize[b] != size) {
+          continue;
+        }
+        bool placed = false;
+        for (uint16_t d = 0; d < 256 && !placed; ++d) {
+          placed = true;
+          for (uint16_t k = 0; k < N && placed; ++k) {
+            if ((mixed[k] & (B - 1)) != b) {
+              continue;
+            }
+            uint16_t slot = ph_slot(mixed[k], (uint8_t)d) & (M - 1);
+            if (this->slots[slot] != PH_FREE) {
+              placed = false; // Занят (в т.ч. ключом этой же корзины) - откат
+              for (uint16_t i = 0; i < M; ++i) {
+                if (this->slots[i] != PH_FREE && (mixed[this->slots[i]] & (B - 1)) == b) {
+                  this->slots[i] = PH_FREE;
+                }
+              }
+            } else {
+              this->slots[slot] = (uint8_t)k;
+            }
+          }
+          if (placed) {
+            this->disp[b] = (uint8_t)d;
+          }
+        }
+        if (!placed) {
+          ph_error_no_displacement_duplicate_key_or_increase_table_size();
+        }
+      }
+    }
+  }
+
+  //============================================================================
+  // Слот ключа, известного при компиляции (через PH_SLOT)
+  //----------------------------------------------------------------------------
+  constexpr int16_t slot(const char *key) const {
+    size_t len = ph_strlen(key);
+    uint32_t m = ph_mix(ph_hash(key, len));
+    uint16_t slot = ph_slot(m, this->disp[m & (B - 1)]) & (M - 1);
+    uint8_t k = this->slots[slot];
+    if (k == PH_FREE || !ph_equal(this->keys[k], key, len)) {
+      ph_error_key_not_in_table();
+    }
+    return (int16_t)slot;
+  }
+
+  //============================================================================
+  // Поиск ключа во время работы: один хеш и одно сравнение
+  //  @param key - имя ключа (не обязательно с завершающим нулем)
+  //  @param len - длина имени
+  //  @return    - номер слота; -1, если такого ключа нет
+  //----------------------------------------------------------------------------
+  int16_t find(const char *key, size_t len) const {
+    uint32_t m = ph_mix(ph_hash(key, len));
+    uint16_t slot = ph_slot(m, this->disp[m & (B - 1)]) & (M - 1);
+    uint8_t k = this->slots[slot];
+    if (k == PH_FREE || strncmp(this->keys[k], key, len) != 0 || this->keys[k][len] != 0) {
+      return -1;
+    }
+    return (int16_t)slot;
+  }
+
+  int16_t find(const char *key) const { return find(key, strlen(key)); }
+
+  constexpr uint16_t size(void) const { return M; } // Слотов в таблице
+  constexpr const char *name(uint16_t slot) const { // Ключ в слоте (nullptr - свободен)
+    return this->slots[slot] == PH_FREE ? nullptr : this->keys[this->slots[slot]];
+  }
+};
+
+// Константа времени компиляции из constexpr-выражения
+template <int16_t V>
+struct PhConst {
+  static constexpr int16_t value = V;
+};
+
+#define PH_COUNT(keys) (sizeof(keys) / sizeof((keys)[0]))
+
+// Таблица для массива ключей keys: слотов - степень двойки не меньше числа ключей
+#define PH_TABLE(name, keys) static constexpr PerfectHash<PH_COUNT(keys), ph_pow2(PH_COUNT(keys))> name(keys)
+
+// Таблица с заданным числом слотов m (степень двойки), если для PH_TABLE не нашлось смещений
+#define PH_TABLE_SIZE(name, keys, m) static constexpr PerfectHash<PH_COUNT(keys), m> name(keys)
+
+// Слот ключа-литерала, вычисленный при компиляции
+#define PH_SLOT(table, key) (PhConst<(table).slot(key)>::value)
+
+#endif // PERFECT_HASH_H
@@ -0,0 +1,92 @@
+//============================================================= (c) A.Kolesov ==
+// SettingsDesc.cpp
+// Хранилище настроек по описателю из .rodata: те же чтение, запись и просмотр, что
+// у SettingsStore без дополнительных режимов, но без объекта в RAM.
+//------------------------------------------------------------------------------
+
+#include "SettingsDesc.h"
+
+//==============================================================================
+// Чтение данных из flash в буфер описателя
+//  @param desc - описатель хранилища
+//  @return     - true при успехе, false при ошибке CRC или если область не во flash
+//------------------------------------------------------------------------------
+bool SettingsStatic::load(const SettingsDesc &desc) {
+  if (!SettingsFlash::valid(address(desc), desc.alignedSize)) {
+    return false;
+  }
+  ss_copy(desc.buf, SettingsFlash::ptr(address(desc)), desc.length);
+  if (!(desc.flags & SETTINGS_DESC_CRC)) {
+    return true;
+  }
+  uint16_t stored_crc;
+  memcpy(&stored_crc, (const uint8_t *)desc.buf + desc.length - 2, 2);
+  return stored_crc == ss_crc16(0xFFFF, desc.buf, desc.length - 2);
+}
+
+//==============================================================================
+// Сохранение буфера описателя во flash: если данные (без CRC) не изменились, запись
+// пропускается; иначе подставляется CRC, страницы стираются (уже чистые - нет) и пишутся.
+//  @param desc - описатель хранилища
+//  @return     - true, если данные записаны (false и для области не во flash)
+//------------------------------------------------------------------------------
+bool SettingsStatic::save(const SettingsDesc &desc) {
+  if (!SettingsFlash::valid(address(desc), desc.alignedSize)) {
+    return false;
+  }
+  bool useCrc = desc.flags & SETTINGS_DESC_CRC;
+  uint8_t *buf = (uint8_t *)desc.buf;
+  if (!(desc.flags & SETTINGS_DESC_FORCE) &&
+      !ss_compare(SettingsFlash::ptr(address(desc)), buf, useCrc ? desc.length - 2 : desc.length)) {
+    return false;
+  }
+  if (useCrc) {
+    uint16_t crc = ss_crc16(0xFFFF, buf, desc.length - 2);
+    memcpy(buf + desc.length - 2, &crc, 2);
+  }
+
+  SettingsFlash::unlock();
+  size_t rest = desc.length;
+  uint32_t start = address(desc);
+  for (uint32_t addr = start; addr < start + desc.alignedSize; addr += FLASH_PAGE_SIZE) {
+    if (!ss_blank(SettingsFlash::ptr(addr), FLASH_PAGE_SIZE)) {
+      SettingsFlash::erasePage(addr);
+    }
+    size_t chunk = rest > FLASH_PAGE_SIZE ? FLASH_PAGE_SIZE : rest;
+    SettingsFlash::programPage(addr, buf, chunk);
+    buf += chunk;
+    rest -= chunk;
+  }
+  SettingsFlash::lock();
+  return true;
+}
+
+//==============================================================================
+// Данные прямо во flash, без копирования в RAM
+//  @param desc - описатель хранилища
+//  @return     - указатель на данные во flash или nullptr при ошибке CRC
+//------------------------------------------------------------------------------
+const void *SettingsStatic::view(const SettingsDesc &desc) {
+  if (!SettingsFlash::valid(address(desc), desc.alignedSize)) {
+    return nullptr;
+  }
+  const uint8_t *data = SettingsFlash::ptr(address(desc));
+  if (desc.flags & SETTINGS_DESC_CRC) {
+    uint16_t stored_crc;
+    memcpy(&stored_crc, data + desc.length - 2, 2);
+    if (stored_crc != ss_crc16(0xFFFF, data, desc.length - 2)) {
+      return nullptr;
+    }
+  }
+  return data;
+}
+
+// ******************** Вспомогательные функции ********************
+
+//==============================================================================
+// Адрес области: указатель на резерв (значение подставил компоновщик) или адрес,
+// посчитанный при компиляции
+//------------------------------------------------------------------------------
+uint32_t SettingsStatic::address(const SettingsDesc &desc) {
+  return desc.area ? (uint32_t)(uintptr_t)desc.area : desc.address;
+}
@@ -0,0 +1,129 @@
+#ifndef SETTINGS_DESC_H
+#define SETTINGS_DESC_H
+
+// Описатель хранилища, целиком вычисляемый при компиляции и размещаемый в .rodata.
+// Объект SettingsStore держит в RAM указатель на буфер, адрес, размеры и признаки - все это
+// известно при сборке. Описатель SettingsDesc - constexpr-структура с теми же данными, а
+// SettingsStatic - функции без состояния, работающие с ним: хранилище не занимает RAM,
+// кроме буфера самих настроек.
+//
+// Пример (несколько хранилищ друг под другом от конца flash):
+//   AppConfig cfg;
+//   Calibration cal;
+//   SETTINGS_DESC(cfgDesc, cfg, SETTINGS_DESC_CRC);               // Верхние страницы flash
+//   SETTINGS_DESC_BELOW(calDesc, cal, SETTINGS_DESC_CRC, cfgDesc); // Под cfgDesc
+//   ...
+//   if (!SettingsStatic::load(cfgDesc)) { ... значения по умолчанию ... }
+//   SettingsStatic::save(cfgDesc);
+//
+// Адрес может дать и компоновщик: SETTINGS_DESC_RESERVED резервирует страницы через
+// SETTINGS_RESERVE() (ld/settings_store.ld) и кладет в описатель указатель на область -
+// его значение подставляет компоновщик, расчета при работе нет.
+//
+// Режимы дерева хешей, ленивой загрузки и статистика - только у SettingsStore.
+
+#include "SettingsFlash.h"
+#include "SettingsKernels.h"
+#include "SettingsReserve.h"
+#include <string.h>
+
+#define SETTINGS_DESC_CRC 0x01   // Последние 2 байта буфера - CRC16
+#define SETTINGS_DESC_FORCE 0x02 // Запись без проверки, что данные изменились
+
+struct SettingsDesc {
+  void *buf;            // Буфер настроек в RAM
+  uint32_t address;     // Начальный адрес во flash
+  uint16_t length;      // Размер данных
+  uint16_t alignedSize; // Размер области во flash, кратный странице
+  uint8_t flags;        // SETTINGS_DESC_*
+  const uint8_t *area;  // Область из SETTINGS_RESERVE() (nullptr - адрес в address)
+};
+
+// Не constexpr: вызов при построении описателя - ошибка компиляции
+void settings_desc_error_crc_needs_2_bytes(void);
+void settings_desc_error_too_large(void);           // Область больше 0xFFFF байт (поля uint16_t)
+void settings_desc_error_below_flash(void);         // Область выходит за начало flash
+void settings_desc_error_below_reserved(void);      // SETTINGS_DESC_BELOW под SETTINGS_DESC_RESERVED
+
+//==============================================================================
+// Проверки, общие для всех описателей
+//  @param length - размер буфера (sizeof)
+//  @param flags  - SETTINGS_DESC_*
+//  @return       - размер области, кратный странице
+//------------------------------------------------------------------------------
+constexpr uint16_t settingsDescAligned(size_t length, uint8_t flags) {
+  if ((flags & SETTINGS_DESC_CRC) && length < 2) {
+    settings_desc_error_crc_needs_2_bytes();
+  }
+  if (SETTINGS_PAGES_SIZE(length) > 0xFFFF) {
+    settings_desc_error_too_large();
+  }
+  return (uint16_t)SETTINGS_PAGES_SIZE(length);
+}
+
+//==============================================================================
+// Описатель области, заканчивающейся по адресу end (по умолчанию - конец flash)
+//  @param buf    - буфер настроек
+//  @param length - размер буфера (sizeof)
+//  @param flags  - SETTINGS_DESC_*
+//  @param end    - адрес конца области (начало предыдущей области или FLASH_END_ADDR)
+//------------------------------------------------------------------------------
+constexpr SettingsDesc settingsDesc(void *buf, size_t length, uint8_t flags, uint32_t end = FLASH_END_ADDR) {
+  uint16_t aligned = settingsDescAligned(length, flags);
+  if (end < FLASH_BASE_ADDR + aligned) {
+    settings_desc_error_below_flash();
+  }
+  return SettingsDesc{buf, end - aligned, (uint16_t)length, aligned, flags, nullptr};
+}
+
+//==============================================================================
+// Описатель области сразу под областью prev
+//  @param buf    - буфер настроек
+//  @param length - размер буфера (sizeof)
+//  @param flags  - SETTINGS_DESC_*
+//  @param prev   - описатель с адресом, посчитанным при компиляции (не SETTINGS_DESC_RESERVED:
+//                  его адрес известен только компоновщику)
+//------------------------------------------------------------------------------
+constexpr SettingsDesc settingsDescBelow(void *buf, size_t length, uint8_t flags, const SettingsDesc &prev) {
+  if (prev.area != nullptr) {
+    settings_desc_error_below_reserved();
+  }
+  return settingsDesc(buf, length, flags, prev.address);
+}
+
+//==============================================================================
+// Описатель области, зарезервированной при компоновке
+//  @param buf    - буфер настроек
+//  @param length - размер буфера (sizeof)
+//  @param flags  - SETTINGS_DESC_*
+//  @param area   - область SETTINGS_RESERVE() не меньше length
+//------------------------------------------------------------------------------
+constexpr SettingsDesc settingsDescReserved(void *buf, size_t length, uint8_t flags, const uint8_t *area) {
+  uint16_t aligned = settingsDescAligned(length, flags);
+  return SettingsDesc{buf, 0, (uint16_t)length, aligned, flags, area};
+}
+
+// Описатель хранилища для переменной var на верхних страницах flash
+#define SETTINGS_DESC(name, var, flags) static constexpr SettingsDesc name = settingsDesc(&(var), sizeof(var), flags)
+
+// Описатель хранилища для переменной var сразу под областью описателя prev
+// (SETTINGS_DESC_RESERVED в качестве prev - ошибка компиляции)
+#define SETTINGS_DESC_BELOW(name, var, flags, prev) \
+  static constexpr SettingsDesc name = settingsDescBelow(&(var), sizeof(var), flags, prev)
+
+// Описатель хранилища для переменной var в области, зарезервированной при компоновке
+#define SETTINGS_DESC_RESERVED(name, var, flags) \
+  SETTINGS_RESERVE(name, sizeof(var));          \
+  static constexpr SettingsDesc name = settingsDescReserved(&(var), sizeof(var), flags, settings_area_##name)
+
+class SettingsStatic {
+  public:
+  static bool load(const SettingsDesc &desc);        // Чтение из flash; false - ошибка CRC
+  static bool save(const SettingsDesc &desc);        // Запись во flash; false - данные не изменились
+  static const void *view(const SettingsDesc &desc); // Данные прямо во flash (nullptr при ошибке CRC)
+
+  private:
+  static uint32_t address(const SettingsDesc &desc); // Адрес области: из компоновщика или расчетный
+};
+
+#endif // SETTINGS_DESC_H
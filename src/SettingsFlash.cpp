@@ -0,0 +1,233 @@
+//============================================================= (c) A.Kolesov ==
+// SettingsFlash.cpp
+// Низкоуровневые функции работы с flash CH32V003: постраничное стирание и
+// программирование в Fast mode, прямое чтение.
+//------------------------------------------------------------------------------
+#ifndef SETTINGS_STORE_HOST
+
+#include "SettingsFlash.h"
+#include <string.h>
+
+#ifdef SETTINGS_STORE_STATS
+uint32_t SettingsFlash::busyCycles[FLASH_OP_COUNT];
+uint32_t SettingsFlash::sleepCycles;
+uint32_t SettingsFlash::wakeups;
+#endif
+
+#ifdef SETTINGS_STORE_FLASH_IRQ
+#define SS_MSTATUS_IRQ 0x88 // mstatus: MIE и MPIE (их же сбрасывает __disable_irq() SDK)
+
+//==============================================================================
+// Запрет прерываний с сохранением прежнего состояния (атомарно: чтение и сброс CSR)
+//  @return - прежние биты MIE/MPIE для ss_irq_restore()
+//------------------------------------------------------------------------------
+static inline uint32_t ss_irq_save(void) {
+  uint32_t state;
+  __asm volatile("csrrc %0, mstatus, %1" : "=r"(state) : "r"(SS_MSTATUS_IRQ) : "memory");
+  return state & SS_MSTATUS_IRQ;
+}
+
+//==============================================================================
+// Восстановление состояния прерываний: включаются, только если были включены
+//------------------------------------------------------------------------------
+static inline void ss_irq_restore(uint32_t state) {
+  __asm volatile("csrs mstatus, %0" : : "r"(state) : "memory");
+}
+#endif
+
+//==============================================================================
+// Указатель на данные во flash. Flash отображена в адресное пространство,
+// поэтому данные можно читать напрямую, без копирования в RAM.
+//  @param addr - адрес во flash
+//------------------------------------------------------------------------------
+const uint8_t *SettingsFlash::ptr(uint32_t addr) {
+  return (const uint8_t *)addr;
+}
+
+//==============================================================================
+// Диапазон адресов целиком внутри flash
+//  @param addr - начало диапазона
+//  @param len  - размер диапазона
+//------------------------------------------------------------------------------
+bool SettingsFlash::valid(uint32_t addr, size_t len) {
+  return addr >= FLASH_BASE_ADDR && addr <= FLASH_END_ADDR && len <= FLASH_END_ADDR - addr;
+}
+
+//==============================================================================
+// Разблокировка записи во flash и режима Fast programming
+//------------------------------------------------------------------------------
+void SettingsFlash::unlock() {
+  // Разблокировка записи во flash
+  FLASH->KEYR = FLASH_KEY1;
+  FLASH->KEYR = FLASH_KEY2;
+
+  // Разблокировка Fast Programming
+  FLASH->MODEKEYR = FLASH_KEY1;
+  FLASH->MODEKEYR = FLASH_KEY2;
+
+#ifdef SETTINGS_STORE_FLASH_IRQ
+  FLASH->STATR = SR_EOP;    // Сброс флага от предыдущих операций
+  FLASH->CTLR |= CR_EOPIE;  // Прерывание по окончании операции
+  NVIC_EnableIRQ(FLASH_IRQn);
+#endif
+}
+
+//==============================================================================
+// Блокировка записи во flash
+//------------------------------------------------------------------------------
+void SettingsFlash::lock() {
+#ifdef SETTINGS_STORE_FLASH_IRQ
+  NVIC_DisableIRQ(FLASH_IRQn);
+  FLASH->CTLR &= ~CR_EOPIE;
+#endif
+  FLASH->CTLR |= CR_FLOCK_Set;
+  FLASH->CTLR |= CR_LOCK_Set;
+}
+
+//==============================================================================
+// Стирание одной страницы flash. Запись должна быть разблокирована (unlock()).
+//  @param addr - адрес начала страницы
+//------------------------------------------------------------------------------
+void SettingsFlash::erasePage(uint32_t addr) {
+  FLASH->CTLR |= CR_PAGE_ER;  // Включение режима быстрого (постраничного) стирания
+  FLASH->ADDR = addr;         // Адрес начала стирания
+  FLASH->CTLR |= CR_STRT_Set; // Запуск стирания
+  waitBusy(FLASH_OP_ERASE);   // Ждем окончания стирания
+  FLASH->CTLR &= ~CR_PAGE_ER; // Выключение режима быстрого (постраничного) стирания
+}
+
+//==============================================================================
+// Программирование одной страницы flash. Страница должна быть предварительно стерта,
+// запись разблокирована (unlock()).
+// Если данных меньше страницы, остаток добивается 0xFF (так же, как у стертой flash).
+//  @param addr - адрес начала страницы
+//  @param data - данные для записи (выравнивание не требуется)
+//  @param len  - количество байт данных, не больше FLASH_PAGE_SIZE
+//------------------------------------------------------------------------------
+void SettingsFlash::programPage(uint32_t addr, const uint8_t *data, size_t len) {
+  uint32_t startAddr = addr; // Адрес слова на странице
+
+  FLASH->CTLR |= CR_PAGE_PG; // Режим записи постранично
+  FLASH->CTLR |= CR_BUF_RST; // Сброс буфера
+  waitBusy(FLASH_OP_LOAD);
+
+  uint8_t cnt = FLASH_PAGE_SIZE >> 2; // 16 - кол-во 4-х байтных слов на странице flash
+  while (cnt) {
+    uint32_t val = 0xFFFFFFFF; // Все данные записаны во flash - добиваем страницу "пустышками"
+    if (len >= 4) {
+      memcpy(&val, data, 4);
+      data += 4;
+      len -= 4;
+    } else if (len > 0) { // Неполное последнее слово: за пределами данных тоже 0xFF
+      memcpy(&val, data, len);
+      len = 0;
+    }
+
+    *(__IO uint32_t *)(startAddr) = val;
+    FLASH->CTLR |= CR_BUF_LOAD; // Перенос даных из буфера непосредственно во flash.
+    waitBusy(FLASH_OP_LOAD);
+    startAddr += 4; // Переход к начальному адресу следующего записываемого слова
+    cnt--;
+  }
+
+  FLASH->CTLR |= CR_PAGE_PG;
+  FLASH->ADDR = addr;
+  FLASH->CTLR |= CR_STRT_Set;
+  waitBusy(FLASH_OP_PROGRAM);
+  FLASH->CTLR &= ~CR_PAGE_PG;
+}
+
+//==============================================================================
+// Программирование одного полуслова в стандартном режиме (не Fast mode). Полуслово
+// должно быть стерто (0xFFFF), запись разблокирована (unlock()). Используется там,
+// где страница дописывается по частям без стирания (FlashQueue).
+//  @param addr  - адрес полуслова (четный)
+//  @param value - записываемое значение
+//------------------------------------------------------------------------------
+void SettingsFlash::programHalfWord(uint32_t addr, uint16_t value) {
+  FLASH->CTLR |= CR_PG_Set;
+  *(__IO uint16_t *)addr = value;
+  waitBusy(FLASH_OP_PROGRAM);
+  FLASH->CTLR &= CR_PG_Reset;
+}
+
+//==============================================================================
+// Ожидание окончания операции flash (сброса SR_BSY).
+// При включенной статистике считает такты ожидания по типу операции.
+// В режиме SETTINGS_STORE_FLASH_IRQ на время стирания и программирования ядро спит (WFI).
+// Прерывания на время проверки SR_BSY и входа в WFI запрещены: если операция закончится
+// между проверкой и WFI, отложенное прерывание все равно разбудит ядро. Если разбудило
+// другое прерывание, прерывания на мгновение восстанавливаются: его обработчик снимает флаг,
+// и следующий WFI снова спит (обработчик во flash при этом ждет окончания операции - выборка
+// команд из занятой flash стоит). После ожидания восстанавливается прежнее состояние: вызов
+// из критической секции ее не нарушает, но тогда другое ожидающее прерывание превращает
+// ожидание в опрос. Статистика отдельно считает такты во сне и такие пробуждения.
+//  @param op - тип операции (FLASH_OP_ERASE, FLASH_OP_LOAD, FLASH_OP_PROGRAM)
+//------------------------------------------------------------------------------
+void SettingsFlash::waitBusy(uint8_t op) {
+#ifdef SETTINGS_STORE_FLASH_IRQ
+  if (op != FLASH_OP_LOAD) {
+#ifdef SETTINGS_STORE_STATS
+    uint32_t start = SysTick->CNT;
+#endif
+    uint32_t irq = ss_irq_save();
+    while (FLASH->STATR & SR_BSY) {
+#ifdef SETTINGS_STORE_STATS
+      uint32_t sleep = SysTick->CNT;
+      __WFI();
+      sleepCycles += (SysTick->CNT - sleep) * ((SysTick->CTLR & 0x4) ? 1 : 8);
+#else
+      __WFI();
+#endif
+      if (FLASH->STATR & SR_BSY) { // Разбудило не окончание операции
+#ifdef SETTINGS_STORE_STATS
+        wakeups++;
+#endif
+        ss_irq_restore(irq); // Окно для обработчика (если прерывания были разрешены)
+        ss_irq_save();
+      }
+    }
+    FLASH->STATR = SR_EOP;
+    ss_irq_restore(irq);
+#ifdef SETTINGS_STORE_STATS
+    // SysTick считает от HCLK или HCLK/8 (бит STCLK)
+    busyCycles[op] += (SysTick->CNT - start) * ((SysTick->CTLR & 0x4) ? 1 : 8);
+#endif
+    return;
+  }
+#endif
+#ifdef SETTINGS_STORE_STATS
+  uint32_t polls = 0;
+  while (FLASH->STATR & SR_BSY) {
+    polls++;
+  }
+  busyCycles[op] += polls * FLASH_BSY_POLL_CYCLES;
+#else
+  (void)op;
+  while (FLASH->STATR & SR_BSY)
+    ;
+#endif
+}
+
+#ifdef SETTINGS_STORE_PROFILE
+//==============================================================================
+// Такты ядра от сброса: SysTick, запущенный после сброса с CNT = 0, считает от HCLK
+// или HCLK/8 (бит STCLK)
+//------------------------------------------------------------------------------
+uint32_t SettingsFlash::cycles() {
+  return SysTick->CNT * ((SysTick->CTLR & 0x4) ? 1 : 8);
+}
+#endif
+
+#ifdef SETTINGS_STORE_FLASH_IRQ
+//==============================================================================
+// Прерывание окончания операции flash: только сброс флага, ядро просыпается
+// и продолжает waitBusy().
+//------------------------------------------------------------------------------
+extern "C" void FLASH_IRQHandler(void) __attribute__((interrupt));
+extern "C" void FLASH_IRQHandler(void) {
+  FLASH->STATR = SR_EOP;
+}
+#endif
+
+#endif // SETTINGS_STORE_HOST
@@ -0,0 +1,163 @@
+#ifndef SETTINGS_FLASH_H
+#define SETTINGS_FLASH_H
+
+// Низкоуровневый доступ к flash: стирание и программирование страниц, прямое чтение.
+// Для микроконтроллера работает с регистрами FLASH, а при сборке с -DSETTINGS_STORE_HOST
+// (Linux-шлюзы, утилиты) — с файлом, отображенным в память через mmap, в том же формате,
+// что и область настроек во flash.
+
+#ifdef SETTINGS_STORE_HOST
+#include <stddef.h>
+#include <stdint.h>
+extern uint32_t SystemCoreClock; // На хосте определяется в SettingsFlashHost.cpp
+#else
+#include <ch32v00x.h>
+#endif
+
+// === Настройки flash ===
+#ifndef FLASH_PAGE_SIZE
+#define FLASH_PAGE_SIZE 64
+#endif
+
+#ifndef FLASH_END_ADDR
+#define FLASH_END_ADDR 0x08004000U // 16 КБ flash: 0x08000000 + 0x4000
+#endif
+
+#ifndef FLASH_BASE_ADDR
+#define FLASH_BASE_ADDR 0x08000000U // Начало flash
+#endif
+
+// Flash Control Register bits
+#define CR_PG_Set ((uint32_t)0x00000001)
+#define CR_PG_Reset ((uint32_t)0xFFFFFFFE)
+#define CR_PER_Set ((uint32_t)0x00000002)
+#define CR_PER_Reset ((uint32_t)0xFFFFFFFD)
+#define CR_MER_Set ((uint32_t)0x00000004)
+#define CR_MER_Reset ((uint32_t)0xFFFFFFFB)
+#define CR_OPTPG_Set ((uint32_t)0x00000010)
+#define CR_OPTPG_Reset ((uint32_t)0xFFFFFFEF)
+#define CR_OPTER_Set ((uint32_t)0x00000020)
+#define CR_OPTER_Reset ((uint32_t)0xFFFFFFDF)
+#define CR_STRT_Set ((uint32_t)0x00000040)
+#define CR_LOCK_Set ((uint32_t)0x00000080)
+#define CR_FLOCK_Set ((uint32_t)0x00008000)
+#define CR_PAGE_PG ((uint32_t)0x00010000)
+#define CR_PAGE_ER ((uint32_t)0x00020000)
+#define CR_BUF_LOAD ((uint32_t)0x00040000)
+#define CR_BUF_RST ((uint32_t)0x00080000)
+
+#define CR_EOPIE ((uint32_t)0x00001000)
+
+// FLASH Status Register bits
+#define SR_BSY ((uint32_t)0x00000001)
+#define SR_EOP ((uint32_t)0x00000020)
+
+// FLASH Keys
+// Блокировка записи во flash устанавливается одним битом в регистре, а вот снятие блокировки
+// разработчики сделали в виде последовательной записи в CTRL-регистр вот таких ключей.
+// Видимо, для того, чтобы случайно нельзя было разблокировать запись во flash, т.к. адресное
+// пространство общее и запросто можно по ошибке не туда написать.
+#define FLASH_KEY1 ((uint32_t)0x45670123)
+#define FLASH_KEY2 ((uint32_t)0xCDEF89AB)
+
+// === Учет энергии flash-операций (опционально) ===
+// Включается определением SETTINGS_STORE_STATS (например, в build_flags: -DSETTINGS_STORE_STATS).
+// Циклы ожидания SR_BSY считаются по типам операций, а по заданным ниже токам потребления
+// оценивается затраченная энергия. Токи ориентировочные — уточните измерениями на своей плате.
+#ifndef FLASH_ERASE_CURRENT_UA
+#define FLASH_ERASE_CURRENT_UA 2500 // Ток во время стирания страницы, мкА
+#endif
+
+#ifndef FLASH_LOAD_CURRENT_UA
+#define FLASH_LOAD_CURRENT_UA 1500 // Ток во время загрузки слова в буфер страницы, мкА
+#endif
+
+#ifndef FLASH_PROGRAM_CURRENT_UA
+#define FLASH_PROGRAM_CURRENT_UA 2500 // Ток во время программирования страницы, мкА
+#endif
+
+#ifndef FLASH_SUPPLY_MV
+#define FLASH_SUPPLY_MV 3300 // Напряжение питания, мВ
+#endif
+
+#ifndef FLASH_BSY_POLL_CYCLES
+#define FLASH_BSY_POLL_CYCLES 8 // Тактов ядра на одну итерацию цикла ожидания SR_BSY
+#endif
+
+// === Ожидание по прерыванию (опционально) ===
+// Включается определением SETTINGS_STORE_FLASH_IRQ. Вместо опроса SR_BSY на время стирания и
+// программирования страницы ядро засыпает (WFI) и просыпается по прерыванию окончания операции
+// (EOP). Пока flash занята, выборка команд из нее останавливается, поэтому функции, запускающие
+// операцию и ожидающие ее окончания, размещаются в SRAM (SS_RAMFUNC). Секция ".highcode" должна
+// копироваться в RAM скриптом компоновщика и стартовым кодом (как .data); при другом скрипте
+// переопределите SS_RAMFUNC. Загрузка слов в буфер страницы короткая и по-прежнему ждется опросом.
+// При включенной статистике время ожидания в этом режиме меряется по SysTick->CNT (SysTick должен
+// быть запущен), а при оценке энергии из тока вычитается FLASH_WFI_SAVING_UA - экономия тока
+// ядра во сне - только за время, действительно проведенное в WFI (sleepCycles). WFI будит и
+// любое другое разрешенное прерывание: тогда прерывания ненадолго разрешаются, чтобы его
+// обработчик выполнился и снял флаг (wakeups), иначе каждый следующий WFI возвращался бы сразу.
+// Из критической секции (прерывания запрещены вызывающим) такого окна нет, и ожидание при
+// других ожидающих прерываниях вырождается в опрос - экономии нет.
+#ifdef SETTINGS_STORE_FLASH_IRQ
+#ifndef SS_RAMFUNC
+#define SS_RAMFUNC __attribute__((section(".highcode"), noinline))
+#endif
+#ifndef FLASH_WFI_SAVING_UA
+#define FLASH_WFI_SAVING_UA 1000 // Насколько меньше ток в WFI, чем при опросе SR_BSY, мкА
+#endif
+#else
+#define SS_RAMFUNC
+#endif
+
+// === Профилирование загрузки (опционально) ===
+// Включается определением SETTINGS_STORE_PROFILE. load() отмечает такты от сброса до своего
+// окончания и длительность фаз (проверка заголовка, копирование, CRC). Отсчет - SysTick->CNT:
+// SysTick нужно запустить с CNT = 0 первым делом после сброса (до конструкторов и load()).
+// На хосте такты считаются от первого вызова по часам CLOCK_MONOTONIC с частотой SystemCoreClock.
+
+// Типы flash-операций, для которых ведется учет циклов ожидания
+#define FLASH_OP_ERASE 0   // Стирание страницы
+#define FLASH_OP_LOAD 1    // Загрузка слова в буфер страницы
+#define FLASH_OP_PROGRAM 2 // Программирование страницы
+#define FLASH_OP_COUNT 3
+
+class SettingsFlash {
+  public:
+  static const uint8_t *ptr(uint32_t addr);                                 // Указатель на данные во flash (без копирования)
+  static bool valid(uint32_t addr, size_t len);                             // Диапазон целиком во flash (на хосте - в образе)
+  static void unlock(void);                                                 // Разблокировка записи во flash
+  static void lock(void);                                                   // Блокировка записи (на хосте - сброс грязных страниц на диск)
+  static SS_RAMFUNC void erasePage(uint32_t addr);                                     // Стирание одной страницы
+  static SS_RAMFUNC void programPage(uint32_t addr, const uint8_t *data, size_t len); // Программирование одной страницы
+  static SS_RAMFUNC void programHalfWord(uint32_t addr, uint16_t value);              // Программирование полуслова (стандартный режим)
+  static SS_RAMFUNC void waitBusy(uint8_t op);                                         // Ожидание окончания операции flash
+
+  //============================================================================
+  // Перезапись одной страницы целиком: разблокировка, стирание, программирование, блокировка
+  //  @param addr - адрес начала страницы
+  //  @param data - FLASH_PAGE_SIZE байт данных
+  //----------------------------------------------------------------------------
+  static void writePage(uint32_t addr, const uint8_t *data) {
+    unlock();
+    erasePage(addr);
+    programPage(addr, data, FLASH_PAGE_SIZE);
+    lock();
+  }
+
+#ifdef SETTINGS_STORE_PROFILE
+  static uint32_t cycles(void); // Такты ядра от сброса (SysTick)
+#endif
+
+#ifdef SETTINGS_STORE_STATS
+  static uint32_t busyCycles[FLASH_OP_COUNT]; // Такты ожидания SR_BSY по типам операций (всего)
+  static uint32_t sleepCycles;                // Такты во сне WFI (всего; только SETTINGS_STORE_FLASH_IRQ)
+  static uint32_t wakeups;                    // Пробуждения WFI не по окончании операции (всего)
+#endif
+
+#ifdef SETTINGS_STORE_HOST
+  static bool hostOpen(const char *path, size_t size, bool relaxed); // Отображение файла на верхние size байт flash
+  static void hostClose(void);                                       // Закрытие файла
+#endif
+};
+
+#endif // SETTINGS_FLASH_H
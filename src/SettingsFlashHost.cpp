@@ -0,0 +1,232 @@
+//============================================================= (c) A.Kolesov ==
+// SettingsFlashHost.cpp
+// Хост-реализация (Linux/POSIX) низкоуровневых функций flash для сборки с
+// -DSETTINGS_STORE_HOST.
+//
+// "Flash" — это файл, отображенный в память через mmap на верхние size байт
+// адресного пространства flash, т.е. [FLASH_END_ADDR - size, FLASH_END_ADDR).
+// Формат файла совпадает с дампом этой области с микроконтроллера, поэтому одни и те же
+// настройки можно читать и писать на узле и на шлюзе.
+//
+// Семантика стирания/программирования как у NOR-flash: стирание заполняет страницу 0xFF,
+// программирование может только сбрасывать биты (dst &= src). В "мягком" режиме (relaxed)
+// программирование просто копирует данные.
+// Изменения сбрасываются на диск в lock() через msync() только для измененных страниц.
+//------------------------------------------------------------------------------
+#ifdef SETTINGS_STORE_HOST
+
+#include "SettingsFlash.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+uint32_t SystemCoreClock = 48000000; // Для оценки энергии в статистике (на хосте не используется)
+
+#ifdef SETTINGS_STORE_STATS
+uint32_t SettingsFlash::busyCycles[FLASH_OP_COUNT];
+uint32_t SettingsFlash::sleepCycles;
+uint32_t SettingsFlash::wakeups;
+#endif
+
+static uint8_t *hostBase = nullptr; // Начало отображенного файла
+static size_t hostSize = 0;         // Размер отображенной области
+static uint32_t hostAddr = 0;       // Адрес flash, соответствующий началу файла
+static bool hostRelaxed = false;    // Программирование без NOR-семантики
+static size_t dirtyFrom = 0;        // Диапазон измененных байт [dirtyFrom, dirtyTo)
+static size_t dirtyTo = 0;
+
+//==============================================================================
+// Отображение файла на верхнюю часть flash. Если файла нет, он создается
+// и заполняется 0xFF (стертая flash).
+//  @param path    - путь к файлу-образу
+//  @param size    - размер области, кратно FLASH_PAGE_SIZE
+//  @param relaxed - true: программирование без NOR-семантики (простое копирование)
+//  @return        - true при успехе
+//------------------------------------------------------------------------------
+bool SettingsFlash::hostOpen(const char *path, size_t size, bool relaxed) {
+  if (hostBase != nullptr || size == 0 || size % FLASH_PAGE_SIZE != 0 || size > FLASH_END_ADDR) {
+    return false;
+  }
+  int fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    return false;
+  }
+  size_t oldSize = (size_t)st.st_size;
+  if (oldSize < size && ftruncate(fd, (off_t)size) != 0) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd); // Отображение остается действительным и после закрытия файла
+  if (map == MAP_FAILED) {
+    return false;
+  }
+  hostBase = (uint8_t *)map;
+  hostSize = size;
+  hostAddr = FLASH_END_ADDR - (uint32_t)size;
+  hostRelaxed = relaxed;
+  dirtyFrom = size;
+  dirtyTo = 0;
+  if (oldSize < size) { // Новая часть файла - "стертая" flash
+    memset(hostBase + oldSize, 0xFF, size - oldSize);
+    dirtyFrom = oldSize;
+    dirtyTo = size;
+    lock();
+  }
+  return true;
+}
+
+//==============================================================================
+// Сброс изменений на диск и закрытие файла-образа
+//------------------------------------------------------------------------------
+void SettingsFlash::hostClose() {
+  if (hostBase == nullptr) {
+    return;
+  }
+  lock();
+  munmap(hostBase, hostSize);
+  hostBase = nullptr;
+  hostSize = 0;
+}
+
+//==============================================================================
+// Указатель на данные в отображенном файле.
+//  @param addr - адрес во flash
+//  @return     - указатель или nullptr, если адрес вне отображенной области (конец
+//                области - допустимый адрес, как у указателя за последний элемент массива)
+//------------------------------------------------------------------------------
+const uint8_t *SettingsFlash::ptr(uint32_t addr) {
+  if (hostBase == nullptr || addr < hostAddr || addr - hostAddr > hostSize) {
+    return nullptr;
+  }
+  return hostBase + (addr - hostAddr);
+}
+
+//==============================================================================
+// Диапазон адресов целиком внутри отображенного образа. Проверяется один раз при
+// открытии хранилища: дальше ptr() в этом диапазоне не возвращает nullptr.
+//  @param addr - начало диапазона
+//  @param len  - размер диапазона
+//------------------------------------------------------------------------------
+bool SettingsFlash::valid(uint32_t addr, size_t len) {
+  return hostBase != nullptr && addr >= hostAddr && addr - hostAddr <= hostSize && len <= hostSize - (addr - hostAddr);
+}
+
+//==============================================================================
+// Разблокировка записи: на хосте ничего делать не нужно.
+//------------------------------------------------------------------------------
+void SettingsFlash::unlock() {
+}
+
+//==============================================================================
+// Блокировка записи: сброс на диск только измененных страниц.
+//------------------------------------------------------------------------------
+void SettingsFlash::lock() {
+  if (hostBase == nullptr || dirtyFrom >= dirtyTo) {
+    return;
+  }
+  size_t sysPage = (size_t)sysconf(_SC_PAGESIZE);
+  size_t from = dirtyFrom & ~(sysPage - 1); // msync требует адрес, выровненный по странице ОС
+  msync(hostBase + from, dirtyTo - from, MS_SYNC);
+  dirtyFrom = hostSize;
+  dirtyTo = 0;
+}
+
+//==============================================================================
+// Отметка измененного диапазона для последующего msync()
+//------------------------------------------------------------------------------
+static void markDirty(size_t offset, size_t len) {
+  if (offset < dirtyFrom) {
+    dirtyFrom = offset;
+  }
+  if (offset + len > dirtyTo) {
+    dirtyTo = offset + len;
+  }
+}
+
+//==============================================================================
+// Стирание одной страницы: заполнение 0xFF.
+//  @param addr - адрес начала страницы
+//------------------------------------------------------------------------------
+void SettingsFlash::erasePage(uint32_t addr) {
+  uint8_t *page = (uint8_t *)ptr(addr);
+  if (page == nullptr) {
+    return;
+  }
+  memset(page, 0xFF, FLASH_PAGE_SIZE);
+  markDirty(addr - hostAddr, FLASH_PAGE_SIZE);
+}
+
+//==============================================================================
+// Программирование одной страницы. Остаток страницы после данных не меняется
+// (на микроконтроллере он программируется 0xFF, что для NOR то же самое).
+//  @param addr - адрес начала страницы
+//  @param data - данные для записи
+//  @param len  - количество байт данных, не больше FLASH_PAGE_SIZE
+//------------------------------------------------------------------------------
+void SettingsFlash::programPage(uint32_t addr, const uint8_t *data, size_t len) {
+  uint8_t *page = (uint8_t *)ptr(addr);
+  if (page == nullptr) {
+    return;
+  }
+  if (hostRelaxed) {
+    memcpy(page, data, len);
+    memset(page + len, 0xFF, FLASH_PAGE_SIZE - len);
+  } else {
+    for (size_t i = 0; i < len; ++i) {
+      page[i] &= data[i]; // NOR: программирование только сбрасывает биты
+    }
+  }
+  markDirty(addr - hostAddr, FLASH_PAGE_SIZE);
+}
+
+//==============================================================================
+// Программирование одного полуслова.
+//  @param addr  - адрес полуслова (четный)
+//  @param value - записываемое значение
+//------------------------------------------------------------------------------
+void SettingsFlash::programHalfWord(uint32_t addr, uint16_t value) {
+  uint8_t *p = (uint8_t *)ptr(addr);
+  if (p == nullptr) {
+    return;
+  }
+  uint8_t bytes[2] = {(uint8_t)value, (uint8_t)(value >> 8)};
+  for (int i = 0; i < 2; ++i) {
+    p[i] = hostRelaxed ? bytes[i] : (uint8_t)(p[i] & bytes[i]); // NOR: только сброс битов
+  }
+  markDirty(addr - hostAddr, 2);
+}
+
+//==============================================================================
+// Ожидание окончания операции: на хосте операции синхронные.
+//------------------------------------------------------------------------------
+void SettingsFlash::waitBusy(uint8_t op) {
+  (void)op;
+}
+
+#ifdef SETTINGS_STORE_PROFILE
+//==============================================================================
+// Такты от первого вызова (на хосте "сброс" - запуск программы), по часам
+// CLOCK_MONOTONIC с частотой SystemCoreClock
+//------------------------------------------------------------------------------
+uint32_t SettingsFlash::cycles() {
+  static uint64_t startNs = 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  uint64_t ns = (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+  if (startNs == 0) {
+    startNs = ns;
+  }
+  return (uint32_t)((ns - startNs) * SystemCoreClock / 1000000000ULL);
+}
+#endif
+
+#endif // SETTINGS_STORE_HOST
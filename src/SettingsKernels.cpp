@@ -0,0 +1,74 @@
+//============================================================= (c) A.Kolesov ==
+// SettingsKernels.cpp
+// C++-версии горячих циклов хранилища. Используются, если ассемблерные ядра
+// (SettingsStoreAsm.S) не подключены, и служат эталоном при их проверке.
+//------------------------------------------------------------------------------
+#if !defined(SETTINGS_STORE_ASM) || defined(SETTINGS_STORE_HOST)
+
+#include "SettingsKernels.h"
+
+//==============================================================================
+// Копирование
+//  @param dst - куда
+//  @param src - откуда
+//  @param len - количество байт
+//------------------------------------------------------------------------------
+void ss_copy(void *dst, const void *src, size_t len) {
+  uint8_t *d = (uint8_t *)dst;
+  const uint8_t *s = (const uint8_t *)src;
+  for (size_t i = 0; i < len; ++i) {
+    d[i] = s[i];
+  }
+}
+
+//==============================================================================
+// Сравнение с выходом на первом отличии
+//  @return - 0, если данные совпадают, 1 - если отличаются
+//------------------------------------------------------------------------------
+int ss_compare(const void *a, const void *b, size_t len) {
+  const uint8_t *pa = (const uint8_t *)a;
+  const uint8_t *pb = (const uint8_t *)b;
+  for (size_t i = 0; i < len; ++i) {
+    if (pa[i] != pb[i]) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+//==============================================================================
+// Проверка, что все байты равны 0xFF (стертая flash)
+//  @return - 1, если все байты 0xFF
+//------------------------------------------------------------------------------
+int ss_blank(const void *p, size_t len) {
+  const uint8_t *b = (const uint8_t *)p;
+  for (size_t i = 0; i < len; ++i) {
+    if (b[i] != 0xFF) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+//==============================================================================
+// Продолжение расчета CRC16-CCITT (полином 0x1021), побитно
+//  @param crc  - CRC предыдущих частей (0xFFFF для первой)
+//  @param data - очередная часть данных
+//  @param len  - размер части
+//------------------------------------------------------------------------------
+uint16_t ss_crc16(uint16_t crc, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= (uint16_t)(p[i]) << 8;
+    for (int j = 0; j < 8; ++j) {
+      if (crc & 0x8000) {
+        crc = (crc << 1) ^ 0x1021;
+      } else {
+        crc <<= 1;
+      }
+    }
+  }
+  return crc;
+}
+
+#endif // SETTINGS_STORE_ASM
@@ -0,0 +1,18 @@
+#ifndef SETTINGS_KERNELS_H
+#define SETTINGS_KERNELS_H
+
+// Горячие циклы хранилища: копирование, сравнение, проверка на "пустоту" и CRC16.
+// При сборке с -DSETTINGS_STORE_ASM для микроконтроллера берутся ассемблерные версии
+// (SettingsStoreAsm.S), иначе - C++-версии (SettingsKernels.cpp).
+
+#include <stddef.h>
+#include <stdint.h>
+
+extern "C" {
+void ss_copy(void *dst, const void *src, size_t len);               // Копирование
+int ss_compare(const void *a, const void *b, size_t len);           // 0 - совпадают, 1 - отличаются
+int ss_blank(const void *p, size_t len);                            // 1 - все байты 0xFF
+uint16_t ss_crc16(uint16_t crc, const void *data, size_t len);      // Продолжение CRC16-CCITT
+}
+
+#endif // SETTINGS_KERNELS_H
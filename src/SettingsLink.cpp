@@ -0,0 +1,227 @@
+//============================================================= (c) A.Kolesov ==
+// SettingsLink.cpp
+// Двоичный обмен настройками по USART: чтение области настроек прямо из flash
+// и постраничная запись нового образа с подтверждением каждой страницы.
+//
+// Пример (в главном цикле):
+//   SettingsLink link(settings, usartPut, usartGet);
+//   ...
+//   if (link.poll()) {  // Пришел новый образ
+//     settings.load();
+//   }
+//------------------------------------------------------------------------------
+
+#include "SettingsLink.h"
+
+// Состояния разбора кадра
+#define RX_SYNC 0
+#define RX_CMD 1
+#define RX_LEN0 2
+#define RX_LEN1 3
+#define RX_DATA 4
+#define RX_CRC0 5
+#define RX_CRC1 6
+
+//==============================================================================
+// Конструктор разборщика кадров
+//  @param buf      - буфер для данных кадра
+//  @param capacity - размер буфера; кадры с большими данными отбрасываются
+//------------------------------------------------------------------------------
+SettingsFrame::SettingsFrame(uint8_t *buf, uint16_t capacity)
+    : buf(buf), capacity(capacity), state(RX_SYNC), pos(0), crc(0), rxCrc(0), cmd(0), len(0) {
+}
+
+//==============================================================================
+// Разбор очередного принятого байта
+//  @param b - принятый байт
+//  @return  - true, если принят целый кадр с верной CRC (cmd, len, data())
+//------------------------------------------------------------------------------
+bool SettingsFrame::feed(uint8_t b) {
+  switch (this->state) {
+  case RX_SYNC:
+    if (b == LINK_SYNC) {
+      this->state = RX_CMD;
+    }
+    break;
+  case RX_CMD:
+    this->cmd = b;
+    this->crc = SettingsStore::crc16Update(0xFFFF, &b, 1);
+    this->state = RX_LEN0;
+    break;
+  case RX_LEN0:
+    this->len = b;
+    this->crc = SettingsStore::crc16Update(this->crc, &b, 1);
+    this->state = RX_LEN1;
+    break;
+  case RX_LEN1:
+    this->len |= (uint16_t)b << 8;
+    this->crc = SettingsStore::crc16Update(this->crc, &b, 1);
+    this->pos = 0;
+    if (this->len > this->capacity) { // Слишком длинный кадр - ищем следующий
+      this->state = RX_SYNC;
+    } else {
+      this->state = this->len ? RX_DATA : RX_CRC0;
+    }
+    break;
+  case RX_DATA:
+    this->buf[this->pos++] = b;
+    this->crc = SettingsStore::crc16Update(this->crc, &b, 1);
+    if (this->pos == this->len) {
+      this->state = RX_CRC0;
+    }
+    break;
+  case RX_CRC0:
+    this->rxCrc = b;
+    this->state = RX_CRC1;
+    break;
+  case RX_CRC1:
+    this->rxCrc |= (uint16_t)b << 8;
+    this->state = RX_SYNC;
+    return this->rxCrc == this->crc;
+  }
+  return false;
+}
+
+//==============================================================================
+// Передача кадра целиком
+//  @param put  - функция передачи байта
+//  @param cmd  - команда
+//  @param data - данные (может быть nullptr при len = 0)
+//  @param len  - длина данных
+//------------------------------------------------------------------------------
+void SettingsFrame::send(LinkPutFn put, uint8_t cmd, const uint8_t *data, uint16_t len) {
+  uint8_t head[3] = {cmd, (uint8_t)len, (uint8_t)(len >> 8)};
+  uint16_t crc = SettingsStore::crc16Update(0xFFFF, head, sizeof(head));
+  crc = SettingsStore::crc16Update(crc, data, len);
+  put(LINK_SYNC);
+  for (uint8_t i = 0; i < sizeof(head); ++i) {
+    put(head[i]);
+  }
+  for (uint16_t i = 0; i < len; ++i) {
+    put(data[i]);
+  }
+  put((uint8_t)crc);
+  put((uint8_t)(crc >> 8));
+}
+
+//==============================================================================
+// Конструктор
+//  @param store - хранилище настроек
+//  @param put   - передача байта в USART
+//  @param get   - неблокирующий прием байта из USART (-1, если данных нет)
+//------------------------------------------------------------------------------
+SettingsLink::SettingsLink(SettingsStore &store, LinkPutFn put, LinkGetFn get)
+    : store(store), put(put), get(get), rx(rxBuf, sizeof(rxBuf)) {
+}
+
+//==============================================================================
+// Обработка всех принятых байт. Вызывать из главного цикла.
+//  @return - true, если во flash записана хотя бы одна страница
+//            (данные в RAM нужно перечитать через load())
+//------------------------------------------------------------------------------
+bool SettingsLink::poll() {
+  bool changed = false;
+  int c;
+  while ((c = this->get()) >= 0) {
+    if (this->rx.feed((uint8_t)c)) {
+      changed |= handle();
+    }
+  }
+  return changed;
+}
+
+//==============================================================================
+// Обработка принятого кадра
+//  @return - true, если flash изменена
+//------------------------------------------------------------------------------
+bool SettingsLink::handle() {
+  switch (this->rx.cmd) {
+  case LINK_CMD_INFO:
+    sendInfo();
+    return false;
+  case LINK_CMD_READ:
+    sendImage();
+    return false;
+  case LINK_CMD_HASHES:
+    sendHashes();
+    return false;
+  case LINK_CMD_WRITE: {
+    const uint8_t *d = this->rx.data();
+    uint8_t reply[3] = {0, 0, LINK_BAD_FRAME};
+    if (this->rx.len >= 2) {
+      reply[0] = d[0];
+      reply[1] = d[1];
+    }
+    bool written = false;
+    if (this->rx.len == 2 + FLASH_PAGE_SIZE) {
+      written = this->store.writePage((uint32_t)d[0] | (uint32_t)d[1] << 8, d + 2);
+      reply[2] = written ? LINK_OK : LINK_BAD_PAGE;
+    }
+    SettingsFrame::send(this->put, LINK_CMD_WRITE | LINK_REPLY, reply, sizeof(reply));
+    return written;
+  }
+  default:
+    return false; // Неизвестная команда - не отвечаем
+  }
+}
+
+//==============================================================================
+// Ответ на LINK_CMD_INFO: адрес, размер данных, размер области, размер страницы
+//------------------------------------------------------------------------------
+void SettingsLink::sendInfo() {
+  uint32_t v[3] = {this->store.getAddress(), this->store.getLength(), this->store.getAlignedSize()};
+  uint8_t info[14];
+  for (uint8_t i = 0; i < 12; ++i) {
+    info[i] = (uint8_t)(v[i / 4] >> (8 * (i % 4)));
+  }
+  info[12] = (uint8_t)FLASH_PAGE_SIZE;
+  info[13] = (uint8_t)(FLASH_PAGE_SIZE >> 8);
+  SettingsFrame::send(this->put, LINK_CMD_INFO | LINK_REPLY, info, sizeof(info));
+}
+
+//==============================================================================
+// Ответ на LINK_CMD_READ: вся область настроек. Данные передаются прямо из flash,
+// CRC кадра считается по ходу передачи, копия в RAM не нужна.
+//------------------------------------------------------------------------------
+void SettingsLink::sendImage() {
+  uint16_t len = this->store.isValid() ? (uint16_t)this->store.getAlignedSize() : 0; // Область не во flash - пусто
+  const uint8_t *p = SettingsFlash::ptr(this->store.getAddress());
+  uint8_t head[3] = {LINK_CMD_READ | LINK_REPLY, (uint8_t)len, (uint8_t)(len >> 8)};
+  uint16_t crc = SettingsStore::crc16Update(0xFFFF, head, sizeof(head));
+  this->put(LINK_SYNC);
+  for (uint8_t i = 0; i < sizeof(head); ++i) {
+    this->put(head[i]);
+  }
+  for (uint16_t i = 0; i < len; ++i) {
+    uint8_t b = p[i];
+    crc = SettingsStore::crc16Update(crc, &b, 1);
+    this->put(b);
+  }
+  this->put((uint8_t)crc);
+  this->put((uint8_t)(crc >> 8));
+}
+
+//==============================================================================
+// Ответ на LINK_CMD_HASHES: CRC16 каждой страницы области, посчитанные прямо по flash.
+// Хост сравнивает их с CRC страниц нового образа и передает только отличающиеся.
+//------------------------------------------------------------------------------
+void SettingsLink::sendHashes() {
+  uint16_t pages = this->store.isValid() ? (uint16_t)(this->store.getAlignedSize() / FLASH_PAGE_SIZE) : 0;
+  uint16_t len = pages * 2;
+  uint8_t head[3] = {LINK_CMD_HASHES | LINK_REPLY, (uint8_t)len, (uint8_t)(len >> 8)};
+  uint16_t crc = SettingsStore::crc16Update(0xFFFF, head, sizeof(head));
+  this->put(LINK_SYNC);
+  for (uint8_t i = 0; i < sizeof(head); ++i) {
+    this->put(head[i]);
+  }
+  const uint8_t *p = SettingsFlash::ptr(this->store.getAddress());
+  for (uint16_t i = 0; i < pages; ++i) {
+    uint16_t h = SettingsStore::crc16Update(0xFFFF, p + i * FLASH_PAGE_SIZE, FLASH_PAGE_SIZE);
+    uint8_t b[2] = {(uint8_t)h, (uint8_t)(h >> 8)};
+    crc = SettingsStore::crc16Update(crc, b, 2);
+    this->put(b[0]);
+    this->put(b[1]);
+  }
+  this->put((uint8_t)crc);
+  this->put((uint8_t)(crc >> 8));
+}
@@ -0,0 +1,81 @@
+#ifndef SETTINGS_LINK_H
+#define SETTINGS_LINK_H
+
+// Двоичный обмен настройками по USART (сервисная утилита <-> устройство).
+//
+// Кадр: 0xA5 | cmd | len (2 байта, LE) | данные (len байт) | CRC16 (LE) от cmd..данных.
+// Ответ устройства имеет cmd | 0x80.
+//
+// Команды:
+//   LINK_CMD_INFO  ()               -> адрес (4), размер данных (4), размер области (4), размер страницы (2)
+//   LINK_CMD_READ  ()               -> вся область настроек, передается прямо из flash без копии в RAM
+//   LINK_CMD_WRITE (номер (2), страница) -> номер (2), статус (1)
+//   LINK_CMD_HASHES ()              -> CRC16 каждой страницы области (по 2 байта, LE)
+// Запись идет постранично с подтверждением каждой страницы: следующая страница
+// передается только после ответа на предыдущую (управление потоком), поэтому прием не
+// теряет байты, пока устройство стирает и программирует flash.
+// Для синхронизации хост сначала запрашивает CRC страниц (LINK_CMD_HASHES) и передает
+// только страницы, отличающиеся от нового образа: меньше трафика и стертых страниц.
+//
+// Прием и передача байт - через функции пользователя, поэтому модуль не привязан к
+// конкретному USART (и собирается на хосте с -DSETTINGS_STORE_HOST).
+
+#include "SettingsStore.h"
+
+#define LINK_SYNC 0xA5 // Начало кадра
+
+#define LINK_CMD_INFO 0x01  // Параметры области настроек
+#define LINK_CMD_READ 0x02  // Чтение всей области
+#define LINK_CMD_WRITE 0x03 // Запись одной страницы
+#define LINK_CMD_HASHES 0x04 // CRC16 всех страниц
+#define LINK_REPLY 0x80     // Признак ответа
+
+#define LINK_OK 0x00        // Страница записана
+#define LINK_BAD_PAGE 0x01  // Нет такой страницы
+#define LINK_BAD_FRAME 0x02 // Неверная длина данных
+
+#define LINK_MAX_PAYLOAD (2 + FLASH_PAGE_SIZE) // Максимальный размер данных принимаемого кадра
+
+typedef void (*LinkPutFn)(uint8_t b); // Передача байта
+typedef int (*LinkGetFn)(void);       // Прием байта: 0..255 или -1, если данных нет
+
+// Разбор входящих кадров по одному байту (используется и устройством, и хостом)
+class SettingsFrame {
+  private:
+  uint8_t *buf;      // Буфер для данных кадра
+  uint16_t capacity; // Размер буфера
+  uint8_t state;     // Состояние разбора
+  uint16_t pos;      // Принято байт данных
+  uint16_t crc;      // CRC принятой части
+  uint16_t rxCrc;    // Принятая CRC
+
+  public:
+  uint8_t cmd;  // Команда принятого кадра
+  uint16_t len; // Длина данных принятого кадра
+
+  SettingsFrame(uint8_t *buf, uint16_t capacity);
+  bool feed(uint8_t b);                                                        // Очередной байт; true - кадр принят
+  const uint8_t *data(void) const { return buf; }                              // Данные принятого кадра
+  static void send(LinkPutFn put, uint8_t cmd, const uint8_t *data, uint16_t len); // Передача кадра
+};
+
+class SettingsLink {
+  private:
+  SettingsStore &store;                // Хранилище, с которым идет обмен
+  LinkPutFn put;                       // Передача байта
+  LinkGetFn get;                       // Прием байта
+  uint8_t rxBuf[LINK_MAX_PAYLOAD];     // Данные принимаемого кадра
+  SettingsFrame rx;                    // Разбор принимаемых кадров
+
+  public:
+  SettingsLink(SettingsStore &store, LinkPutFn put, LinkGetFn get);
+  bool poll(void); // Обработка принятых байт; true - flash изменена (нужен load())
+
+  private:
+  bool handle(void);    // Обработка принятого кадра
+  void sendInfo(void);  // Ответ на LINK_CMD_INFO
+  void sendImage(void); // Ответ на LINK_CMD_READ
+  void sendHashes(void); // Ответ на LINK_CMD_HASHES
+};
+
+#endif // SETTINGS_LINK_H
@@ -0,0 +1,34 @@
+#ifndef SETTINGS_RESERVE_H
+#define SETTINGS_RESERVE_H
+
+// Резервирование страниц flash под хранилища на этапе компоновки.
+// SETTINGS_RESERVE(имя, байт) объявляет область, выровненную по страницам, в секции
+// .settings_store.<имя>. Фрагмент ld/settings_store.ld собирает все такие области в конец
+// flash (NOLOAD - в образ прошивки не попадают) и останавливает сборку, если прошивка
+// заходит на них. Адрес области - символ компоновщика, а не расчет от FLASH_END_ADDR.
+//
+// Пример:
+//   SETTINGS_RESERVE(cfg, settingsStoreFlashSize(sizeof(cfg), 0));
+//   SettingsStore store(&cfg, sizeof(cfg), true, false, 0, SETTINGS_AREA_END(cfg));
+//
+// Только для сборки под МК со скриптом компоновщика, подключающим ld/settings_store.ld.
+
+#include "SettingsFlash.h"
+#include <stdint.h>
+
+// Размер, округленный вверх до целых страниц
+#define SETTINGS_PAGES_SIZE(bytes) (((bytes) + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE)
+
+// Область name: bytes байт, округленных до страниц, в конце flash
+#define SETTINGS_RESERVE(name, bytes)                                                                  \
+  uint8_t settings_area_##name[SETTINGS_PAGES_SIZE(bytes)]                                             \
+      __attribute__((section(".settings_store." #name), aligned(FLASH_PAGE_SIZE), used))
+
+// Объявление области, зарезервированной в другом файле
+#define SETTINGS_RESERVE_EXTERN(name, bytes) extern uint8_t settings_area_##name[SETTINGS_PAGES_SIZE(bytes)]
+
+// Начало и конец области во flash (адреса контроллера flash)
+#define SETTINGS_AREA(name) ((uint32_t)(uintptr_t)settings_area_##name)
+#define SETTINGS_AREA_END(name) (SETTINGS_AREA(name) + sizeof(settings_area_##name))
+
+#endif // SETTINGS_RESERVE_H
@@ -0,0 +1,115 @@
+//============================================================= (c) A.Kolesov ==
+// SettingsScrubber.cpp
+// Фоновая проверка областей настроек во flash с ограничением по тактам.
+//
+// Пример (в холостом цикле):
+//   SettingsStore *stores[] = {&settings, &calibration};
+//   SettingsScrubber scrubber(stores, 2);
+//   ...
+//   scrubber.step(4000); // Бюджет вызова в тактах (страница - 3072 такта)
+//------------------------------------------------------------------------------
+
+#include "SettingsScrubber.h"
+
+//==============================================================================
+// Конструктор
+//  @param stores - массив указателей на проверяемые хранилища
+//  @param count  - количество хранилищ
+//------------------------------------------------------------------------------
+SettingsScrubber::SettingsScrubber(SettingsStore **stores, uint8_t count)
+    : stores(stores), count(count), region(0), page(0), crc(0xFFFF), credit(0), passes(0), errors(0), repaired(0) {
+}
+
+//==============================================================================
+// Проверка очередных страниц в пределах бюджета (с остатком от прошлых вызовов)
+//  @param budgetCycles - бюджет вызова в тактах
+//  @return             - true, если найдена ошибка (восстановленная или нет)
+//------------------------------------------------------------------------------
+bool SettingsScrubber::step(uint32_t budgetCycles) {
+  const uint32_t pageCost = FLASH_PAGE_SIZE * SS_SCRUB_CYCLES_PER_BYTE;
+  if (this->count == 0) {
+    return false;
+  }
+  // Остаток меньше страницы копится, пока его не хватит на страницу
+  this->credit = budgetCycles >= pageCost ? budgetCycles : this->credit + budgetCycles;
+  uint8_t skipped = 0; // Подряд пропущенных хранилищ - защита от зацикливания
+  while (this->credit >= pageCost) {
+    SettingsStore &store = *this->stores[this->region];
+    if (!store.isValid() || (!(store.getMode() & SETTINGS_MODE_HASH_TREE) && !store.getUseCrc())) {
+      nextRegion();
+      if (++skipped >= this->count) {
+        this->credit = 0;
+        return false; // Проверять нечего
+      }
+      continue;
+    }
+    skipped = 0;
+    this->credit -= pageCost;
+    if (checkPage(store)) {
+      this->credit = 0;
+      return true; // После ошибки (и, возможно, записи flash) бюджет уже исчерпан
+    }
+  }
+  return false;
+}
+
+//==============================================================================
+// Проверка текущей страницы текущего хранилища и переход к следующей
+//  @param store - текущее хранилище
+//  @return      - true, если найдена ошибка
+//------------------------------------------------------------------------------
+bool SettingsScrubber::checkPage(SettingsStore &store) {
+  uint32_t pages = store.getAlignedSize() / FLASH_PAGE_SIZE;
+  uint32_t index = this->page++;
+  bool last = this->page >= pages;
+  bool error = false;
+
+  if (store.getMode() & SETTINGS_MODE_HASH_TREE) {
+    if (!store.verifyPage(index)) {
+      error = true;
+      this->errors++;
+      if (store.repairPage(index)) {
+        this->repaired++;
+      }
+    }
+  } else {
+    // CRC области считается по частям: по странице за раз, без последних 2 байт (сама CRC)
+    uint32_t dataLen = store.getLength() - 2;
+    uint32_t offset = index * FLASH_PAGE_SIZE;
+    if (offset < dataLen) {
+      uint32_t len = dataLen - offset < FLASH_PAGE_SIZE ? dataLen - offset : FLASH_PAGE_SIZE;
+      this->crc = SettingsStore::crc16Update(this->crc, SettingsFlash::ptr(store.getAddress() + offset), len);
+    }
+    if (last) {
+      uint16_t stored_crc;
+      memcpy(&stored_crc, SettingsFlash::ptr(store.getAddress() + dataLen), 2);
+      // Между вызовами мог пройти save(): CRC по частям - от старых и новых данных.
+      // Ошибка - только если не сходится и CRC всей области, посчитанная сразу
+      if (stored_crc != this->crc &&
+          stored_crc != SettingsStore::crc16Update(0xFFFF, SettingsFlash::ptr(store.getAddress()), dataLen)) {
+        error = true;
+        this->errors++;
+        if (store.repair()) {
+          this->repaired++;
+        }
+      }
+    }
+  }
+
+  if (last) {
+    nextRegion();
+  }
+  return error;
+}
+
+//==============================================================================
+// Переход к следующему хранилищу; после последнего - новый проход
+//------------------------------------------------------------------------------
+void SettingsScrubber::nextRegion() {
+  this->page = 0;
+  this->crc = 0xFFFF;
+  if (++this->region >= this->count) {
+    this->region = 0;
+    this->passes++;
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef SETTINGS_SCRUBBER_H
+#define SETTINGS_SCRUBBER_H
+
+// Фоновая проверка (scrubbing) областей настроек во flash.
+//
+// step() вызывается из холостого цикла с бюджетом в тактах и проверяет столько страниц,
+// сколько укладывается в бюджет (SS_SCRUB_CYCLES_PER_BYTE тактов на байт). Позиция
+// хранится в RAM, поэтому каждый вызов ограничен по времени, а следующий продолжает
+// с того же места. Страницы читаются прямо из flash, без копирования.
+// Неизрасходованный бюджет переносится на следующие вызовы: при бюджете меньше страницы
+// (64 * 48 = 3072 такта) страница проверяется раз в несколько вызовов, и такой вызов
+// занимает время проверки одной страницы.
+//
+// - Хранилище в режиме SETTINGS_MODE_HASH_TREE проверяется постранично по дереву
+//   хешей; испорченная страница переписывается из RAM-копии (repairPage()).
+// - Хранилище с CRC проверяется по CRC всей области, которая считается по частям;
+//   при ошибке область переписывается из RAM-копии (repair()).
+// - Хранилище без CRC и без дерева пропускается - проверять нечем (как и хранилище,
+//   область которого не во flash - isValid()).
+//
+// Восстановление (стирание и запись flash) в бюджет не укладывается: после него
+// step() сразу возвращает управление. CRC области набирается за несколько вызовов, и
+// между ними может пройти save(); поэтому перед восстановлением CRC пересчитывается по
+// всей области сразу, и ошибкой считается только повторное несовпадение.
+
+#include "SettingsStore.h"
+
+#ifndef SS_SCRUB_CYCLES_PER_BYTE
+#define SS_SCRUB_CYCLES_PER_BYTE 48 // Оценка тактов на байт проверки (побитовая CRC16 на RV32EC)
+#endif
+
+class SettingsScrubber {
+  private:
+  SettingsStore **stores; // Проверяемые хранилища
+  uint8_t count;          // Количество хранилищ
+  uint8_t region;         // Текущее хранилище
+  uint32_t page;          // Текущая страница в хранилище
+  uint16_t crc;           // CRC проверенной части (для хранилищ без дерева)
+  uint32_t credit;        // Неизрасходованный бюджет прошлых вызовов, тактов
+
+  public:
+  uint32_t passes;   // Полных проходов по всем хранилищам
+  uint32_t errors;   // Найдено ошибок
+  uint32_t repaired; // Восстановлено страниц (областей)
+
+  SettingsScrubber(SettingsStore **stores, uint8_t count);
+  bool step(uint32_t budgetCycles); // Проверка в пределах бюджета; true - была ошибка
+
+  private:
+  bool checkPage(SettingsStore &store); // Проверка текущей страницы; true - была ошибка
+  void nextRegion(void);                // Переход к следующему хранилищу
+};
+
+#endif // SETTINGS_SCRUBBER_H
@@ -0,0 +1,216 @@
+#ifndef SETTINGS_SNAPSHOT_H
+#define SETTINGS_SNAPSHOT_H
+
+// Многопоточный доступ к настройкам на хосте (только для сборки с -DSETTINGS_STORE_HOST).
+//
+// Много потоков-читателей и один поток-писатель. Читатели получают неизменяемый снимок
+// настроек через атомарный указатель и никогда не блокируются. Писатель меняет рабочую
+// структуру, вызывает save() и публикует новый снимок. Старые снимки освобождаются,
+// когда все читатели, которые могли их видеть, вышли (reclamation по эпохам).
+//
+//   SettingsSnapshot<AppConfig> snap(settings, cfg);
+//   // Читатель:
+//   {
+//     auto r = snap.read();
+//     use(r->volume);
+//   }
+//   // Писатель:
+//   cfg.volume = 5;
+//   snap.save();
+
+#ifndef SETTINGS_STORE_HOST
+#error "SettingsSnapshot is available only in host builds (SETTINGS_STORE_HOST)"
+#endif
+
+#include "SettingsStore.h"
+#include <atomic>
+#include <vector>
+
+#ifndef SETTINGS_MAX_READERS
+#define SETTINGS_MAX_READERS 64 // Максимальное количество потоков-читателей
+#endif
+
+#define SETTINGS_SHARED_READER SETTINGS_MAX_READERS // Номер "слота" читателей сверх SETTINGS_MAX_READERS
+
+// Слот читателя, занятый потоком: выдается при первом чтении (CAS свободного слота) и
+// освобождается при завершении потока, поэтому два живых потока никогда не делят слот.
+// Если живых потоков-читателей больше SETTINGS_MAX_READERS, новый поток не ждет, а
+// читает через общий слот SETTINGS_SHARED_READER (счетчик читателей и минимальная эпоха).
+class SettingsReaderSlot {
+  private:
+  unsigned index;
+
+  static std::atomic<bool> *used() {
+    static std::atomic<bool> slots[SETTINGS_MAX_READERS];
+    return slots;
+  }
+
+  public:
+  SettingsReaderSlot() : index(SETTINGS_SHARED_READER) {
+    std::atomic<bool> *slots = used();
+    for (unsigned i = 0; i < SETTINGS_MAX_READERS; ++i) {
+      bool expected = false;
+      if (!slots[i].load(std::memory_order_relaxed) &&
+          slots[i].compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        this->index = i;
+        return;
+      }
+    }
+  }
+  ~SettingsReaderSlot() {
+    if (this->index != SETTINGS_SHARED_READER) {
+      used()[this->index].store(false, std::memory_order_release);
+    }
+  }
+  unsigned get() const { return index; }
+};
+
+// Номер слота читателя для текущего потока (общий для всех снимков)
+inline unsigned settingsReaderSlot() {
+  thread_local SettingsReaderSlot slot;
+  return slot.get();
+}
+
+template <typename T>
+class SettingsSnapshot {
+  private:
+  // Эпоха входа читателя (0 - не читает), каждая на своей строке кэша
+  struct alignas(64) Slot {
+    std::atomic<uint64_t> epoch;
+  };
+
+  struct Retired {
+    const T *ptr;   // Снимок, ожидающий освобождения
+    uint64_t epoch; // Эпоха, в которой снимок был заменен
+  };
+
+  SettingsStore &store;               // Хранилище (используется только писателем)
+  T &work;                            // Рабочая структура писателя
+  std::atomic<const T *> current;     // Текущий опубликованный снимок
+  std::atomic<uint64_t> epoch;        // Глобальная эпоха
+  Slot active[SETTINGS_MAX_READERS];  // Эпохи входа читателей
+  std::atomic<uint32_t> sharedReaders; // Читатели в общем слоте (сверх SETTINGS_MAX_READERS)
+  std::atomic<uint64_t> sharedEpoch;   // Не больше эпохи входа любого из них
+  std::vector<Retired> retired;       // Замененные снимки (доступ только писателя)
+
+  public:
+  // Доступ читателя к снимку. Пока объект существует, снимок не будет освобожден.
+  class Reader {
+    private:
+    std::atomic<uint64_t> *slot;   // Свой слот (nullptr - общий)
+    std::atomic<uint32_t> *shared; // Счетчик общего слота (nullptr - свой слот)
+    const T *ptr;
+
+    public:
+    Reader(std::atomic<uint64_t> *slot, std::atomic<uint32_t> *shared, const T *ptr)
+        : slot(slot), shared(shared), ptr(ptr) {}
+    Reader(const Reader &) = delete;
+    Reader &operator=(const Reader &) = delete;
+    Reader(Reader &&other) : slot(other.slot), shared(other.shared), ptr(other.ptr) {
+      other.slot = nullptr;
+      other.shared = nullptr;
+    }
+    ~Reader() {
+      if (slot != nullptr) {
+        slot->store(0, std::memory_order_release);
+      } else if (shared != nullptr) {
+        shared->fetch_sub(1, std::memory_order_release);
+      }
+    }
+    const T *operator->() const { return ptr; }
+    const T &operator*() const { return *ptr; }
+  };
+
+  //============================================================================
+  // Конструктор: публикует первый снимок из текущего содержимого рабочей структуры.
+  //  @param store - хранилище, через которое писатель сохраняет настройки
+  //  @param work  - рабочая структура (буфер хранилища)
+  //----------------------------------------------------------------------------
+  SettingsSnapshot(SettingsStore &store, T &work)
+      : store(store), work(work), current(new T(work)), epoch(1), sharedReaders(0), sharedEpoch(1) {
+    for (auto &a : active) {
+      a.epoch.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  ~SettingsSnapshot() {
+    delete current.load();
+    for (const Retired &r : retired) {
+      delete r.ptr;
+    }
+  }
+
+  //============================================================================
+  // Вход читателя: без блокировок и ожиданий других читателей и писателя.
+  // Один поток не должен держать два Reader одного снимка одновременно.
+  // Читатель в общем слоте увеличивает счетчик и опускает sharedEpoch до своей эпохи
+  // (CAS только уменьшает значение, поэтому цикл конечен).
+  //----------------------------------------------------------------------------
+  Reader read() {
+    unsigned index = settingsReaderSlot();
+    if (index == SETTINGS_SHARED_READER) {
+      sharedReaders.fetch_add(1, std::memory_order_seq_cst);
+      uint64_t e = epoch.load(std::memory_order_seq_cst);
+      uint64_t min = sharedEpoch.load(std::memory_order_seq_cst);
+      while (min > e && !sharedEpoch.compare_exchange_weak(min, e, std::memory_order_seq_cst)) {
+      }
+      return Reader(nullptr, &sharedReaders, current.load(std::memory_order_seq_cst));
+    }
+    std::atomic<uint64_t> *slot = &active[index].epoch;
+    slot->store(epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+    return Reader(slot, nullptr, current.load(std::memory_order_seq_cst));
+  }
+
+  //============================================================================
+  // Писатель: сохранение рабочей структуры во flash и публикация нового снимка.
+  //----------------------------------------------------------------------------
+  void save() {
+    store.save();
+    publish();
+  }
+
+  //============================================================================
+  // Писатель: публикация копии рабочей структуры и освобождение снимков,
+  // которые уже никто не может читать.
+  //----------------------------------------------------------------------------
+  void publish() {
+    const T *old = current.exchange(new T(work), std::memory_order_seq_cst);
+    retired.push_back({old, epoch.fetch_add(1, std::memory_order_seq_cst)});
+    reclaim();
+  }
+
+  private:
+  //============================================================================
+  // Освобождение снимков, замененных раньше, чем вошел самый старый активный читатель.
+  // Читатель, вошедший в эпохе > e, уже видит снимок, опубликованный после эпохи e.
+  // Общий слот: если читателей в нем нет, sharedEpoch поднимается до эпохи, прочитанной
+  // до проверки счетчика (любой вошедший позже читатель войдет не раньше нее); иначе
+  // sharedEpoch - нижняя граница эпох входа его читателей.
+  //----------------------------------------------------------------------------
+  void reclaim() {
+    uint64_t oldest = epoch.load(std::memory_order_seq_cst);
+    if (sharedReaders.load(std::memory_order_seq_cst) == 0) {
+      sharedEpoch.store(oldest, std::memory_order_seq_cst);
+    } else {
+      uint64_t e = sharedEpoch.load(std::memory_order_seq_cst);
+      oldest = e < oldest ? e : oldest;
+    }
+    for (auto &a : active) {
+      uint64_t e = a.epoch.load(std::memory_order_seq_cst);
+      if (e != 0 && e < oldest) {
+        oldest = e;
+      }
+    }
+    size_t kept = 0;
+    for (const Retired &r : retired) {
+      if (r.epoch < oldest) {
+        delete r.ptr;
+      } else {
+        retired[kept++] = r;
+      }
+    }
+    retired.resize(kept);
+  }
+};
+
+#endif // SETTINGS_SNAPSHOT_H
@@ -30,20 +30,68 @@
 
 #include "SettingsStore.h"
 
+// Отметки фаз load() для профиля загрузки (SETTINGS_STORE_PROFILE)
+#ifdef SETTINGS_STORE_PROFILE
+#define SS_PROFILE_START() uint32_t profileMark = SettingsFlash::cycles()
+#define SS_PROFILE_PHASE(field)                          \
+  do {                                                   \
+    uint32_t profileNow = SettingsFlash::cycles();       \
+    this->profile.field += profileNow - profileMark;     \
+    profileMark = profileNow;                            \
+  } while (0)
+#else
+#define SS_PROFILE_START()
+#define SS_PROFILE_PHASE(field)
+#endif
+
 //==============================================================================
 // Конструктор:
 //  @param ptr         указатель на структуру
 //  @param length      размер структуры в байтах (используй sizeof())
 //  @param useCrc      true: последние 2 байта заполняются CRC16 перед записью
 //  @param forceWrite  true: запись без проверки, что данные изменились
+//  @param mode        дополнительные режимы (SETTINGS_MODE_*), по умолчанию 0
+//  @param flashEnd    конец области во flash: FLASH_END_ADDR или SETTINGS_AREA_END() резерва,
+//                     данные (и дерево хешей под ними) - вниз от него
 //------------------------------------------------------------------------------
-SettingsStore::SettingsStore(void *ptr, size_t length, bool useCrc, bool forceWrite)
+SettingsStore::SettingsStore(void *ptr, size_t length, bool useCrc, bool forceWrite, uint8_t mode, uint32_t flashEnd)
     : settingsBuf(ptr),
       length(length),
       useCrc(useCrc && length >= 2),
-      forceWrite(forceWrite) {
+      forceWrite(forceWrite),
+      mode(mode) {
   this->alignedSize = (uint32_t)align_up((size_t)length, (size_t)FLASH_PAGE_SIZE);
-  this->address = flashStartAddr(alignedSize);
+  this->address = flashStartAddr(alignedSize, flashEnd);
+  this->treeLeaves = 0;
+  this->treeAddr = this->address;
+  this->checkedPages = 0;
+  this->loadedPages = 0;
+  if (this->mode & SETTINGS_MODE_LAZY) {
+    this->mode |= SETTINGS_MODE_HASH_TREE; // Страницы проверяются по дереву
+  }
+  if (this->mode & SETTINGS_MODE_HASH_TREE) {
+    // Число листьев дерева - степень двойки не меньше числа страниц данных
+    uint32_t pages = this->alignedSize / FLASH_PAGE_SIZE;
+    uint16_t leaves = 1;
+    while (leaves < pages) {
+      leaves <<= 1;
+    }
+    if (leaves <= SETTINGS_TREE_MAX_PAGES) {
+      this->treeLeaves = leaves;
+      this->treeAddr = this->address - (uint32_t)align_up(leaves * 4, FLASH_PAGE_SIZE); // Дерево - под данными
+    } else {
+      this->mode &= ~(SETTINGS_MODE_HASH_TREE | SETTINGS_MODE_LAZY); // Слишком большое хранилище для дерева
+    }
+  }
+  // Область (с деревом) должна целиком лежать во flash (на хосте - в отображенном образе);
+  // иначе все операции отказывают, ничего не читая и не записывая
+  this->inFlash = this->length > 0 && SettingsFlash::valid(this->treeAddr, this->address + this->alignedSize - this->treeAddr);
+#ifdef SETTINGS_STORE_STATS
+  memset(&this->stats, 0, sizeof(this->stats));
+#endif
+#ifdef SETTINGS_STORE_PROFILE
+  memset(&this->profile, 0, sizeof(this->profile));
+#endif
 }
 
 //==============================================================================
@@ -54,24 +102,117 @@ SettingsStore::SettingsStore(void *ptr, size_t length, bool useCrc, bool forceWr
 //  @return        true при успехе, false при ошибке CRC
 //------------------------------------------------------------------------------
 bool SettingsStore::load() {
+#ifdef SETTINGS_STORE_PROFILE
+  memset(&this->profile, 0, sizeof(this->profile));
+#endif
+  this->checkedPages = 0;
+  this->loadedPages = 0;
+  if (!this->inFlash) {
+    return false;
+  }
+  if (this->mode & SETTINGS_MODE_LAZY) { // Только заголовок дерева: метка и корень
+    SS_PROFILE_START();
+    const uint16_t *tree = (const uint16_t *)SettingsFlash::ptr(this->treeAddr);
+    bool ok = tree[0] == SETTINGS_TREE_MAGIC && (this->treeLeaves < 2 || tree[1] == nodeHash(tree[2], tree[3]));
+    SS_PROFILE_PHASE(check);
+    if (!ok) {
+      // Данных во flash нет: значения по умолчанию, которые программа запишет в RAM, -
+      // все страницы, ensure() их не затирает, а save() пишет целиком
+      this->loadedPages = ~(uint32_t)0;
+    }
+#ifdef SETTINGS_STORE_PROFILE
+    this->profile.done = SettingsFlash::cycles();
+#endif
+    return ok;
+  }
 
-  flashRead(this->address, (uint8_t *)this->settingsBuf, this->length);
-  if (!this->useCrc) { // CRC не используем
-    return true;
+  // Копирование с одновременным расчетом CRC (от всех байт, кроме последних 2)
+  uint16_t computed_crc = flashReadCrc(this->address, (uint8_t *)this->settingsBuf, this->length,
+                                       this->useCrc ? this->length - 2 : 0);
+  bool ok = true;
+  if (this->mode & SETTINGS_MODE_HASH_TREE) { // Проверка дерева и каждой страницы по ее листу
+    SS_PROFILE_START();
+    ok = treeValid();
+    const uint16_t *tree = (const uint16_t *)SettingsFlash::ptr(this->treeAddr);
+    for (uint32_t i = 0; ok && i < this->alignedSize / FLASH_PAGE_SIZE; ++i) {
+      ok = pageHash(SettingsFlash::ptr(this->address + i * FLASH_PAGE_SIZE), FLASH_PAGE_SIZE) ==
+           tree[this->treeLeaves + i];
+    }
+    SS_PROFILE_PHASE(check);
   }
-  // Извлекаем CRC из последних 2 байт прочитанного массива
-  uint16_t stored_crc;
-  memcpy(&stored_crc, (uint8_t *)this->settingsBuf + this->length - 2, 2);
-  // Считаем CRC от всех байт, кроме последних 2
-  uint16_t computed_crc = crc16(this->settingsBuf, this->length - 2);
+  if (ok && this->useCrc) {
+    // Извлекаем CRC из последних 2 байт прочитанного массива
+    uint16_t stored_crc;
+    memcpy(&stored_crc, (uint8_t *)this->settingsBuf + this->length - 2, 2);
+    ok = stored_crc == computed_crc;
+  }
+#ifdef SETTINGS_STORE_PROFILE
+  this->profile.done = SettingsFlash::cycles();
+#endif
+  return ok;
+}
 
-  return (stored_crc == computed_crc);
+//==============================================================================
+// Доступ к сохраненным данным прямо во flash, без копирования в RAM.
+// Flash отображена в адресное пространство (на хосте — через mmap), поэтому
+// указатель можно использовать для чтения как обычную структуру.
+//  @return - указатель на данные во flash или nullptr при ошибке CRC
+//------------------------------------------------------------------------------
+const void *SettingsStore::view() {
+  if (!this->inFlash) {
+    return nullptr;
+  }
+  const uint8_t *data = SettingsFlash::ptr(this->address);
+  if (this->useCrc) {
+    uint16_t stored_crc;
+    memcpy(&stored_crc, data + this->length - 2, 2);
+    if (stored_crc != crc16(data, this->length - 2)) {
+      return nullptr;
+    }
+  }
+  return data;
 }
 
 //==============================================================================
 // Сохранение массива данных во flash
 //------------------------------------------------------------------------------
 void SettingsStore::save() {
+  if (!this->inFlash) {
+    return;
+  }
+#ifdef SETTINGS_STORE_STATS
+  uint32_t energyBefore = energyUsed();
+  uint32_t cyclesBefore[FLASH_OP_COUNT];
+  memcpy(cyclesBefore, SettingsFlash::busyCycles, sizeof(cyclesBefore));
+  uint32_t sleepBefore = SettingsFlash::sleepCycles;
+  uint32_t wakeupsBefore = SettingsFlash::wakeups;
+#endif
+
+  bool written = (this->mode & SETTINGS_MODE_HASH_TREE) ? saveTree() : saveAll();
+
+#ifdef SETTINGS_STORE_STATS
+  if (!written) {
+    this->stats.skipped++;
+    return;
+  }
+  for (uint8_t op = 0; op < FLASH_OP_COUNT; ++op) {
+    this->stats.busyCycles[op] += SettingsFlash::busyCycles[op] - cyclesBefore[op];
+  }
+  this->stats.sleepCycles += SettingsFlash::sleepCycles - sleepBefore;
+  this->stats.wakeups += SettingsFlash::wakeups - wakeupsBefore;
+  this->stats.saves++;
+  this->stats.lastSaveEnergy = energyUsed() - energyBefore;
+#else
+  (void)written;
+#endif
+  return;
+}
+
+//==============================================================================
+// Сохранение всей области: стирание и запись всех страниц
+//  @return - false, если данные не изменились и запись не понадобилась
+//------------------------------------------------------------------------------
+bool SettingsStore::saveAll() {
   // Проверка, изменились ли данные (без учёта CRC, если используется)
   // Это такая "экономия на спичках" ресурса flash - если данные, которые хотим записать,
   // не отличаются от тех, что уже записаны, то можно не записывать.
@@ -79,18 +220,9 @@ void SettingsStore::save() {
   // а пользователь много чего понажимал, но по факту параметры не изменились.
   //
   if (!this->forceWrite) {
-    bool changed = false;
     size_t compare_size = this->useCrc ? (this->length - 2) : this->length;
-    for (size_t i = 0; i < compare_size; ++i) {
-      uint8_t flash_byte;
-      flashRead(this->address + i, &flash_byte, 1);
-      if (flash_byte != ((uint8_t *)this->settingsBuf)[i]) {
-        changed = true;
-        break;
-      }
-    }
-    if (!changed) {
-      return; // Ранее сохраненные во flash данные не отличаются от сохраняемых
+    if (!ss_compare(SettingsFlash::ptr(this->address), this->settingsBuf, compare_size)) {
+      return false; // Ранее сохраненные во flash данные не отличаются от сохраняемых
     }
   }
 
@@ -102,7 +234,366 @@ void SettingsStore::save() {
 
   flashErase(); // Стирание всех задействованных страниц
   flashWrite(); // И запись
-  return;
+  return true;
+}
+
+//==============================================================================
+// Сохранение в режиме дерева хешей: записываются только изменившиеся страницы
+// данных и страницы дерева. Для каждой изменившейся страницы пересчитываются ее
+// лист и узлы на пути от листа к корню; остальные узлы берутся из flash.
+// В ленивом режиме страницы, не загруженные в RAM, программа не меняла (поле меняется
+// после ensure()): они не копируются из flash и не пишутся, их листья остаются прежними.
+//  @return - false, если данные не изменились и запись не понадобилась
+//------------------------------------------------------------------------------
+bool SettingsStore::saveTree() {
+  const uint8_t *ram = (const uint8_t *)this->settingsBuf;
+  uint32_t pages = this->alignedSize / FLASH_PAGE_SIZE;
+  uint32_t inRam = (this->mode & SETTINGS_MODE_LAZY) ? this->loadedPages : ~(uint32_t)0;
+
+  // Подставляем CRC в последние 2 байта, если CRC используется. Незагруженные страницы
+  // входят в CRC из flash; страница с CRC меняется при любом изменении и загружается
+  // (если она испорчена, CRC не переписывается)
+  if (this->useCrc) {
+    if (this->mode & SETTINGS_MODE_LAZY) {
+      pagesReady(this->length - 2, 2, true);
+      inRam = this->loadedPages;
+    }
+    if (inRam & ((uint32_t)1 << ((this->length - 1) / FLASH_PAGE_SIZE))) {
+      uint16_t crc = 0xFFFF;
+      for (size_t offset = 0; offset < this->length - 2; offset += FLASH_PAGE_SIZE) {
+        size_t len = this->length - 2 - offset < FLASH_PAGE_SIZE ? this->length - 2 - offset : FLASH_PAGE_SIZE;
+        bool loaded = inRam & ((uint32_t)1 << (offset / FLASH_PAGE_SIZE));
+        crc = crc16Update(crc, loaded ? ram + offset : SettingsFlash::ptr(this->address + offset), len);
+      }
+      memcpy((uint8_t *)this->settingsBuf + this->length - 2, &crc, 2);
+    }
+  }
+
+  uint16_t tree[2 * SETTINGS_TREE_MAX_PAGES]; // [0] - метка, [1] - корень, [leaves..] - листья
+  uint32_t leaves = this->treeLeaves;
+  bool rebuild = !treeValid(); // Дерева во flash нет или оно испорчено - строим заново
+  if (rebuild) {
+    tree[0] = SETTINGS_TREE_MAGIC;
+    for (uint32_t i = pages; i < leaves; ++i) {
+      tree[leaves + i] = 0xFFFF; // Листья несуществующих страниц
+    }
+  } else {
+    memcpy(tree, SettingsFlash::ptr(this->treeAddr), leaves * 4);
+  }
+
+  uint32_t dirty = 0; // Битовая маска страниц для записи
+  for (uint32_t i = 0; i < pages; ++i) {
+    size_t offset = i * FLASH_PAGE_SIZE;
+    size_t len = this->length - offset < FLASH_PAGE_SIZE ? this->length - offset : FLASH_PAGE_SIZE;
+    if (!(inRam & ((uint32_t)1 << i))) { // Страница не загружена и не менялась
+      if (rebuild) {
+        tree[leaves + i] = pageHash(SettingsFlash::ptr(this->address + offset), FLASH_PAGE_SIZE);
+      }
+      continue;
+    }
+    if (!rebuild && !this->forceWrite && !ss_compare(ram + offset, SettingsFlash::ptr(this->address + offset), len)) {
+      continue; // Страница не изменилась
+    }
+    dirty |= (uint32_t)1 << i;
+    tree[leaves + i] = pageHash(ram + offset, len);
+    if (!rebuild) { // Пересчет пути от листа к корню
+      for (uint32_t node = (leaves + i) >> 1; node >= 1; node >>= 1) {
+        tree[node] = nodeHash(tree[2 * node], tree[2 * node + 1]);
+      }
+    }
+  }
+  if (dirty == 0) {
+    return false; // Ранее сохраненные во flash данные не отличаются от сохраняемых
+  }
+  if (rebuild) { // Все внутренние узлы снизу вверх
+    for (uint32_t node = leaves - 1; node >= 1; --node) {
+      tree[node] = nodeHash(tree[2 * node], tree[2 * node + 1]);
+    }
+  }
+
+  SettingsFlash::unlock();
+  for (uint32_t i = 0; i < pages; ++i) {
+    if (dirty & ((uint32_t)1 << i)) {
+      size_t offset = i * FLASH_PAGE_SIZE;
+      size_t len = this->length - offset < FLASH_PAGE_SIZE ? this->length - offset : FLASH_PAGE_SIZE;
+      if (!ss_blank(SettingsFlash::ptr(this->address + offset), FLASH_PAGE_SIZE)) {
+        SettingsFlash::erasePage(this->address + offset);
+      }
+      SettingsFlash::programPage(this->address + offset, ram + offset, len);
+    }
+  }
+  // Дерево пишется последним: если запись прервется, дерево не сойдется с данными
+  flashWriteTree(tree);
+  SettingsFlash::lock();
+  return true;
+}
+
+//==============================================================================
+// Ленивый режим: загрузка в RAM страниц, на которые приходится диапазон структуры.
+// Каждая страница при первом обращении проверяется по дереву хешей и копируется,
+// повторные вызовы стоят одной проверки битовой маски. В остальных режимах данные
+// уже загружены load(), и ensure() ничего не делает.
+//  @param offset - смещение поля в структуре (offsetof)
+//  @param len    - размер поля
+//  @return       - false, если какая-то из страниц испорчена (в RAM она не копируется)
+//------------------------------------------------------------------------------
+bool SettingsStore::ensure(size_t offset, size_t len) {
+  if (!(this->mode & SETTINGS_MODE_LAZY)) {
+    return true;
+  }
+  return pagesReady(offset, len, true);
+}
+
+//==============================================================================
+// Ленивый режим: указатель на диапазон прямо во flash; страницы диапазона только
+// проверяются по дереву (один раз), в RAM не копируются.
+//  @param offset - смещение от начала данных
+//  @param len    - размер диапазона
+//  @return       - указатель во flash; nullptr, если диапазон выходит за данные или
+//                  страница испорчена
+//------------------------------------------------------------------------------
+const void *SettingsStore::viewAt(size_t offset, size_t len) {
+  if (!pagesReady(offset, len, false)) {
+    return nullptr;
+  }
+  return SettingsFlash::ptr(this->address + offset);
+}
+
+//==============================================================================
+// Проверка страниц диапазона по дереву и копирование их в RAM (copy = true).
+// Уже проверенные и загруженные страницы отмечены в checkedPages и loadedPages;
+// загруженная страница не копируется повторно и не проверяется.
+//------------------------------------------------------------------------------
+bool SettingsStore::pagesReady(size_t offset, size_t len, bool copy) {
+  if (!this->inFlash || offset + len > this->length) {
+    return false;
+  }
+  if (!(this->mode & SETTINGS_MODE_HASH_TREE)) {
+    return true; // Без дерева проверять страницы не по чему: область проверена load()
+  }
+  bool ok = true;
+  uint32_t last = len ? (uint32_t)((offset + len - 1) / FLASH_PAGE_SIZE) : (uint32_t)(offset / FLASH_PAGE_SIZE);
+  for (uint32_t i = (uint32_t)(offset / FLASH_PAGE_SIZE); i <= last; ++i) {
+    uint32_t bit = (uint32_t)1 << i;
+    if (copy && (this->loadedPages & bit)) {
+      continue; // В RAM уже актуальные данные (в т.ч. значения по умолчанию после неудачного load())
+    }
+    if (!(this->checkedPages & bit)) {
+      if (!verifyPage(i)) {
+        ok = false;
+        continue;
+      }
+      this->checkedPages |= bit;
+    }
+    if (copy && !(this->loadedPages & bit)) {
+      size_t pageOffset = i * FLASH_PAGE_SIZE;
+      size_t pageLen = this->length - pageOffset < FLASH_PAGE_SIZE ? this->length - pageOffset : FLASH_PAGE_SIZE;
+      flashRead(this->address + pageOffset, (uint8_t *)this->settingsBuf + pageOffset, pageLen);
+      this->loadedPages |= bit;
+    }
+  }
+  return ok;
+}
+
+//==============================================================================
+// Проверка одной страницы данных прямо во flash: страница сверяется со своим листом,
+// а лист - с корнем по пути вверх по дереву (log2 от числа страниц шагов).
+// Только для режима SETTINGS_MODE_HASH_TREE.
+//  @param index - номер страницы данных
+//  @return      - true, если страница цела
+//------------------------------------------------------------------------------
+bool SettingsStore::verifyPage(uint32_t index) {
+  if (!this->inFlash || !(this->mode & SETTINGS_MODE_HASH_TREE) || index >= this->alignedSize / FLASH_PAGE_SIZE) {
+    return false;
+  }
+  return leafValid(index, pageHash(SettingsFlash::ptr(this->address + index * FLASH_PAGE_SIZE), FLASH_PAGE_SIZE));
+}
+
+//==============================================================================
+// Восстановление испорченной страницы данных из RAM-копии (режим дерева хешей).
+// Страница переписывается, только если страница в RAM совпадает со своим листом
+// дерева, т.е. в RAM именно те данные, что были сохранены.
+//  @param index - номер страницы данных
+//  @return      - true, если страница переписана
+//------------------------------------------------------------------------------
+bool SettingsStore::repairPage(uint32_t index) {
+  if (!this->inFlash || !(this->mode & SETTINGS_MODE_HASH_TREE) || index >= this->alignedSize / FLASH_PAGE_SIZE) {
+    return false;
+  }
+  uint8_t page[FLASH_PAGE_SIZE];
+  size_t offset = index * FLASH_PAGE_SIZE;
+  size_t len = this->length - offset < FLASH_PAGE_SIZE ? this->length - offset : FLASH_PAGE_SIZE;
+  memset(page, 0xFF, FLASH_PAGE_SIZE);
+  memcpy(page, (const uint8_t *)this->settingsBuf + offset, len);
+  if (!leafValid(index, pageHash(page, FLASH_PAGE_SIZE))) {
+    return false; // В RAM другие данные - восстанавливать не из чего
+  }
+  return writePage(index, page);
+}
+
+//==============================================================================
+// Восстановление всей области из RAM-копии (режим без дерева, с CRC).
+// Область переписывается, только если CRC в RAM сходится, т.е. данные в RAM
+// не менялись после последнего save() или load().
+//  @return - true, если область переписана
+//------------------------------------------------------------------------------
+bool SettingsStore::repair() {
+  if (!this->inFlash || !this->useCrc) {
+    return false;
+  }
+  uint16_t stored_crc;
+  memcpy(&stored_crc, (const uint8_t *)this->settingsBuf + this->length - 2, 2);
+  if (stored_crc != crc16(this->settingsBuf, this->length - 2)) {
+    return false;
+  }
+  flashErase();
+  flashWrite();
+  return true;
+}
+
+//==============================================================================
+// Проверка листа по дереву во flash: хеш страницы сверяется с листом, затем
+// по пути вверх пересчитываются узлы до корня.
+//  @param index - номер страницы данных
+//  @param hash  - CRC16 страницы
+//------------------------------------------------------------------------------
+bool SettingsStore::leafValid(uint32_t index, uint16_t hash) {
+  const uint16_t *tree = (const uint16_t *)SettingsFlash::ptr(this->treeAddr);
+  if (tree[0] != SETTINGS_TREE_MAGIC) {
+    return false;
+  }
+  uint32_t node = this->treeLeaves + index;
+  if (hash != tree[node]) {
+    return false;
+  }
+  for (; node > 1; node >>= 1) {
+    hash = (node & 1) ? nodeHash(tree[node - 1], hash) : nodeHash(hash, tree[node + 1]);
+  }
+  return hash == tree[1];
+}
+
+//==============================================================================
+// Проверка дерева хешей во flash: метка и все внутренние узлы, включая корень.
+//------------------------------------------------------------------------------
+bool SettingsStore::treeValid() {
+  const uint16_t *tree = (const uint16_t *)SettingsFlash::ptr(this->treeAddr);
+  if (tree[0] != SETTINGS_TREE_MAGIC) {
+    return false;
+  }
+  for (uint32_t node = 1; node < this->treeLeaves; ++node) {
+    if (tree[node] != nodeHash(tree[2 * node], tree[2 * node + 1])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//==============================================================================
+// Лист дерева: CRC16 страницы данных. Если данных меньше страницы, остаток
+// считается заполненным 0xFF - так страница выглядит во flash после записи.
+//  @param data - данные страницы
+//  @param len  - количество байт данных, не больше FLASH_PAGE_SIZE
+//------------------------------------------------------------------------------
+uint16_t SettingsStore::pageHash(const uint8_t *data, size_t len) {
+  uint16_t crc = crc16Update(0xFFFF, data, len);
+  static const uint8_t blank = 0xFF;
+  for (size_t i = len; i < FLASH_PAGE_SIZE; ++i) {
+    crc = crc16Update(crc, &blank, 1);
+  }
+  return crc;
+}
+
+//==============================================================================
+// Внутренний узел дерева: CRC16 от пары дочерних узлов
+//------------------------------------------------------------------------------
+uint16_t SettingsStore::nodeHash(uint16_t left, uint16_t right) {
+  uint16_t pair[2] = {left, right};
+  return crc16Update(0xFFFF, pair, sizeof(pair));
+}
+
+#ifdef SETTINGS_STORE_STATS
+//==============================================================================
+// Оценка энергии, затраченной на операции flash с момента создания объекта.
+// Время операции берется из числа тактов ожидания SR_BSY, ток — из FLASH_*_CURRENT_UA;
+// экономия FLASH_WFI_SAVING_UA учитывается только за такты, проведенные во сне WFI.
+// E[нДж] = I[мкА] * U[мВ] * такты / F[Гц]. Счетчик 32-битный, переполняется после ~4.3 Дж.
+//  @return - энергия в наноджоулях
+//------------------------------------------------------------------------------
+uint32_t SettingsStore::energyUsed() const {
+  static const uint32_t current[FLASH_OP_COUNT] = {FLASH_ERASE_CURRENT_UA, FLASH_LOAD_CURRENT_UA,
+                                                   FLASH_PROGRAM_CURRENT_UA};
+  uint64_t sum = 0;
+  for (uint8_t op = 0; op < FLASH_OP_COUNT; ++op) {
+    sum += (uint64_t)current[op] * this->stats.busyCycles[op];
+  }
+#ifdef SETTINGS_STORE_FLASH_IRQ
+  uint64_t saving = (uint64_t)FLASH_WFI_SAVING_UA * this->stats.sleepCycles;
+  sum = sum > saving ? sum - saving : 0;
+#endif
+  return (uint32_t)(sum * FLASH_SUPPLY_MV / SystemCoreClock);
+}
+#endif
+
+#ifdef SETTINGS_STORE_PROFILE
+//==============================================================================
+// Отладочный вывод профиля последнего load() через printf: время от сброса
+// до окончания загрузки и длительность фаз, мкс
+//------------------------------------------------------------------------------
+void SettingsStore::printLoadProfile() const {
+  uint32_t mhz = SystemCoreClock / 1000000;
+  printf("settings @%08lX (%lu bytes): loaded at %lu us, check %lu us, copy %lu us, crc %lu us\n",
+         (unsigned long)this->address, (unsigned long)this->length, (unsigned long)(this->profile.done / mhz),
+         (unsigned long)(this->profile.check / mhz), (unsigned long)(this->profile.copy / mhz),
+         (unsigned long)(this->profile.crc / mhz));
+}
+#endif
+
+//==============================================================================
+// Запись одной страницы области настроек прямо во flash (стирание + программирование),
+// минуя буфер в RAM. Используется при приеме образа по частям; после записи всех
+// страниц данные нужно перечитать через load().
+// В режиме дерева хешей обновляются лист страницы и путь до корня.
+//  @param index - номер страницы от начала области
+//  @param data  - FLASH_PAGE_SIZE байт данных страницы
+//  @return      - false, если страницы с таким номером в области нет
+//------------------------------------------------------------------------------
+bool SettingsStore::writePage(uint32_t index, const uint8_t *data) {
+  uint32_t pages = this->alignedSize / FLASH_PAGE_SIZE;
+  if (!this->inFlash || index >= pages) {
+    return false;
+  }
+  SettingsFlash::writePage(this->address + index * FLASH_PAGE_SIZE, data);
+  if (!(this->mode & SETTINGS_MODE_HASH_TREE)) {
+    return true;
+  }
+
+  // Режим дерева: лист страницы и путь до корня (если дерево во flash испорчено -
+  // все дерево заново по страницам во flash), иначе страница не пройдет проверку
+  uint16_t tree[2 * SETTINGS_TREE_MAX_PAGES];
+  uint32_t leaves = this->treeLeaves;
+  if (treeValid()) {
+    memcpy(tree, SettingsFlash::ptr(this->treeAddr), leaves * 4);
+    tree[leaves + index] = pageHash(data, FLASH_PAGE_SIZE);
+    for (uint32_t node = (leaves + index) >> 1; node >= 1; node >>= 1) {
+      tree[node] = nodeHash(tree[2 * node], tree[2 * node + 1]);
+    }
+  } else {
+    tree[0] = SETTINGS_TREE_MAGIC;
+    for (uint32_t i = 0; i < leaves; ++i) {
+      tree[leaves + i] = i < pages ? pageHash(SettingsFlash::ptr(this->address + i * FLASH_PAGE_SIZE), FLASH_PAGE_SIZE)
+                                   : 0xFFFF;
+    }
+    for (uint32_t node = leaves - 1; node >= 1; --node) {
+      tree[node] = nodeHash(tree[2 * node], tree[2 * node + 1]);
+    }
+  }
+  SettingsFlash::unlock();
+  flashWriteTree(tree);
+  SettingsFlash::lock();
+  uint32_t bit = (uint32_t)1 << index; // Ленивый режим: страницу нужно проверить и загрузить заново
+  this->checkedPages &= ~bit;
+  this->loadedPages &= ~bit;
+  return true;
 }
 
 // ******************** Вспомогательные функции ********************
@@ -123,30 +614,30 @@ size_t SettingsStore::align_up(size_t value, size_t alignment) {
 //  @return          — рассчитанная CRC
 //------------------------------------------------------------------------------
 uint16_t SettingsStore::crc16(const void *data, size_t len) {
-  uint16_t crc = 0xFFFF;
-  const uint8_t *p = (const uint8_t *)data;
-  for (size_t i = 0; i < len; ++i) {
-    crc ^= (uint16_t)(p[i]) << 8;
-    for (int j = 0; j < 8; ++j) {
-      if (crc & 0x8000) {
-        crc = (crc << 1) ^ 0x1021;
-      } else {
-        crc <<= 1;
-      }
-    }
-  }
-  return crc;
+  return crc16Update(0xFFFF, data, len);
+}
+
+//==============================================================================
+// Продолжение расчета CRC16-CCITT: позволяет считать CRC по частям, например
+// при потоковой передаче данных.
+//  @param crc       — CRC предыдущих частей (0xFFFF для первой)
+//  @param data      — указатель на очередную часть данных
+//  @param len       — размер части
+//  @return          — CRC с учетом этой части
+//------------------------------------------------------------------------------
+uint16_t SettingsStore::crc16Update(uint16_t crc, const void *data, size_t len) {
+  return ss_crc16(crc, data, len);
 }
 
 //==============================================================================
-// Адрес начала данных во flash (от конца flash вниз, выровнено по страницам)
+// Адрес начала данных во flash (от конца области вниз, выровнено по страницам)
 //------------------------------------------------------------------------------
-uint32_t SettingsStore::flashStartAddr(size_t data_size) {
+uint32_t SettingsStore::flashStartAddr(size_t data_size, uint32_t end) {
   size_t pages = (data_size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
-  return FLASH_END_ADDR - pages * FLASH_PAGE_SIZE;
+  return end - pages * FLASH_PAGE_SIZE;
 }
 
-// ******************** LOW-LEVEL Функции работы с flash ********************
+// ******************** Работа с flash ********************
 
 //==============================================================================
 // Непосредственное чтение данных из flash в буфер
@@ -155,74 +646,83 @@ uint32_t SettingsStore::flashStartAddr(size_t data_size) {
 //  @param len - количество читаемых данных
 //------------------------------------------------------------------------------
 void SettingsStore::flashRead(uint32_t addr, uint8_t *buf, size_t len) {
-  const uint8_t *flash_ptr = (const uint8_t *)addr;
-  for (size_t i = 0; i < len; ++i) {
-    buf[i] = flash_ptr[i];
-  }
+  ss_copy(buf, SettingsFlash::ptr(addr), len);
 }
 
 //==============================================================================
-// Запись данных во flash.
+// Чтение данных из flash с расчетом CRC16 по началу прочитанного.
+// При сборке с SETTINGS_STORE_DMA большие области (от SS_DMA_THRESHOLD байт) копируются
+// каналом DMA в режиме память-память, а CRC тем временем считается по уже скопированной
+// части буфера (по счетчику CNTR). Если канал занят, копирует ядро.
+//  @param addr   - адрес во flash
+//  @param buf    - буфер для данных
+//  @param len    - количество байт
+//  @param crcLen - по скольким первым байтам считать CRC (0 - не считать)
+//  @return       - CRC16 первых crcLen байт
 //------------------------------------------------------------------------------
-void SettingsStore::flashWrite() {
-  uint32_t *pbuf = (uint32_t *)this->settingsBuf; // Указатель на буфер с данными
-  uint32_t align_size = this->alignedSize;        // Выравненый по размеру страницы размер
-  uint32_t pageAdr = this->address;               // Адрес начала страницы
-  uint32_t startAddr = this->address;             // Адрес слова на странице
-  uint32_t cntPage = align_size >> 6;             // Кол-во страниц flash
-  uint32_t cntWord = (this->length + 3) >> 2;     // Счетчик количества записанных 4-хбайтных слов
-
-  // Разблокировка записи во flash
-  FLASH->KEYR = FLASH_KEY1;
-  FLASH->KEYR = FLASH_KEY2;
+uint16_t SettingsStore::flashReadCrc(uint32_t addr, uint8_t *buf, size_t len, size_t crcLen) {
+#if defined(SETTINGS_STORE_DMA) && !defined(SETTINGS_STORE_HOST)
+  if (len >= SS_DMA_THRESHOLD && len <= 0xFFFF && !(SS_DMA_CHANNEL->CFGR & SS_DMA_CFGR_EN)) {
+    SS_PROFILE_START(); // CRC считается во время копирования: обе фазы - в copy
+    // Пословно, если позволяет выравнивание, иначе побайтно
+    bool words = ((addr | (uint32_t)(uintptr_t)buf | len) & 3) == 0;
+    uint32_t unit = words ? 4 : 1;
+    RCC->AHBPCENR |= SS_DMA_RCC_EN;
+    SS_DMA->INTFCR = SS_DMA_TC_FLAG;
+    SS_DMA_CHANNEL->PADDR = (uint32_t)(uintptr_t)SettingsFlash::ptr(addr);
+    SS_DMA_CHANNEL->MADDR = (uint32_t)(uintptr_t)buf;
+    SS_DMA_CHANNEL->CNTR = len / unit;
+    SS_DMA_CHANNEL->CFGR = SS_DMA_CFGR_MEM2MEM | SS_DMA_CFGR_MINC | SS_DMA_CFGR_PINC |
+                           (words ? SS_DMA_CFGR_WORDS : 0) | SS_DMA_CFGR_EN;
 
-  // Разблокировка Fast Programming
-  FLASH->MODEKEYR = FLASH_KEY1;
-  FLASH->MODEKEYR = FLASH_KEY2;
-
-  do {
-    FLASH->CTLR |= CR_PAGE_PG; // Режим записи постранично
-    FLASH->CTLR |= CR_BUF_RST; // Сброс буфера
-    while (FLASH->STATR & SR_BSY)
-      ;
-    uint8_t cnt = FLASH_PAGE_SIZE >> 2; // 16 - кол-во 4-х байтных слов на странице flash
-    uint32_t val;
-    while (cnt) {
-      // val = *(uint32_t *)pbuf;
-      // if (cntWord == 0) { // Все данные записаны во flash, добиваем страницу "пустышками"
-      //   val = 0xFFFFFFFF;
-      // } else {
-      //   cntWord--;
-      //   pbuf++; // Берем следующее слово из входного буфера
-      // }
-      if (cntWord > 0) {
-        val = *(uint32_t *)pbuf;
-        pbuf++;
-        cntWord--;
-      } else {
-        val = 0xFFFFFFFF;
+    uint16_t crc = 0xFFFF;
+    size_t done = 0; // Байт, уже учтенных в CRC
+    while (done < crcLen) {
+      size_t copied = len - SS_DMA_CHANNEL->CNTR * unit;
+      __asm__ volatile("" ::: "memory"); // Буфер меняет DMA: перечитывать после CNTR
+      if (copied > crcLen) {
+        copied = crcLen;
+      }
+      if (copied > done) {
+        crc = crc16Update(crc, buf + done, copied - done);
+        done = copied;
       }
-
-      *(__IO uint32_t *)(startAddr) = val;
-      FLASH->CTLR |= CR_BUF_LOAD; // Перенос даных из буфера непосредственно во flash.
-      while (FLASH->STATR & SR_BSY)
-        ;
-      startAddr += 4; // Переход к начальному адресу следующего записываемого слова
-      cnt--;
     }
-
-    FLASH->CTLR |= CR_PAGE_PG;
-    FLASH->ADDR = pageAdr;
-    FLASH->CTLR |= CR_STRT_Set;
-    while (FLASH->STATR & SR_BSY)
+    while (!(SS_DMA->INTFR & SS_DMA_TC_FLAG))
       ;
-    FLASH->CTLR &= ~CR_PAGE_PG;
+    __asm__ volatile("" ::: "memory");
+    SS_DMA_CHANNEL->CFGR = 0;
+    SS_DMA->INTFCR = SS_DMA_TC_FLAG;
+    SS_PROFILE_PHASE(copy);
+    return crc;
+  }
+#endif
+  SS_PROFILE_START();
+  flashRead(addr, buf, len);
+  SS_PROFILE_PHASE(copy);
+  uint16_t crc = crc16(buf, crcLen);
+  SS_PROFILE_PHASE(crc);
+  return crc;
+}
+
+//==============================================================================
+// Запись данных во flash (страницы должны быть предварительно стерты).
+//------------------------------------------------------------------------------
+void SettingsStore::flashWrite() {
+  const uint8_t *pbuf = (const uint8_t *)this->settingsBuf; // Указатель на буфер с данными
+  uint32_t pageAdr = this->address;                         // Адрес начала страницы
+  uint32_t cntPage = this->alignedSize / FLASH_PAGE_SIZE;   // Кол-во страниц flash
+  size_t rest = this->length;                               // Сколько байт данных осталось записать
 
+  SettingsFlash::unlock();
+  do {
+    size_t chunk = rest > FLASH_PAGE_SIZE ? FLASH_PAGE_SIZE : rest;
+    SettingsFlash::programPage(pageAdr, pbuf, chunk);
+    pbuf += chunk;
+    rest -= chunk;
     pageAdr += FLASH_PAGE_SIZE; // Переход к начальному адресу следующей страницы
   } while (--cntPage);
-
-  FLASH->CTLR |= CR_FLOCK_Set;
-  FLASH->CTLR |= CR_LOCK_Set;
+  SettingsFlash::lock();
 
   return;
 }
@@ -231,31 +731,32 @@ void SettingsStore::flashWrite() {
 // Стирание области flash, выделенной под сохранение настроек
 //------------------------------------------------------------------------------
 void SettingsStore::flashErase() {
-  uint32_t addr = this->address;
-  uint32_t erase_size = this->alignedSize;
-
-  // Разблокировка flash для записи
-  FLASH->KEYR = FLASH_KEY1;
-  FLASH->KEYR = FLASH_KEY2;
-
-  // Разблокировка режима Fast program mode
-  FLASH->MODEKEYR = FLASH_KEY1;
-  FLASH->MODEKEYR = FLASH_KEY2;
-
-  uint32_t startAddr = addr;      // Адрес начала стирания
-  uint32_t cnt = erase_size >> 6; // Кол-во стираемых страниц flash
-  do {                            // Стираем постранично
-    FLASH->CTLR |= CR_PAGE_ER;    // Включение режима быстрого (постраничного) стирания
-    FLASH->ADDR = startAddr;      // Адрес начала стирания
-    FLASH->CTLR |= CR_STRT_Set;   // Запуск стирания
-    while (FLASH->STATR & SR_BSY) // Ждем окончания стирания
-      ;
-    FLASH->CTLR &= ~CR_PAGE_ER;   // Выключение режима быстрого (постраничного) стирания
+  uint32_t startAddr = this->address;                 // Адрес начала стирания
+  uint32_t cnt = this->alignedSize / FLASH_PAGE_SIZE; // Кол-во стираемых страниц flash
+
+  SettingsFlash::unlock();
+  do { // Стираем постранично, уже чистые страницы пропускаем
+    if (!ss_blank(SettingsFlash::ptr(startAddr), FLASH_PAGE_SIZE)) {
+      SettingsFlash::erasePage(startAddr);
+    }
     startAddr += FLASH_PAGE_SIZE; // Переходим к адресу следующей страницы
   } while (--cnt);
-
-  FLASH->CTLR |= CR_FLOCK_Set; // Блокируем запись во flash
-  FLASH->CTLR |= CR_LOCK_Set;
+  SettingsFlash::lock();
 
   return;
 }
+
+//==============================================================================
+// Запись дерева хешей во flash (стирание + программирование его страниц).
+// Запись должна быть разблокирована (unlock()).
+//  @param tree - дерево: [0] - метка, [1] - корень, [treeLeaves..] - листья
+//------------------------------------------------------------------------------
+void SettingsStore::flashWriteTree(const uint16_t *tree) {
+  const uint8_t *treeBytes = (const uint8_t *)tree;
+  uint32_t size = this->treeLeaves * 4;
+  for (uint32_t offset = 0; offset < size; offset += FLASH_PAGE_SIZE) {
+    size_t len = size - offset < FLASH_PAGE_SIZE ? size - offset : FLASH_PAGE_SIZE;
+    SettingsFlash::erasePage(this->treeAddr + offset);
+    SettingsFlash::programPage(this->treeAddr + offset, treeBytes + offset, len);
+  }
+}
@@ -1,48 +1,95 @@
 #ifndef SETTINGS_STORE_H
 #define SETTINGS_STORE_H
 
-#include <ch32v00x.h>
+#include "SettingsFlash.h"
+#include "SettingsKernels.h"
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
-// === Настройки flash ===
-#ifndef FLASH_PAGE_SIZE
-#define FLASH_PAGE_SIZE 64
-#endif
+// === Режимы хранилища (параметр mode конструктора) ===
+// Дерево хешей страниц: под данными хранится двоичное дерево CRC16 (листья - CRC страниц,
+// корень - в заголовке дерева). save() пишет только изменившиеся страницы и пересчитывает
+// узлы на пути от их листьев к корню, verifyPage() проверяет одну страницу без чтения остальных.
+#define SETTINGS_MODE_HASH_TREE 0x01
+// Ленивая загрузка (включает и дерево хешей): load() проверяет только заголовок дерева, а каждая
+// страница проверяется по дереву и копируется в RAM при первом обращении через ensure()
+// (или только проверяется - viewAt()). Загруженные страницы отмечаются в битовой маске, время
+// старта не зависит от размера хранилища. save() пишет только загруженные страницы: поле
+// меняется после ensure(). CRC всей структуры в этом режиме не проверяется.
+#define SETTINGS_MODE_LAZY 0x02
+
+#define SETTINGS_TREE_MAGIC 0x5354 // Метка заголовка дерева
 
-#ifndef FLASH_END_ADDR
-#define FLASH_END_ADDR 0x08004000U // 16 КБ flash: 0x08000000 + 0x4000
+#ifndef SETTINGS_TREE_MAX_PAGES
+#define SETTINGS_TREE_MAX_PAGES 32 // Максимум страниц данных для дерева (буфер дерева - на стеке save())
 #endif
+// Изменившиеся, проверенные и загруженные страницы отмечаются в 32-битных масках
+static_assert(SETTINGS_TREE_MAX_PAGES <= 32, "SETTINGS_TREE_MAX_PAGES must not exceed 32");
 
-// Flash Control Register bits
-#define CR_PG_Set ((uint32_t)0x00000001)
-#define CR_PG_Reset ((uint32_t)0xFFFFFFFE)
-#define CR_PER_Set ((uint32_t)0x00000002)
-#define CR_PER_Reset ((uint32_t)0xFFFFFFFD)
-#define CR_MER_Set ((uint32_t)0x00000004)
-#define CR_MER_Reset ((uint32_t)0xFFFFFFFB)
-#define CR_OPTPG_Set ((uint32_t)0x00000010)
-#define CR_OPTPG_Reset ((uint32_t)0xFFFFFFEF)
-#define CR_OPTER_Set ((uint32_t)0x00000020)
-#define CR_OPTER_Reset ((uint32_t)0xFFFFFFDF)
-#define CR_STRT_Set ((uint32_t)0x00000040)
-#define CR_LOCK_Set ((uint32_t)0x00000080)
-#define CR_FLOCK_Set ((uint32_t)0x00008000)
-#define CR_PAGE_PG ((uint32_t)0x00010000)
-#define CR_PAGE_ER ((uint32_t)0x00020000)
-#define CR_BUF_LOAD ((uint32_t)0x00040000)
-#define CR_BUF_RST ((uint32_t)0x00080000)
+//==============================================================================
+// Размер области во flash, которую занимает хранилище: данные и дерево хешей под ними.
+// Для резервирования страниц при компоновке (SETTINGS_RESERVE()).
+//  @param length - размер структуры (sizeof)
+//  @param mode   - режимы (SETTINGS_MODE_*), как в конструкторе
+//------------------------------------------------------------------------------
+constexpr size_t settingsStoreFlashSize(size_t length, uint8_t mode) {
+  size_t data = (length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  if (!(mode & (SETTINGS_MODE_HASH_TREE | SETTINGS_MODE_LAZY))) {
+    return data;
+  }
+  size_t leaves = 1;
+  while (leaves < data / FLASH_PAGE_SIZE) {
+    leaves <<= 1;
+  }
+  if (leaves > SETTINGS_TREE_MAX_PAGES) {
+    return data; // Как в конструкторе: дерево отключается
+  }
+  return data + (leaves * 4 + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+}
 
-// FLASH Status Register bits
-#define SR_BSY ((uint32_t)0x00000001)
+// === Чтение через DMA (опционально) ===
+// Включается определением SETTINGS_STORE_DMA. load() больших областей копирует каналом DMA
+// (память-память) и параллельно считает CRC по уже скопированной части. Меньше
+// SS_DMA_THRESHOLD байт копирует ядро: настройка канала дороже самого копирования.
+#if defined(SETTINGS_STORE_DMA) && !defined(SETTINGS_STORE_HOST)
+#ifndef SS_DMA_THRESHOLD
+#define SS_DMA_THRESHOLD 256 // Минимальный размер для копирования через DMA, байт
+#endif
+#ifndef SS_DMA_CHANNEL
+#define SS_DMA_CHANNEL DMA1_Channel1 // Канал DMA (в режиме память-память годится любой)
+#define SS_DMA_TC_FLAG ((uint32_t)0x00000002) // Флаг окончания передачи канала 1 (TCIF1)
+#endif
+#define SS_DMA DMA1
+#define SS_DMA_RCC_EN ((uint32_t)0x00000001)      // RCC_AHBPCENR: тактирование DMA1
+#define SS_DMA_CFGR_EN ((uint32_t)0x00000001)     // Включение канала
+#define SS_DMA_CFGR_PINC ((uint32_t)0x00000040)   // Инкремент адреса источника
+#define SS_DMA_CFGR_MINC ((uint32_t)0x00000080)   // Инкремент адреса приемника
+#define SS_DMA_CFGR_WORDS ((uint32_t)0x00000A00)  // PSIZE = MSIZE = 32 бита
+#define SS_DMA_CFGR_MEM2MEM ((uint32_t)0x00004000) // Режим память-память
+#endif
 
-// FLASH Keys
-// Блокировка записи во flash устанавливается одним битом в регистре, а вот снятие блокировки
-// разработчики сделали в виде последовательной записи в CTRL-регистр вот таких ключей.
-// Видимо, для того, чтобы случайно нельзя было разблокировать запись во flash, т.к. адресное
-// пространство общее и запросто можно по ошибке не туда написать.
-#define FLASH_KEY1 ((uint32_t)0x45670123)
-#define FLASH_KEY2 ((uint32_t)0xCDEF89AB)
+#ifdef SETTINGS_STORE_STATS
+// Статистика работы хранилища
+struct SettingsStats {
+  uint32_t saves;                      // Кол-во фактических записей во flash
+  uint32_t skipped;                    // Кол-во пропущенных записей (данные не изменились)
+  uint32_t busyCycles[FLASH_OP_COUNT]; // Такты ожидания SR_BSY по типам операций
+  uint32_t sleepCycles;                // Из них такты во сне WFI (SETTINGS_STORE_FLASH_IRQ)
+  uint32_t wakeups;                    // Пробуждения WFI другими прерываниями
+  uint32_t lastSaveEnergy;             // Энергия последнего save(), нДж
+};
+#endif
+
+#ifdef SETTINGS_STORE_PROFILE
+// Профиль последнего load(), такты ядра
+struct SettingsLoadProfile {
+  uint32_t done;  // От сброса до окончания load()
+  uint32_t check; // Проверка заголовка (дерево хешей и листья страниц)
+  uint32_t copy;  // Копирование в RAM (при DMA - вместе с перекрытым расчетом CRC)
+  uint32_t crc;   // Расчет CRC
+};
+#endif
 
 class SettingsStore {
   private:
@@ -52,19 +99,66 @@ class SettingsStore {
   uint32_t alignedSize; // Выравненный размер данных кратно странице
   bool useCrc;          // Признак использования CRC
   bool forceWrite;      // Признак записи без проверки на совпадение
+  uint8_t mode;         // Дополнительные режимы (SETTINGS_MODE_*)
+  uint16_t treeLeaves;  // Число листьев дерева хешей (степень двойки)
+  uint32_t treeAddr;    // Адрес дерева хешей во flash
+  uint32_t checkedPages; // Ленивый режим: страницы, проверенные по дереву (битовая маска)
+  uint32_t loadedPages;  // Ленивый режим: страницы, скопированные в RAM
+  bool inFlash;          // Область целиком во flash (на хосте - в отображенном образе)
+#ifdef SETTINGS_STORE_STATS
+  SettingsStats stats; // Статистика и учет энергии
+#endif
+#ifdef SETTINGS_STORE_PROFILE
+  SettingsLoadProfile profile; // Профиль последнего load()
+#endif
 
   public:
-      SettingsStore(void *ptr, size_t length, bool useCrc, bool forceWrite);
+      SettingsStore(void *ptr, size_t length, bool useCrc, bool forceWrite, uint8_t mode = 0,
+                    uint32_t flashEnd = FLASH_END_ADDR);
       void save(void); // Сохранение структуры в flash.
       bool load(void); // Чтение структуры из flash.
+      const void *view(void); // Данные прямо во flash, без копирования (nullptr при ошибке CRC)
+      bool writePage(uint32_t index, const uint8_t *data); // Запись одной страницы области прямо во flash
+      bool verifyPage(uint32_t index);                     // Проверка одной страницы по дереву хешей
+      bool repairPage(uint32_t index);                     // Восстановление страницы из RAM по дереву хешей
+      bool repair(void);                                   // Восстановление всей области из RAM по CRC
+      bool ensure(size_t offset, size_t len);              // Ленивый режим: загрузка страниц диапазона в RAM
+      const void *viewAt(size_t offset, size_t len);       // Ленивый режим: диапазон прямо во flash после проверки
+      uint32_t getAddress(void) const { return address; }         // Адрес области во flash
+      uint32_t getLength(void) const { return length; }           // Размер данных
+      uint32_t getAlignedSize(void) const { return alignedSize; } // Размер области во flash
+      uint8_t getMode(void) const { return mode; }                // Действующие режимы (SETTINGS_MODE_*)
+      bool getUseCrc(void) const { return useCrc; }               // Используется ли CRC
+      bool isValid(void) const { return inFlash; }                // Область во flash; иначе все операции отказывают
+      static uint16_t crc16Update(uint16_t crc, const void *data, size_t len); // Продолжение расчета CRC16-CCITT
+#ifdef SETTINGS_STORE_STATS
+      const SettingsStats &getStats(void) const { return stats; } // Статистика хранилища
+      uint32_t energyUsed(void) const;                            // Оценка затраченной энергии, нДж
+#endif
+#ifdef SETTINGS_STORE_PROFILE
+      const SettingsLoadProfile &getLoadProfile(void) const { return profile; } // Профиль последнего load()
+      void printLoadProfile(void) const;                                         // Вывод профиля через printf
+#endif
 
   private:
+  bool pagesReady(size_t offset, size_t len, bool copy); // Проверка (и копирование) страниц диапазона
+  bool saveAll(void);                                // Запись всей области
+  bool saveTree(void);                               // Запись изменившихся страниц и дерева хешей
+  bool treeValid(void);                              // Проверка дерева хешей во flash
+  bool leafValid(uint32_t index, uint16_t hash);     // Проверка листа и пути до корня
+  uint16_t pageHash(const uint8_t *data, size_t len); // Лист дерева: CRC16 страницы
+  uint16_t nodeHash(uint16_t left, uint16_t right);   // Узел дерева: CRC16 пары узлов
   size_t align_up(size_t value, size_t alignment);                            // Выравнивание по кратности размера
   uint16_t crc16(const void *data, size_t len);                               // CRC16-CCITT
-  uint32_t flashStartAddr(size_t data_size);                                  // Адрес начала данных во flash
+  uint32_t flashStartAddr(size_t data_size, uint32_t end);                    // Адрес начала данных во flash
   void flashRead(uint32_t addr, uint8_t *buf, size_t len);                    // Чтение данных из flash
+  uint16_t flashReadCrc(uint32_t addr, uint8_t *buf, size_t len, size_t crcLen); // Чтение с расчетом CRC (DMA)
   void flashErase(/* size_t size */);                                         // Очистка области flash, выделенной под сохранение настроек.
   void flashWrite(/* uint32_t StartAddr, uint32_t *pbuf, uint32_t Length */); // Запись данных во flash
+  void flashWriteTree(const uint16_t *tree);                                  // Запись дерева хешей во flash
 };
 
+// Загрузка поля структуры настроек в ленивом режиме: SETTINGS_ENSURE(settings, AppConfig, baud)
+#define SETTINGS_ENSURE(store, type, field) (store).ensure(offsetof(type, field), sizeof(((type *)0)->field))
+
 #endif // SETTINGS_STORE_H
\ No newline at end of file
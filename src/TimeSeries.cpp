@@ -0,0 +1,124 @@
+//============================================================= (c) A.Kolesov ==
+// TimeSeries.cpp
+// Многоуровневая история измерений во flash: агрегаты копятся в RAM, законченные
+// интервалы пишутся в кольцевые журналы уровней.
+//
+// Пример (время - в секундах, страницы - под областью настроек):
+//   TimeSeriesTier tiers[] = {
+//       {60, 0x08002000, 64},    // Минуты
+//       {3600, 0x08003000, 32},  // Часы
+//       {86400, 0x08003800, 8},  // Сутки
+//   };
+//   TimeSeries history(tiers, 3);
+//   history.open();
+//   ...
+//   history.add(now, temperature);
+//   ...
+//   history.query(1, now - 86400, now, printRecord, nullptr); // Часовые за сутки
+//------------------------------------------------------------------------------
+
+#include "TimeSeries.h"
+
+//==============================================================================
+// Конструктор
+//  @param tiers - уровни хранения, от самого подробного
+//  @param count - количество уровней
+//------------------------------------------------------------------------------
+TimeSeries::TimeSeries(TimeSeriesTier *tiers, uint8_t count) : tiers(tiers), count(count) {
+}
+
+//==============================================================================
+// Открытие журналов всех уровней после сброса. Агрегаты незаконченных интервалов
+// хранятся только в RAM и после сброса начинаются заново.
+//  @return - false, если параметры какого-либо уровня неверны
+//------------------------------------------------------------------------------
+bool TimeSeries::open() {
+  bool ok = true;
+  for (uint8_t i = 0; i < this->count; ++i) {
+    this->tiers[i].acc.count = 0;
+    ok = this->tiers[i].queue.open() && ok;
+  }
+  return ok;
+}
+
+//==============================================================================
+// Новое значение: учитывается в агрегатах текущих интервалов всех уровней.
+// Если время вышло за текущий интервал уровня, его агрегат записывается во flash.
+//  @param time  - время значения (не убывает от вызова к вызову)
+//  @param value - значение
+//------------------------------------------------------------------------------
+void TimeSeries::add(uint32_t time, int16_t value) {
+  for (uint8_t i = 0; i < this->count; ++i) {
+    TimeSeriesTier &tier = this->tiers[i];
+    uint32_t start = time - time % tier.period;
+    if (tier.acc.count && start != tier.acc.time) {
+      flush(tier);
+    }
+    if (tier.acc.count == 0) {
+      tier.acc.time = start;
+      tier.acc.min = value;
+      tier.acc.max = value;
+      tier.acc.sum = 0;
+    }
+    if (value < tier.acc.min) {
+      tier.acc.min = value;
+    }
+    if (value > tier.acc.max) {
+      tier.acc.max = value;
+    }
+    // sum и count копятся вместе: после 65535 значений среднее считается по ним, а min/max -
+    // по всем значениям интервала. 65535 * 32767 помещается в int32_t - переполнения нет
+    if (tier.acc.count < 0xFFFF) {
+      tier.acc.sum += value;
+      tier.acc.count++;
+    }
+  }
+}
+
+//==============================================================================
+// Записи уровня за интервал времени, от старых к новым, прямо из flash.
+// Незаконченный интервал (в RAM) сюда не входит - см. current().
+//  @param tier - номер уровня
+//  @param from - начало (включительно)
+//  @param to   - конец (не включительно)
+//  @param fn   - обработка каждой записи
+//  @param arg  - аргумент для fn
+//  @return     - количество найденных записей
+//------------------------------------------------------------------------------
+uint16_t TimeSeries::query(uint8_t tier, uint32_t from, uint32_t to, TsVisitFn fn, void *arg) {
+  if (tier >= this->count) {
+    return 0;
+  }
+  uint16_t found = 0;
+  FlashQueueIter it;
+  for (const uint8_t *p = this->tiers[tier].queue.begin(it); p; p = this->tiers[tier].queue.next(it)) {
+    const TsRecord *rec = (const TsRecord *)p;
+    if (rec->time >= to) {
+      break; // Записи идут по возрастанию времени
+    }
+    if (rec->time >= from) {
+      fn(rec, arg);
+      found++;
+    }
+  }
+  return found;
+}
+
+//==============================================================================
+// Агрегат незаконченного интервала уровня
+//  @return - nullptr, если в текущем интервале еще нет значений
+//------------------------------------------------------------------------------
+const TsRecord *TimeSeries::current(uint8_t tier) const {
+  if (tier >= this->count || this->tiers[tier].acc.count == 0) {
+    return nullptr;
+  }
+  return &this->tiers[tier].acc;
+}
+
+//==============================================================================
+// Запись агрегата законченного интервала в журнал уровня
+//------------------------------------------------------------------------------
+void TimeSeries::flush(TimeSeriesTier &tier) {
+  tier.queue.push(&tier.acc);
+  tier.acc.count = 0;
+}
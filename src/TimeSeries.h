@@ -0,0 +1,57 @@
+#ifndef TIME_SERIES_H
+#define TIME_SERIES_H
+
+// Многоуровневое хранение истории измерений во flash: например, минутные значения за
+// сутки, часовые агрегаты за месяц и суточные за год.
+//
+// Каждый уровень (TimeSeriesTier) - кольцевой журнал FlashQueue в режиме overwrite
+// на своем диапазоне страниц: новые записи вытесняют самые старые. Агрегат текущего
+// интервала уровня (min/max/sum/count) копится в RAM при каждом add() и записывается
+// одной записью TsRecord, когда интервал закончился. Запросы читают записи прямо из
+// flash, без копирования.
+// В среднее интервала (sum / count) входят не больше 65535 значений: частота add() для
+// уровня - не выше 65535 / period (для суточного уровня - реже раза в 1,3 с), иначе
+// среднее считается по первым 65535 значениям интервала. min/max учитывают все значения.
+
+#include "FlashQueue.h"
+
+// Запись уровня: агрегат за интервал [time, time + period)
+struct TsRecord {
+  uint32_t time;  // Начало интервала
+  int16_t min;    // Минимум
+  int16_t max;    // Максимум
+  int32_t sum;    // Сумма (среднее = sum / count)
+  uint16_t count; // Количество значений
+} __attribute__((packed));
+
+typedef void (*TsVisitFn)(const TsRecord *rec, void *arg); // Обработка записи запроса
+
+// Уровень хранения: длительность интервала и свой диапазон страниц flash
+struct TimeSeriesTier {
+  uint32_t period;  // Длительность интервала (в единицах time, например секундах)
+  FlashQueue queue; // Журнал записей уровня
+  TsRecord acc;     // Агрегат текущего интервала (в RAM)
+
+  TimeSeriesTier(uint32_t period, uint32_t startAddr, uint16_t pages)
+      : period(period), queue(startAddr, pages, sizeof(TsRecord), true) {
+    acc.count = 0;
+  }
+};
+
+class TimeSeries {
+  private:
+  TimeSeriesTier *tiers; // Уровни, от самого подробного
+  uint8_t count;         // Количество уровней
+
+  public:
+  TimeSeries(TimeSeriesTier *tiers, uint8_t count);
+  bool open(void);                                 // Открытие журналов уровней после сброса
+  void add(uint32_t time, int16_t value);          // Новое значение
+  uint16_t query(uint8_t tier, uint32_t from, uint32_t to, TsVisitFn fn, void *arg); // Записи уровня за [from, to)
+  const TsRecord *current(uint8_t tier) const;     // Незаконченный интервал уровня (nullptr - пуст)
+
+  private:
+  void flush(TimeSeriesTier &tier); // Запись агрегата законченного интервала
+};
+
+#endif // TIME_SERIES_H
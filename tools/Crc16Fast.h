@@ -0,0 +1,172 @@
+#ifndef CRC16_FAST_H
+#define CRC16_FAST_H
+
+// Быстрый CRC16-CCITT для хостовых утилит (полином 0x1021, без отражения битов).
+// Результат совпадает с SettingsStore::crc16() при начальном значении 0xFFFF.
+//
+// - crc16Bitwise()  - эталонный побитовый вариант, как в библиотеке;
+// - crc16Slice8()   - таблицы slicing-by-8 (8 байт за итерацию);
+// - crc16Clmul()    - свертка блоков по 16 байт умножением без переноса (PCLMULQDQ, x86);
+// - crc16Fast()     - выбор лучшего варианта при первом вызове по возможностям процессора.
+//
+// Все функции продолжают расчет от заданного значения crc, поэтому данные можно
+// обрабатывать частями: crc = crc16Fast(crc16Fast(0xFFFF, a, n), b, m).
+//
+// Свертка (fold): сообщение делится на блоки A, B по 128 бит. A·x^128 + B по модулю P
+// равно A_hi·(x^192 mod P) + A_lo·(x^128 mod P) + B, где оба произведения не длиннее
+// 80 бит. Так все сообщение сворачивается в остаток R (128 бит), сравнимый с ним по
+// модулю P; CRC от R и хвоста сообщения досчитывается таблицами.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC16_HAVE_CLMUL 1
+#endif
+
+//==============================================================================
+// Эталонный побитовый CRC16-CCITT
+//------------------------------------------------------------------------------
+inline uint16_t crc16Bitwise(uint16_t crc, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; ++i) {
+    crc ^= (uint16_t)(p[i]) << 8;
+    for (int j = 0; j < 8; ++j) {
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+    }
+  }
+  return crc;
+}
+
+// Таблицы slicing-by-8: t[k][n] - вклад байта n, за которым следуют k нулевых байт
+struct Crc16Tables {
+  uint16_t t[8][256];
+
+  Crc16Tables() {
+    for (unsigned n = 0; n < 256; ++n) {
+      uint8_t b = (uint8_t)n;
+      t[0][n] = crc16Bitwise(0, &b, 1);
+    }
+    for (unsigned k = 1; k < 8; ++k) {
+      for (unsigned n = 0; n < 256; ++n) {
+        uint16_t c = t[k - 1][n];
+        t[k][n] = (uint16_t)(c << 8) ^ t[0][c >> 8];
+      }
+    }
+  }
+};
+
+inline const Crc16Tables &crc16Tables() {
+  static const Crc16Tables tables;
+  return tables;
+}
+
+//==============================================================================
+// CRC16-CCITT таблицами slicing-by-8
+//------------------------------------------------------------------------------
+inline uint16_t crc16Slice8(uint16_t crc, const void *data, size_t len) {
+  const uint16_t(*t)[256] = crc16Tables().t;
+  const uint8_t *p = (const uint8_t *)data;
+  while (len >= 8) {
+    crc = t[7][p[0] ^ (crc >> 8)] ^ t[6][p[1] ^ (crc & 0xFF)] ^ t[5][p[2]] ^ t[4][p[3]] ^ t[3][p[4]] ^
+          t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+    len -= 8;
+  }
+  while (len--) {
+    crc = (uint16_t)(crc << 8) ^ t[0][(crc >> 8) ^ *p++];
+  }
+  return crc;
+}
+
+//==============================================================================
+// x^n mod P (P = x^16 + 0x1021) - константы для свертки
+//------------------------------------------------------------------------------
+inline uint64_t crc16XpowMod(unsigned n) {
+  uint32_t r = 1;
+  for (unsigned i = 0; i < n; ++i) {
+    r <<= 1;
+    if (r & 0x10000) {
+      r ^= 0x11021;
+    }
+  }
+  return r;
+}
+
+#ifdef CRC16_HAVE_CLMUL
+//==============================================================================
+// Свертка 128-битного остатка acc через 128*distance бит: acc·x^(128·d) mod P (до 80 бит)
+//------------------------------------------------------------------------------
+__attribute__((target("pclmul,ssse3"))) inline __m128i crc16Fold(__m128i acc, __m128i k) {
+  // k: младшее слово - x^(128d) mod P, старшее - x^(128d+64) mod P
+  return _mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x00), _mm_clmulepi64_si128(acc, k, 0x11));
+}
+
+//==============================================================================
+// CRC16-CCITT сверткой PCLMULQDQ: 4 независимые цепочки по 16 байт
+//------------------------------------------------------------------------------
+__attribute__((target("pclmul,ssse3"))) inline uint16_t crc16Clmul(uint16_t crc, const void *data, size_t len) {
+  if (len < 64) {
+    return crc16Slice8(crc, data, len);
+  }
+  static const uint64_t k512lo = crc16XpowMod(512), k512hi = crc16XpowMod(576);
+  static const uint64_t k128lo = crc16XpowMod(128), k128hi = crc16XpowMod(192);
+  const __m128i k512 = _mm_set_epi64x((long long)k512hi, (long long)k512lo);
+  const __m128i k128 = _mm_set_epi64x((long long)k128hi, (long long)k128lo);
+  // Разворот байт: первый байт сообщения - старшие степени полинома
+  const __m128i bswap = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const uint8_t *p = (const uint8_t *)data;
+
+  __m128i a0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 0)), bswap);
+  __m128i a1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), bswap);
+  __m128i a2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 32)), bswap);
+  __m128i a3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 48)), bswap);
+  // Начальное значение crc эквивалентно XOR с первыми двумя байтами сообщения
+  a0 = _mm_xor_si128(a0, _mm_set_epi64x((long long)((uint64_t)crc << 48), 0));
+  p += 64;
+  len -= 64;
+
+  while (len >= 64) {
+    a0 = _mm_xor_si128(crc16Fold(a0, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 0)), bswap));
+    a1 = _mm_xor_si128(crc16Fold(a1, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 16)), bswap));
+    a2 = _mm_xor_si128(crc16Fold(a2, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 32)), bswap));
+    a3 = _mm_xor_si128(crc16Fold(a3, k512), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p + 48)), bswap));
+    p += 64;
+    len -= 64;
+  }
+  // Сведение цепочек в одну: a0·x^384 + a1·x^256 + a2·x^128 + a3
+  __m128i acc = _mm_xor_si128(crc16Fold(a0, k128), a1);
+  acc = _mm_xor_si128(crc16Fold(acc, k128), a2);
+  acc = _mm_xor_si128(crc16Fold(acc, k128), a3);
+  while (len >= 16) {
+    acc = _mm_xor_si128(crc16Fold(acc, k128), _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)p), bswap));
+    p += 16;
+    len -= 16;
+  }
+  // Остаток R сравним с обработанной частью сообщения: CRC от R (init 0) и хвоста
+  uint8_t r[16];
+  _mm_storeu_si128((__m128i *)r, _mm_shuffle_epi8(acc, bswap));
+  crc = crc16Slice8(0, r, sizeof(r));
+  return crc16Slice8(crc, p, len);
+}
+#endif // CRC16_HAVE_CLMUL
+
+//==============================================================================
+// CRC16-CCITT лучшим доступным способом (выбор при первом вызове)
+//------------------------------------------------------------------------------
+inline uint16_t crc16Fast(uint16_t crc, const void *data, size_t len) {
+  typedef uint16_t (*Crc16Fn)(uint16_t, const void *, size_t);
+  static const Crc16Fn fn = [] {
+#ifdef CRC16_HAVE_CLMUL
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3")) {
+      return (Crc16Fn)crc16Clmul;
+    }
+#endif
+    return (Crc16Fn)crc16Slice8;
+  }();
+  return fn(crc, data, len);
+}
+
+#endif // CRC16_FAST_H
@@ -0,0 +1,179 @@
+#ifndef INTEL_HEX_H
+#define INTEL_HEX_H
+
+// Чтение и запись образов памяти в формате Intel HEX для хостовых утилит.
+// Образ хранится плоским буфером от минимального до максимального адреса с маской
+// заполненных байт, поэтому наложение данных и запись выполняются без лишних копий.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+struct HexImage {
+  uint32_t base = 0;          // Адрес первого байта буфера
+  std::vector<uint8_t> data;  // Данные
+  std::vector<uint8_t> used;  // 1 - байт присутствует в образе
+  bool hasStart = false;      // Есть запись стартового адреса (тип 05)
+  uint32_t start = 0;         // Стартовый адрес
+
+  //============================================================================
+  // Запись данных в образ с расширением буфера при необходимости
+  //----------------------------------------------------------------------------
+  void put(uint32_t addr, const uint8_t *src, size_t len) {
+    if (len == 0) {
+      return;
+    }
+    if (data.empty()) {
+      base = addr;
+    }
+    if (addr < base) { // Расширяем буфер вниз
+      size_t grow = base - addr;
+      data.insert(data.begin(), grow, 0xFF);
+      used.insert(used.begin(), grow, 0);
+      base = addr;
+    }
+    size_t end = (size_t)(addr - base) + len;
+    if (end > data.size()) {
+      data.resize(end, 0xFF);
+      used.resize(end, 0);
+    }
+    for (size_t i = 0; i < len; ++i) {
+      data[addr - base + i] = src[i];
+      used[addr - base + i] = 1;
+    }
+  }
+
+  //============================================================================
+  // Есть ли в образе хотя бы один байт из диапазона [addr, addr + len)
+  //----------------------------------------------------------------------------
+  bool overlaps(uint32_t addr, size_t len) const {
+    for (size_t i = 0; i < len; ++i) {
+      uint32_t a = addr + (uint32_t)i;
+      if (a >= base && a - base < used.size() && used[a - base]) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+static inline int hexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  return -1;
+}
+
+//==============================================================================
+// Разбор текста Intel HEX
+//  @return - true при успехе, иначе err - описание ошибки
+//------------------------------------------------------------------------------
+inline bool parseIntelHex(const std::string &text, HexImage &img, std::string &err) {
+  uint32_t upper = 0; // Старшая часть адреса (записи 02 и 04)
+  size_t pos = 0;
+  int lineNo = 0;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    std::string line = text.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+    pos = eol == std::string::npos ? text.size() : eol + 1;
+    lineNo++;
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+    if (line[0] != ':' || line.size() < 11 || line.size() % 2 == 0) {
+      err = "line " + std::to_string(lineNo) + ": bad record";
+      return false;
+    }
+    std::vector<uint8_t> rec;
+    uint8_t sum = 0;
+    for (size_t i = 1; i < line.size(); i += 2) {
+      int hi = hexNibble(line[i]), lo = hexNibble(line[i + 1]);
+      if (hi < 0 || lo < 0) {
+        err = "line " + std::to_string(lineNo) + ": bad hex digit";
+        return false;
+      }
+      rec.push_back((uint8_t)(hi << 4 | lo));
+      sum += rec.back();
+    }
+    if (sum != 0 || rec.size() != (size_t)rec[0] + 5) {
+      err = "line " + std::to_string(lineNo) + ": bad length or checksum";
+      return false;
+    }
+    uint8_t type = rec[3];
+    uint32_t offset = (uint32_t)rec[1] << 8 | rec[2];
+    const uint8_t *payload = &rec[4];
+    switch (type) {
+    case 0x00: img.put(upper + offset, payload, rec[0]); break;
+    case 0x01: return true;
+    case 0x02: upper = ((uint32_t)payload[0] << 8 | payload[1]) << 4; break;
+    case 0x04: upper = ((uint32_t)payload[0] << 8 | payload[1]) << 16; break;
+    case 0x05:
+      img.hasStart = true;
+      img.start = (uint32_t)payload[0] << 24 | (uint32_t)payload[1] << 16 | (uint32_t)payload[2] << 8 | payload[3];
+      break;
+    default: break; // 03 (стартовый адрес CS:IP) не используется на RISC-V
+    }
+  }
+  return true;
+}
+
+static inline void hexRecord(std::string &out, uint8_t type, uint16_t offset, const uint8_t *payload, size_t len) {
+  static const char digits[] = "0123456789ABCDEF";
+  uint8_t sum = (uint8_t)(len + (offset >> 8) + (offset & 0xFF) + type);
+  auto byte = [&](uint8_t b) {
+    out += digits[b >> 4];
+    out += digits[b & 0xF];
+  };
+  out += ':';
+  byte((uint8_t)len);
+  byte((uint8_t)(offset >> 8));
+  byte((uint8_t)offset);
+  byte(type);
+  for (size_t i = 0; i < len; ++i) {
+    byte(payload[i]);
+    sum += payload[i];
+  }
+  byte((uint8_t)-sum);
+  out += '\n';
+}
+
+//==============================================================================
+// Формирование текста Intel HEX (записи по 16 байт, только заполненные байты)
+//------------------------------------------------------------------------------
+inline std::string formatIntelHex(const HexImage &img) {
+  std::string out;
+  uint32_t upper = 0xFFFFFFFF;
+  size_t i = 0;
+  while (i < img.data.size()) {
+    if (!img.used[i]) {
+      i++;
+      continue;
+    }
+    uint32_t addr = img.base + (uint32_t)i;
+    size_t len = 0;
+    // Запись не пересекает границу 16 байт и границу 64 КБ
+    while (i + len < img.data.size() && img.used[i + len] && len < 16 - (addr & 15)) {
+      len++;
+    }
+    if ((addr >> 16) != upper) {
+      upper = addr >> 16;
+      uint8_t ext[2] = {(uint8_t)(upper >> 8), (uint8_t)upper};
+      hexRecord(out, 0x04, 0, ext, 2);
+    }
+    hexRecord(out, 0x00, (uint16_t)addr, &img.data[i], len);
+    i += len;
+  }
+  if (img.hasStart) {
+    uint8_t s[4] = {(uint8_t)(img.start >> 24), (uint8_t)(img.start >> 16), (uint8_t)(img.start >> 8),
+                    (uint8_t)img.start};
+    hexRecord(out, 0x05, 0, s, 4);
+  }
+  hexRecord(out, 0x01, 0, nullptr, 0);
+  return out;
+}
+
+#endif // INTEL_HEX_H
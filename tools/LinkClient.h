@@ -0,0 +1,146 @@
+#ifndef LINK_CLIENT_H
+#define LINK_CLIENT_H
+
+// Хостовая сторона протокола SettingsLink (src/SettingsLink.h) поверх произвольного
+// транспорта: последовательного порта (sslink) или канала в памяти (ssbench).
+// Ведет учет переданных/принятых байт и записанных страниц.
+
+#include "SettingsLink.h"
+#include <functional>
+#include <vector>
+
+#define LINK_TIMEOUT_MS 1000 // Ожидание ответа
+#define LINK_RETRIES 3       // Повторы запроса без ответа
+
+struct LinkInfo {
+  uint32_t address;     // Адрес области настроек во flash
+  uint32_t length;      // Размер данных
+  uint32_t alignedSize; // Размер области
+  uint16_t pageSize;    // Размер страницы flash
+};
+
+class LinkClient {
+  public:
+  typedef std::function<void(const uint8_t *data, size_t len)> WriteFn; // Передача байт
+  typedef std::function<int(int timeoutMs)> ReadFn;                     // Прием байта (-1 - таймаут)
+
+  uint64_t bytesSent = 0;     // Передано байт
+  uint64_t bytesReceived = 0; // Принято байт
+  uint32_t pagesWritten = 0;  // Записано страниц
+
+  LinkClient(WriteFn write, ReadFn read) : write(write), read(read), rxBuf(0x10000), rx(rxBuf.data(), 0xFFFF) {}
+
+  //============================================================================
+  // Параметры области настроек устройства
+  //----------------------------------------------------------------------------
+  bool info(LinkInfo &out) {
+    if (!request(LINK_CMD_INFO, nullptr, 0) || rx.len != 14) {
+      return false;
+    }
+    const uint8_t *d = rx.data();
+    out.address = le32(d);
+    out.length = le32(d + 4);
+    out.alignedSize = le32(d + 8);
+    out.pageSize = (uint16_t)(d[12] | d[13] << 8);
+    return true;
+  }
+
+  //============================================================================
+  // Чтение всей области настроек
+  //----------------------------------------------------------------------------
+  bool readImage(std::vector<uint8_t> &img) {
+    if (!request(LINK_CMD_READ, nullptr, 0)) {
+      return false;
+    }
+    img.assign(rx.data(), rx.data() + rx.len);
+    return true;
+  }
+
+  //============================================================================
+  // CRC16 страниц области на устройстве
+  //----------------------------------------------------------------------------
+  bool pageHashes(std::vector<uint16_t> &hashes) {
+    if (!request(LINK_CMD_HASHES, nullptr, 0)) {
+      return false;
+    }
+    hashes.clear();
+    for (uint16_t i = 0; i + 1 < rx.len; i += 2) {
+      hashes.push_back((uint16_t)(rx.data()[i] | rx.data()[i + 1] << 8));
+    }
+    return true;
+  }
+
+  //============================================================================
+  // Запись одной страницы с ожиданием подтверждения
+  //----------------------------------------------------------------------------
+  bool writePage(uint32_t index, const uint8_t *page) {
+    uint8_t frame[2 + FLASH_PAGE_SIZE];
+    frame[0] = (uint8_t)index;
+    frame[1] = (uint8_t)(index >> 8);
+    memcpy(frame + 2, page, FLASH_PAGE_SIZE);
+    if (!request(LINK_CMD_WRITE, frame, sizeof(frame)) || rx.len != 3 || rx.data()[2] != LINK_OK) {
+      return false;
+    }
+    pagesWritten++;
+    return true;
+  }
+
+  //============================================================================
+  // Запись образа. При delta = true сначала сравниваются CRC страниц и передаются
+  // только отличающиеся страницы.
+  //  @param img   - образ области (alignedSize байт)
+  //  @param delta - передавать только измененные страницы
+  //----------------------------------------------------------------------------
+  bool writeImage(const std::vector<uint8_t> &img, bool delta) {
+    uint32_t pages = (uint32_t)(img.size() / FLASH_PAGE_SIZE);
+    std::vector<uint16_t> hashes;
+    if (delta && (!pageHashes(hashes) || hashes.size() != pages)) {
+      return false;
+    }
+    for (uint32_t i = 0; i < pages; ++i) {
+      const uint8_t *page = &img[i * FLASH_PAGE_SIZE];
+      if (delta && hashes[i] == SettingsStore::crc16Update(0xFFFF, page, FLASH_PAGE_SIZE)) {
+        continue; // Страница на устройстве уже такая же
+      }
+      if (!writePage(i, page)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  private:
+  WriteFn write;
+  ReadFn read;
+  std::vector<uint8_t> rxBuf;
+  SettingsFrame rx;
+
+  static uint32_t le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+  }
+
+  //============================================================================
+  // Запрос и ожидание ответа cmd | LINK_REPLY с повтором по таймауту
+  //----------------------------------------------------------------------------
+  bool request(uint8_t cmd, const uint8_t *data, uint16_t len) {
+    std::vector<uint8_t> frame = {LINK_SYNC, cmd, (uint8_t)len, (uint8_t)(len >> 8)};
+    frame.insert(frame.end(), data, data + len);
+    uint16_t crc = SettingsStore::crc16Update(0xFFFF, frame.data() + 1, frame.size() - 1);
+    frame.push_back((uint8_t)crc);
+    frame.push_back((uint8_t)(crc >> 8));
+    for (int attempt = 0; attempt < LINK_RETRIES; ++attempt) {
+      write(frame.data(), frame.size());
+      bytesSent += frame.size();
+      int c;
+      while ((c = read(LINK_TIMEOUT_MS)) >= 0) {
+        bytesReceived++;
+        if (rx.feed((uint8_t)c) && rx.cmd == (cmd | LINK_REPLY)) {
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+};
+
+#endif // LINK_CLIENT_H
@@ -0,0 +1,87 @@
+#ifndef PARALLEL_FOR_H
+#define PARALLEL_FOR_H
+
+// Параллельная обработка диапазона индексов [0, count) пулом потоков с work-stealing.
+//
+// Каждый поток получает свой непрерывный поддиапазон и берет задания с его начала.
+// Освободившийся поток "крадет" вторую половину поддиапазона у другого потока.
+// Поддиапазон хранится в одном атомарном 64-битном слове (начало, конец), поэтому
+// и владелец, и вор меняют его одним CAS, без блокировок.
+//
+//   parallelFor(files.size(), threads, [&](size_t i, unsigned worker) { ... });
+
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+template <typename Fn>
+void parallelFor(size_t count, unsigned threads, Fn fn) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  if (threads > count) {
+    threads = count == 0 ? 1 : (unsigned)count;
+  }
+
+  struct alignas(64) Range {
+    std::atomic<uint64_t> span; // (начало << 32) | конец
+  };
+  std::vector<Range> ranges(threads);
+  for (unsigned t = 0; t < threads; ++t) {
+    uint64_t b = count * t / threads, e = count * (t + 1) / threads;
+    ranges[t].span.store(b << 32 | e);
+  }
+
+  auto worker = [&](unsigned self) {
+    std::atomic<uint64_t> &mine = ranges[self].span;
+    for (;;) {
+      // Берем задание из своего поддиапазона
+      uint64_t s = mine.load();
+      uint32_t b = (uint32_t)(s >> 32), e = (uint32_t)s;
+      if (b < e) {
+        if (mine.compare_exchange_weak(s, (uint64_t)(b + 1) << 32 | e)) {
+          fn((size_t)b, self);
+        }
+        continue;
+      }
+      // Свой поддиапазон пуст - крадем половину у самого загруженного потока
+      unsigned victim = self;
+      uint32_t best = 0;
+      for (unsigned t = 0; t < threads; ++t) {
+        uint64_t v = ranges[t].span.load();
+        uint32_t left = (uint32_t)v - (uint32_t)(v >> 32);
+        if ((uint32_t)(v >> 32) < (uint32_t)v && left > best) {
+          best = left;
+          victim = t;
+        }
+      }
+      if (victim == self) {
+        return; // Работы не осталось
+      }
+      uint64_t v = ranges[victim].span.load();
+      uint32_t vb = (uint32_t)(v >> 32), ve = (uint32_t)v;
+      if (vb >= ve) {
+        continue;
+      }
+      uint32_t mid = ve - (ve - vb + 1) / 2; // Вору - вторая половина [mid, ve)
+      if (ranges[victim].span.compare_exchange_strong(v, (uint64_t)vb << 32 | mid)) {
+        mine.store((uint64_t)mid << 32 | ve);
+      }
+    }
+  };
+
+  std::vector<std::thread> pool;
+  for (unsigned t = 1; t < threads; ++t) {
+    pool.emplace_back(worker, t);
+  }
+  worker(0);
+  for (std::thread &t : pool) {
+    t.join();
+  }
+}
+
+#endif // PARALLEL_FOR_H
@@ -0,0 +1,508 @@
+#ifndef RV_SIM_H
+#define RV_SIM_H
+
+// Минимальный симулятор системы команд RV32EC (RV32I + сжатые команды, 16 регистров)
+// для проверки и замеров ядер библиотеки на хосте, без платы.
+//
+// Загружает ELF32 RISC-V: исполняемый файл (по программным заголовкам) или объектный
+// файл без перемещений (секции подряд с адреса FLASH_BASE, например результат
+// ассемблирования SettingsStoreAsm.S). Функция вызывается по имени символа с
+// аргументами в a0..a5; счетчик instret считает выполненные команды.
+//
+// Карта памяти:
+//   FLASH_BASE..+FLASH_SIZE - flash (код, константы и область настроек в ее конце);
+//   RAM_BASE..+RAM_SIZE     - RAM (стек - от конца);
+//   0x40000000..0x5FFFFFFF, 0xE0000000..0xFFFFFFEF - заглушка периферии: чтение дает 0
+//   (в том числе FLASH->STATR: flash никогда не занята), запись игнорируется.
+// Умножения (M) в RV32EC нет, поэтому и здесь нет; CSR читаются как 0.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class RvSim {
+  public:
+  static const uint32_t FLASH_BASE = 0x08000000;
+  static const uint32_t FLASH_SIZE = 0x00040000; // С запасом: у CH32V003 всего 16 КБ
+  static const uint32_t RAM_BASE = 0x20000000;
+  static const uint32_t RAM_SIZE = 0x00010000;
+  static const uint32_t RETURN_ADDR = 0xFFFFFFF0; // Адрес возврата из вызываемой функции
+
+  uint64_t instret = 0;     // Выполнено команд за последний call()
+  uint64_t limit = 1u << 30; // Предел команд на один call()
+  std::string error;        // Описание ошибки (неизвестная команда, доступ вне памяти)
+
+  RvSim() : flash(FLASH_SIZE, 0xFF), ram(RAM_SIZE, 0) {}
+
+  //============================================================================
+  // Загрузка ELF32 RISC-V
+  //  @param path - путь к файлу
+  //  @return     - false при ошибке (описание в error)
+  //----------------------------------------------------------------------------
+  bool load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+      error = std::string("cannot open ") + path;
+      return false;
+    }
+    std::vector<uint8_t> elf;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+      elf.insert(elf.end(), chunk, chunk + n);
+    }
+    fclose(f);
+    if (elf.size() < 52 || memcmp(elf.data(), "\x7f" "ELF", 4) != 0 || elf[4] != 1 || rd16(elf, 18) != 243) {
+      error = "not an ELF32 RISC-V file";
+      return false;
+    }
+    uint16_t type = rd16(elf, 16);
+    uint32_t phoff = rd32(elf, 28), shoff = rd32(elf, 32);
+    uint16_t phnum = rd16(elf, 44), shnum = rd16(elf, 48);
+    std::vector<uint32_t> base(shnum, 0); // Адрес загрузки каждой секции
+
+    if (type == 2) { // ET_EXEC: программные заголовки
+      for (uint16_t i = 0; i < phnum; ++i) {
+        size_t ph = phoff + i * 32;
+        if (rd32(elf, ph) != 1) { // PT_LOAD
+          continue;
+        }
+        uint32_t off = rd32(elf, ph + 4), vaddr = rd32(elf, ph + 8), filesz = rd32(elf, ph + 16);
+        uint32_t memsz = rd32(elf, ph + 20);
+        for (uint32_t j = 0; j < memsz; ++j) {
+          uint8_t *p = at(vaddr + j, 1);
+          if (!p || off + j > elf.size()) {
+            error = "segment outside memory map";
+            return false;
+          }
+          *p = j < filesz ? elf[off + j] : 0;
+        }
+      }
+    } else if (type == 1) { // ET_REL: секции SHF_ALLOC подряд с начала flash
+      uint32_t addr = FLASH_BASE;
+      for (uint16_t i = 0; i < shnum; ++i) {
+        size_t sh = shoff + i * 40;
+        uint32_t shType = rd32(elf, sh + 4), flags = rd32(elf, sh + 8);
+        if ((shType == 4 || shType == 9) && rd32(elf, sh + 28) < shnum) { // SHT_RELA / SHT_REL
+          size_t target = shoff + rd32(elf, sh + 28) * 40;
+          if ((rd32(elf, target + 8) & 2) && rd32(elf, sh + 20) != 0) {
+            error = "object has relocations: link it first";
+            return false;
+          }
+        }
+        if (!(flags & 2)) { // SHF_ALLOC
+          continue;
+        }
+        uint32_t align = rd32(elf, sh + 32) ? rd32(elf, sh + 32) : 1;
+        addr = (addr + align - 1) / align * align;
+        base[i] = addr;
+        uint32_t off = rd32(elf, sh + 16), size = rd32(elf, sh + 20);
+        for (uint32_t j = 0; j < size; ++j) {
+          uint8_t *p = at(addr + j, 1);
+          if (!p) {
+            error = "section outside memory map";
+            return false;
+          }
+          *p = shType == 8 ? 0 : elf[off + j]; // SHT_NOBITS
+        }
+        addr += size;
+      }
+    } else {
+      error = "unsupported ELF type";
+      return false;
+    }
+
+    // Таблица символов
+    for (uint16_t i = 0; i < shnum; ++i) {
+      size_t sh = shoff + i * 40;
+      if (rd32(elf, sh + 4) != 2) { // SHT_SYMTAB
+        continue;
+      }
+      size_t strSh = shoff + rd32(elf, sh + 24) * 40;
+      uint32_t strOff = rd32(elf, strSh + 16);
+      uint32_t off = rd32(elf, sh + 16), size = rd32(elf, sh + 20);
+      for (uint32_t s = off; s + 16 <= off + size; s += 16) {
+        uint16_t shndx = rd16(elf, s + 14);
+        if (shndx == 0 || shndx >= shnum) {
+          continue;
+        }
+        const char *name = (const char *)elf.data() + strOff + rd32(elf, s);
+        if (*name) {
+          symbols.push_back({name, base[shndx] + rd32(elf, s + 4)});
+        }
+      }
+    }
+    return true;
+  }
+
+  //============================================================================
+  // Адрес символа (0, если не найден)
+  //----------------------------------------------------------------------------
+  uint32_t symbol(const char *name) const {
+    for (const Symbol &s : symbols) {
+      if (s.name == name) {
+        return s.addr;
+      }
+    }
+    return 0;
+  }
+
+  //============================================================================
+  // Указатель на память симулятора (для подготовки данных и чтения результатов)
+  //  @return - nullptr, если диапазон не целиком во flash или RAM
+  //----------------------------------------------------------------------------
+  uint8_t *at(uint32_t addr, uint32_t len) {
+    if (addr >= FLASH_BASE && addr - FLASH_BASE + (uint64_t)len <= FLASH_SIZE) {
+      return &flash[addr - FLASH_BASE];
+    }
+    if (addr >= RAM_BASE && addr - RAM_BASE + (uint64_t)len <= RAM_SIZE) {
+      return &ram[addr - RAM_BASE];
+    }
+    return nullptr;
+  }
+
+  //============================================================================
+  // Вызов функции
+  //  @param fn   - адрес функции
+  //  @param args - аргументы (a0..a5)
+  //  @return     - a0 после возврата; при ошибке error не пуст
+  //----------------------------------------------------------------------------
+  uint32_t call(uint32_t fn, std::initializer_list<uint32_t> args) {
+    memset(x, 0, sizeof(x));
+    uint8_t r = 10;
+    for (uint32_t a : args) {
+      x[r++] = a;
+    }
+    x[1] = RETURN_ADDR;
+    x[2] = RAM_BASE + RAM_SIZE;
+    pc = fn;
+    instret = 0;
+    error.clear();
+    while (pc != RETURN_ADDR) {
+      if (instret >= limit) {
+        error = "instruction limit exceeded";
+        break;
+      }
+      if (!step()) {
+        break;
+      }
+      instret++;
+    }
+    return x[10];
+  }
+
+  private:
+  struct Symbol {
+    std::string name;
+    uint32_t addr;
+  };
+
+  std::vector<uint8_t> flash;
+  std::vector<uint8_t> ram;
+  std::vector<Symbol> symbols;
+  uint32_t x[16];
+  uint32_t pc = 0;
+
+  static uint16_t rd16(const std::vector<uint8_t> &b, size_t off) {
+    return off + 2 <= b.size() ? (uint16_t)(b[off] | b[off + 1] << 8) : 0;
+  }
+  static uint32_t rd32(const std::vector<uint8_t> &b, size_t off) {
+    return off + 4 <= b.size() ? (uint32_t)(b[off] | b[off + 1] << 8 | b[off + 2] << 16 | (uint32_t)b[off + 3] << 24) : 0;
+  }
+  static int32_t sext(uint32_t v, int bits) {
+    return (int32_t)(v << (32 - bits)) >> (32 - bits);
+  }
+  static uint32_t bits(uint32_t v, int hi, int lo) {
+    return (v >> lo) & ((1u << (hi - lo + 1)) - 1);
+  }
+  static bool peripheral(uint32_t addr) {
+    return (addr >= 0x40000000 && addr < 0x60000000) || (addr >= 0xE0000000 && addr < RETURN_ADDR);
+  }
+
+  bool fail(const char *what, uint32_t value) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "%s 0x%08x at pc 0x%08x", what, value, pc);
+    error = buf;
+    return false;
+  }
+
+  bool load(uint32_t addr, int size, bool sign, uint32_t &value) {
+    if (peripheral(addr)) {
+      value = 0;
+      return true;
+    }
+    uint8_t *p = at(addr, size);
+    if (!p) {
+      return fail("load outside memory", addr);
+    }
+    value = 0;
+    for (int i = size - 1; i >= 0; --i) {
+      value = value << 8 | p[i];
+    }
+    if (sign && size < 4) {
+      value = (uint32_t)sext(value, size * 8);
+    }
+    return true;
+  }
+
+  bool store(uint32_t addr, int size, uint32_t value) {
+    if (peripheral(addr)) {
+      return true;
+    }
+    uint8_t *p = at(addr, size);
+    if (!p) {
+      return fail("store outside memory", addr);
+    }
+    for (int i = 0; i < size; ++i) {
+      p[i] = (uint8_t)(value >> (8 * i));
+    }
+    return true;
+  }
+
+  bool setReg(uint32_t r, uint32_t value) {
+    if (r >= 16) {
+      return fail("register x16..x31 (not in RV32E)", r);
+    }
+    if (r) {
+      x[r] = value;
+    }
+    return true;
+  }
+
+  bool reg(uint32_t r, uint32_t &value) {
+    if (r >= 16) {
+      return fail("register x16..x31 (not in RV32E)", r);
+    }
+    value = x[r];
+    return true;
+  }
+
+  // Выполнение одной команды
+  bool step() {
+    uint32_t lo;
+    if (!load(pc, 2, false, lo)) {
+      return false;
+    }
+    if ((lo & 3) != 3) {
+      return stepCompressed((uint16_t)lo);
+    }
+    uint32_t ins;
+    if (!load(pc, 4, false, ins)) {
+      return false;
+    }
+    return stepFull(ins);
+  }
+
+  bool stepFull(uint32_t ins) {
+    uint32_t opcode = ins & 0x7F, rd = bits(ins, 11, 7), f3 = bits(ins, 14, 12);
+    uint32_t a = 0, b = 0, next = pc + 4;
+    bool useRs2 = opcode == 0x63 || opcode == 0x23 || opcode == 0x33; // rs2 есть только в B, S, R
+    if (!reg(bits(ins, 19, 15), a) || (useRs2 && !reg(bits(ins, 24, 20), b))) {
+      return false;
+    }
+    int32_t immI = sext(ins >> 20, 12);
+    switch (opcode) {
+    case 0x37: // LUI
+      if (!setReg(rd, ins & 0xFFFFF000)) return false;
+      break;
+    case 0x17: // AUIPC
+      if (!setReg(rd, pc + (ins & 0xFFFFF000))) return false;
+      break;
+    case 0x6F: { // JAL
+      int32_t imm = sext(bits(ins, 31, 31) << 20 | bits(ins, 19, 12) << 12 | bits(ins, 20, 20) << 11 | bits(ins, 30, 21) << 1, 21);
+      if (!setReg(rd, next)) return false;
+      next = pc + imm;
+      break;
+    }
+    case 0x67: // JALR
+      if (!setReg(rd, next)) return false;
+      next = (a + immI) & ~1u;
+      break;
+    case 0x63: { // BRANCH
+      int32_t imm = sext(bits(ins, 31, 31) << 12 | bits(ins, 7, 7) << 11 | bits(ins, 30, 25) << 5 | bits(ins, 11, 8) << 1, 13);
+      bool take;
+      switch (f3) {
+      case 0: take = a == b; break;
+      case 1: take = a != b; break;
+      case 4: take = (int32_t)a < (int32_t)b; break;
+      case 5: take = (int32_t)a >= (int32_t)b; break;
+      case 6: take = a < b; break;
+      case 7: take = a >= b; break;
+      default: return fail("illegal branch", ins);
+      }
+      if (take) {
+        next = pc + imm;
+      }
+      break;
+    }
+    case 0x03: { // LOAD
+      static const int size[8] = {1, 2, 4, 0, 1, 2, 0, 0};
+      if (!size[f3]) return fail("illegal load", ins);
+      uint32_t v;
+      if (!load(a + immI, size[f3], f3 < 4, v) || !setReg(rd, v)) return false;
+      break;
+    }
+    case 0x23: { // STORE
+      int32_t imm = sext(bits(ins, 31, 25) << 5 | bits(ins, 11, 7), 12);
+      if (f3 > 2) return fail("illegal store", ins);
+      if (!store(a + imm, 1 << f3, b)) return false;
+      break;
+    }
+    case 0x13: // OP-IMM
+    case 0x33: { // OP
+      bool imm = opcode == 0x13;
+      uint32_t rhs = imm ? (uint32_t)immI : b;
+      uint32_t f7 = bits(ins, 31, 25);
+      if (!imm && f7 == 1) return fail("M extension (not in RV32EC)", ins);
+      uint32_t v;
+      switch (f3) {
+      case 0: v = (!imm && f7 == 0x20) ? a - rhs : a + rhs; break;
+      case 1: v = a << (rhs & 31); break;
+      case 2: v = (int32_t)a < (int32_t)rhs; break;
+      case 3: v = a < rhs; break;
+      case 4: v = a ^ rhs; break;
+      case 5: v = (f7 & 0x20) ? (uint32_t)((int32_t)a >> (rhs & 31)) : a >> (rhs & 31); break;
+      case 6: v = a | rhs; break;
+      default: v = a & rhs; break;
+      }
+      if (!setReg(rd, v)) return false;
+      break;
+    }
+    case 0x0F: // FENCE
+      break;
+    case 0x73: // SYSTEM: CSR читаются как 0, ECALL/EBREAK - остановка
+      if (f3 == 0) return fail("ecall/ebreak", ins);
+      if (!setReg(rd, 0)) return false;
+      break;
+    default:
+      return fail("illegal instruction", ins);
+    }
+    pc = next;
+    return true;
+  }
+
+  bool stepCompressed(uint16_t c) {
+    uint32_t op = c & 3, f3 = bits(c, 15, 13);
+    uint32_t rdp = 8 + bits(c, 4, 2), rs1p = 8 + bits(c, 9, 7), rd = bits(c, 11, 7), rs2 = bits(c, 6, 2);
+    uint32_t next = pc + 2, v, a, b;
+    int32_t imm6 = sext(bits(c, 12, 12) << 5 | bits(c, 6, 2), 6);
+    int32_t immJ = sext(bits(c, 12, 12) << 11 | bits(c, 11, 11) << 4 | bits(c, 10, 9) << 8 | bits(c, 8, 8) << 10 |
+                            bits(c, 7, 7) << 6 | bits(c, 6, 6) << 7 | bits(c, 5, 3) << 1 | bits(c, 2, 2) << 5, 12);
+    int32_t immB = sext(bits(c, 12, 12) << 8 | bits(c, 11, 10) << 3 | bits(c, 6, 5) << 6 | bits(c, 4, 3) << 1 | bits(c, 2, 2) << 5, 9);
+    uint32_t uimmW = bits(c, 12, 10) << 3 | bits(c, 6, 6) << 2 | bits(c, 5, 5) << 6;
+
+    if (op == 0) {
+      switch (f3) {
+      case 0: { // C.ADDI4SPN
+        uint32_t imm = bits(c, 12, 11) << 4 | bits(c, 10, 7) << 6 | bits(c, 6, 6) << 2 | bits(c, 5, 5) << 3;
+        if (!imm) return fail("illegal instruction", c);
+        if (!setReg(rdp, x[2] + imm)) return false;
+        break;
+      }
+      case 2: // C.LW
+        if (!load(x[rs1p] + uimmW, 4, false, v) || !setReg(rdp, v)) return false;
+        break;
+      case 6: // C.SW
+        if (!store(x[rs1p] + uimmW, 4, x[rdp])) return false;
+        break;
+      default:
+        return fail("illegal compressed instruction", c);
+      }
+    } else if (op == 1) {
+      switch (f3) {
+      case 0: // C.ADDI / C.NOP
+        if (!reg(rd, a) || !setReg(rd, a + imm6)) return false;
+        break;
+      case 1: // C.JAL
+        x[1] = next;
+        next = pc + immJ;
+        break;
+      case 2: // C.LI
+        if (!setReg(rd, (uint32_t)imm6)) return false;
+        break;
+      case 3:
+        if (rd == 2) { // C.ADDI16SP
+          int32_t imm = sext(bits(c, 12, 12) << 9 | bits(c, 6, 6) << 4 | bits(c, 5, 5) << 6 | bits(c, 4, 3) << 7 | bits(c, 2, 2) << 5, 10);
+          x[2] += imm;
+        } else { // C.LUI
+          if (!setReg(rd, (uint32_t)(imm6 << 12))) return false;
+        }
+        break;
+      case 4: { // Арифметика над rd' = rs1'
+        uint32_t f2 = bits(c, 11, 10);
+        a = x[rs1p];
+        if (f2 == 0) {
+          v = a >> (rs2 | bits(c, 12, 12) << 5);
+        } else if (f2 == 1) {
+          v = (uint32_t)((int32_t)a >> (rs2 | bits(c, 12, 12) << 5));
+        } else if (f2 == 2) {
+          v = a & (uint32_t)imm6;
+        } else {
+          b = x[rdp];
+          switch (bits(c, 6, 5)) {
+          case 0: v = a - b; break;
+          case 1: v = a ^ b; break;
+          case 2: v = a | b; break;
+          default: v = a & b; break;
+          }
+        }
+        x[rs1p] = v;
+        break;
+      }
+      case 5: // C.J
+        next = pc + immJ;
+        break;
+      case 6: // C.BEQZ
+        if (x[rs1p] == 0) next = pc + immB;
+        break;
+      default: // C.BNEZ
+        if (x[rs1p] != 0) next = pc + immB;
+        break;
+      }
+    } else if (op == 2) {
+      switch (f3) {
+      case 0: // C.SLLI
+        if (!reg(rd, a) || !setReg(rd, a << (rs2 | bits(c, 12, 12) << 5))) return false;
+        break;
+      case 2: { // C.LWSP
+        uint32_t imm = bits(c, 12, 12) << 5 | bits(c, 6, 4) << 2 | bits(c, 3, 2) << 6;
+        if (!load(x[2] + imm, 4, false, v) || !setReg(rd, v)) return false;
+        break;
+      }
+      case 4:
+        if (!reg(rd, a) || !reg(rs2, b)) return false;
+        if (!bits(c, 12, 12)) {
+          if (rs2 == 0) { // C.JR
+            next = a & ~1u;
+          } else if (!setReg(rd, b)) { // C.MV
+            return false;
+          }
+        } else {
+          if (rs2 == 0 && rd == 0) return fail("ebreak", c);
+          if (rs2 == 0) { // C.JALR
+            x[1] = next;
+            next = a & ~1u;
+          } else if (!setReg(rd, a + b)) { // C.ADD
+            return false;
+          }
+        }
+        break;
+      case 6: { // C.SWSP
+        uint32_t imm = bits(c, 12, 9) << 2 | bits(c, 8, 7) << 6;
+        if (!reg(rs2, b) || !store(x[2] + imm, 4, b)) return false;
+        break;
+      }
+      default:
+        return fail("illegal compressed instruction", c);
+      }
+    } else {
+      return fail("illegal compressed instruction", c);
+    }
+    pc = next;
+    return true;
+  }
+};
+
+#endif // RV_SIM_H
@@ -0,0 +1,259 @@
+#ifndef SETTINGS_IMAGE_H
+#define SETTINGS_IMAGE_H
+
+// Общие функции хостовых утилит для работы с образами области настроек:
+// описание раскладки структуры (layout), CRC16-CCITT, чтение полей.
+//
+// Формат образа совпадает с тем, что пишет SettingsStore::save():
+// - данные структуры с начала области (length байт);
+// - при use_crc последние 2 байта структуры — CRC16-CCITT (little-endian) от остальных байт;
+// - остаток до alignedSize (кратно FLASH_PAGE_SIZE) заполнен 0xFF.
+//
+// Файл раскладки — по одному полю в строке: "<имя> <тип> [значение по умолчанию]",
+// '#' — комментарий. Типы: u8 i8 u16 i16 u32 i32 f32 bytes<N>. Поля идут подряд без
+// выравнивания (packed). Значение bytes<N> — строка или шестнадцатеричные байты "0x0102...".
+
+#include "Crc16Fast.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#ifndef FLASH_PAGE_SIZE
+#define FLASH_PAGE_SIZE 64
+#endif
+
+#ifndef FLASH_END_ADDR
+#define FLASH_END_ADDR 0x08004000U
+#endif
+
+enum FieldType { FT_U8, FT_I8, FT_U16, FT_I16, FT_U32, FT_I32, FT_F32, FT_BYTES };
+
+struct FieldDef {
+  std::string name; // Имя поля
+  FieldType type;   // Тип
+  size_t offset;    // Смещение от начала структуры
+  size_t size;      // Размер, байт
+  std::string def;  // Значение по умолчанию (пусто - нули)
+};
+
+//==============================================================================
+// Выравнивание размера вверх кратно странице flash
+//------------------------------------------------------------------------------
+inline size_t imageAlignedSize(size_t length) {
+  return (length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+}
+
+//==============================================================================
+// Адрес начала области во flash (как SettingsStore::flashStartAddr())
+//------------------------------------------------------------------------------
+inline uint32_t imageStartAddr(size_t length) {
+  return FLASH_END_ADDR - (uint32_t)imageAlignedSize(length);
+}
+
+//==============================================================================
+// CRC16-CCITT (полином 0x1021, начальное значение 0xFFFF), как SettingsStore::crc16()
+//------------------------------------------------------------------------------
+inline uint16_t imageCrc16(const void *data, size_t len) {
+  return crc16Fast(0xFFFF, data, len);
+}
+
+//==============================================================================
+// Разбор типа поля
+//  @return - размер поля или 0, если тип неизвестен
+//------------------------------------------------------------------------------
+inline size_t parseFieldType(const std::string &name, FieldType &type) {
+  static const struct {
+    const char *name;
+    FieldType type;
+    size_t size;
+  } types[] = {{"u8", FT_U8, 1},   {"i8", FT_I8, 1},   {"u16", FT_U16, 2}, {"i16", FT_I16, 2},
+               {"u32", FT_U32, 4}, {"i32", FT_I32, 4}, {"f32", FT_F32, 4}};
+  for (const auto &t : types) {
+    if (name == t.name) {
+      type = t.type;
+      return t.size;
+    }
+  }
+  if (name.compare(0, 5, "bytes") == 0 && name.size() > 5) {
+    type = FT_BYTES;
+    return (size_t)strtoul(name.c_str() + 5, nullptr, 10);
+  }
+  return 0;
+}
+
+//==============================================================================
+// Разбор файла раскладки структуры
+//  @param text   - содержимое файла
+//  @param fields - результат: поля с вычисленными смещениями
+//  @param err    - описание ошибки
+//  @return       - true при успехе
+//------------------------------------------------------------------------------
+inline bool parseLayout(const std::string &text, std::vector<FieldDef> &fields, std::string &err) {
+  size_t offset = 0;
+  int lineNo = 0;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    std::string line = text.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+    pos = eol == std::string::npos ? text.size() : eol + 1;
+    lineNo++;
+    size_t hash = line.find('#');
+    if (hash != std::string::npos) {
+      line.resize(hash);
+    }
+    char name[64], type[32], def[256];
+    int n = sscanf(line.c_str(), "%63s %31s %255s", name, type, def);
+    if (n <= 0) {
+      continue; // Пустая строка
+    }
+    FieldDef f;
+    f.name = name;
+    f.offset = offset;
+    f.size = n >= 2 ? parseFieldType(type, f.type) : 0;
+    if (n == 3) {
+      f.def = def;
+    }
+    if (f.size == 0) {
+      err = "line " + std::to_string(lineNo) + ": bad field '" + line + "'";
+      return false;
+    }
+    offset += f.size;
+    fields.push_back(f);
+  }
+  if (fields.empty()) {
+    err = "empty layout";
+    return false;
+  }
+  return true;
+}
+
+//==============================================================================
+// Чтение файла целиком
+//------------------------------------------------------------------------------
+inline bool readTextFile(const char *path, std::string &text) {
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    text.append(buf, n);
+  }
+  fclose(f);
+  return true;
+}
+
+//==============================================================================
+// Размер структуры по раскладке
+//------------------------------------------------------------------------------
+inline size_t layoutLength(const std::vector<FieldDef> &fields) {
+  return fields.empty() ? 0 : fields.back().offset + fields.back().size;
+}
+
+//==============================================================================
+// Значение числового поля (little-endian) как double; для bytes<N> — 0
+//------------------------------------------------------------------------------
+inline double fieldValue(const FieldDef &f, const uint8_t *data) {
+  const uint8_t *p = data + f.offset;
+  switch (f.type) {
+  case FT_U8: return p[0];
+  case FT_I8: return (int8_t)p[0];
+  case FT_U16: return (uint16_t)(p[0] | p[1] << 8);
+  case FT_I16: return (int16_t)(p[0] | p[1] << 8);
+  case FT_U32: return (uint32_t)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+  case FT_I32: return (int32_t)(p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24);
+  case FT_F32: {
+    float v;
+    memcpy(&v, p, 4);
+    return v;
+  }
+  default: return 0;
+  }
+}
+
+//==============================================================================
+// Запись значения поля (little-endian) в структуру
+//  @param f     - поле
+//  @param value - текстовое значение (число или строка/hex для bytes<N>); пусто - нули
+//  @param data  - начало структуры
+//  @return      - true при успехе
+//------------------------------------------------------------------------------
+inline bool encodeField(const FieldDef &f, const std::string &value, uint8_t *data) {
+  uint8_t *p = data + f.offset;
+  memset(p, 0, f.size);
+  if (value.empty()) {
+    return true;
+  }
+  if (f.type == FT_BYTES) {
+    if (value.size() > 2 && value[0] == '0' && (value[1] == 'x' || value[1] == 'X')) {
+      size_t n = (value.size() - 2) / 2;
+      if (value.size() % 2 != 0 || n > f.size) {
+        return false;
+      }
+      for (size_t i = 0; i < n; ++i) {
+        char byte[3] = {value[2 + 2 * i], value[3 + 2 * i], 0};
+        char *end;
+        p[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != 0) {
+          return false;
+        }
+      }
+      return true;
+    }
+    if (value.size() > f.size) {
+      return false;
+    }
+    memcpy(p, value.data(), value.size());
+    return true;
+  }
+  char *end;
+  uint32_t raw;
+  if (f.type == FT_F32) {
+    float v = strtof(value.c_str(), &end);
+    memcpy(&raw, &v, 4);
+  } else {
+    long long v = strtoll(value.c_str(), &end, 0);
+    long long lo = f.type == FT_I8 ? -128 : f.type == FT_I16 ? -32768 : f.type == FT_I32 ? INT32_MIN : 0;
+    long long hi = f.type == FT_U8    ? 255
+                   : f.type == FT_I8  ? 127
+                   : f.type == FT_U16 ? 65535
+                   : f.type == FT_I16 ? 32767
+                   : f.type == FT_I32 ? INT32_MAX
+                                      : UINT32_MAX;
+    if (v < lo || v > hi) {
+      return false;
+    }
+    raw = (uint32_t)v;
+  }
+  if (*end != 0) {
+    return false;
+  }
+  for (size_t i = 0; i < f.size; ++i) {
+    p[i] = (uint8_t)(raw >> (8 * i));
+  }
+  return true;
+}
+
+//==============================================================================
+// Образ области настроек в точности как после SettingsStore::save():
+// данные, при useCrc - CRC16 в последних 2 байтах структуры, остаток до alignedSize - 0xFF.
+//  @param data   - структура (length байт; при useCrc последние 2 байта перезаписываются)
+//  @param length - размер структуры
+//  @param useCrc - признак использования CRC
+//------------------------------------------------------------------------------
+inline std::vector<uint8_t> buildImage(const uint8_t *data, size_t length, bool useCrc) {
+  std::vector<uint8_t> img(imageAlignedSize(length), 0xFF);
+  memcpy(img.data(), data, length);
+  if (useCrc && length >= 2) {
+    uint16_t crc = imageCrc16(img.data(), length - 2);
+    img[length - 2] = (uint8_t)crc;
+    img[length - 1] = (uint8_t)(crc >> 8);
+  }
+  return img;
+}
+
+#endif // SETTINGS_IMAGE_H
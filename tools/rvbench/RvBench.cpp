@@ -0,0 +1,56 @@
+//============================================================= (c) A.Kolesov ==
+// RvBench.cpp
+// Точки входа для замеров библиотеки под симулятором RvSim (tools/ssrvbench.cpp).
+// Собирается для rv32ec вместе с src/*.cpp и заглушкой ch32v00x.h из этого каталога;
+// строка сборки - в заголовке tools/ssrvbench.cpp.
+//
+// Ядра ss_copy/ss_compare/ss_blank/ss_crc16 вызываются напрямую по своим символам,
+// здесь - только операции, которым нужен объект хранилища или разборщика кадров.
+//------------------------------------------------------------------------------
+#include "SettingsLink.h"
+#include "SettingsStore.h"
+
+uint32_t SystemCoreClock = 48000000; // Для оценки энергии при SETTINGS_STORE_STATS
+
+//==============================================================================
+// Конструктор хранилища: выравнивание размера и расчет адреса области
+//  @return - адрес области во flash
+//------------------------------------------------------------------------------
+extern "C" uint32_t bench_store_init(void *buf, uint32_t len) {
+  SettingsStore store(buf, len, true, false);
+  return store.getAddress();
+}
+
+//==============================================================================
+// Чтение с проверкой CRC
+//  @return - результат load()
+//------------------------------------------------------------------------------
+extern "C" uint32_t bench_load(void *buf, uint32_t len) {
+  SettingsStore store(buf, len, true, false);
+  return store.load();
+}
+
+//==============================================================================
+// Сохранение (стирание и программирование - через заглушку периферии)
+//------------------------------------------------------------------------------
+extern "C" uint32_t bench_save(void *buf, uint32_t len) {
+  SettingsStore store(buf, len, true, false);
+  store.save();
+  return 0;
+}
+
+//==============================================================================
+// Разбор принятых байт кадра SettingsLink
+//  @param frame - байты кадра (0xA5 | cmd | len | данные | CRC)
+//  @param len   - количество байт
+//  @return      - количество принятых кадров с верной CRC
+//------------------------------------------------------------------------------
+extern "C" uint32_t bench_frame(const uint8_t *frame, uint32_t len) {
+  uint8_t buf[LINK_MAX_PAYLOAD];
+  SettingsFrame rx(buf, sizeof(buf));
+  uint32_t frames = 0;
+  for (uint32_t i = 0; i < len; ++i) {
+    frames += rx.feed(frame[i]);
+  }
+  return frames;
+}
@@ -0,0 +1,74 @@
+#ifndef CH32V00X_STUB_H
+#define CH32V00X_STUB_H
+
+// Заглушка ch32v00x.h для сборки библиотеки под симулятор RvSim (tools/ssrvbench.cpp).
+// Адреса периферии как у CH32V003; в симуляторе чтение периферии дает 0 (flash никогда
+// не занята), запись игнорируется. Прерывания и сон - пустые функции.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define __IO volatile
+
+typedef struct {
+  __IO uint32_t ACTLR;
+  __IO uint32_t KEYR;
+  __IO uint32_t OBKEYR;
+  __IO uint32_t STATR;
+  __IO uint32_t CTLR;
+  __IO uint32_t ADDR;
+  __IO uint32_t RESERVED;
+  __IO uint32_t OBR;
+  __IO uint32_t WPR;
+  __IO uint32_t MODEKEYR;
+  __IO uint32_t BOOT_MODEKEYR;
+} FLASH_TypeDef;
+
+typedef struct {
+  __IO uint32_t CTLR;
+  __IO uint32_t SR;
+  __IO uint32_t CNT;
+  uint32_t RESERVED0;
+  __IO uint32_t CMP;
+} SysTick_Type;
+
+typedef struct {
+  __IO uint32_t CFGR;
+  __IO uint32_t CNTR;
+  __IO uint32_t PADDR;
+  __IO uint32_t MADDR;
+} DMA_Channel_TypeDef;
+
+typedef struct {
+  __IO uint32_t INTFR;
+  __IO uint32_t INTFCR;
+} DMA_TypeDef;
+
+typedef struct {
+  __IO uint32_t CTLR;
+  __IO uint32_t CFGR0;
+  __IO uint32_t INTR;
+  __IO uint32_t APB2PRSTR;
+  __IO uint32_t APB1PRSTR;
+  __IO uint32_t AHBPCENR;
+  __IO uint32_t APB2PCENR;
+  __IO uint32_t APB1PCENR;
+} RCC_TypeDef;
+
+#define FLASH ((FLASH_TypeDef *)0x40022000)
+#define SysTick ((SysTick_Type *)0xE000F000)
+#define DMA1 ((DMA_TypeDef *)0x40020000)
+#define DMA1_Channel1 ((DMA_Channel_TypeDef *)0x40020008)
+#define RCC ((RCC_TypeDef *)0x40021000)
+
+typedef enum { FLASH_IRQn = 20 } IRQn_Type;
+
+static inline void NVIC_EnableIRQ(IRQn_Type) {}
+static inline void NVIC_DisableIRQ(IRQn_Type) {}
+static inline void __WFI(void) {}
+static inline void __disable_irq(void) {}
+static inline void __enable_irq(void) {}
+
+extern uint32_t SystemCoreClock;
+
+#endif // CH32V00X_STUB_H
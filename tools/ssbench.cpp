@@ -0,0 +1,488 @@
+//============================================================= (c) A.Kolesov ==
+// ssbench.cpp
+// Хостовые замеры производительности SettingsStore (Linux).
+//
+// Сборка:
+//   g++ -O2 -std=c++17 -pthread -DSETTINGS_STORE_HOST -Isrc -Itools tools/ssbench.cpp src/*.cpp -o ssbench
+//
+// Использование:
+//   ssbench host-save [size] [count] [dir]  - сохранение через mmap+msync против fwrite+fsync
+//   ssbench rcu-read [threads] [seconds]    - масштабирование чтения снимков по потокам
+//   ssbench crc [size_mb]                   - пропускная способность вариантов CRC16, ГБ/с
+//   ssbench delta-sync [size]               - трафик и записанные страницы: полная запись против
+//                                             синхронизации по CRC страниц (SettingsLink)
+//   ssbench kv-bloom [pages] [lookups]      - задержка поиска в FlashKv с фильтрами Блума и без
+//   ssbench boot [limit_us] [crc_cpb]       - модель времени load() на CH32V003 по режимам и размерам
+//                                             (с -DSETTINGS_STORE_PROFILE - и замер фаз на хосте)
+//------------------------------------------------------------------------------
+#include "Crc16Fast.h"
+#include "FlashKv.h"
+#include "LinkClient.h"
+#include "SettingsSnapshot.h"
+#include "SettingsStore.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+static double secondsSince(Clock::time_point t0) {
+  return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+//==============================================================================
+// Подсказка по командам
+//  @return - код возврата 2
+//------------------------------------------------------------------------------
+static int usage() {
+  fprintf(stderr, "usage: ssbench host-save [size >= 3] [count] [dir]\n"
+                  "       ssbench rcu-read [threads] [seconds]\n"
+                  "       ssbench crc [size_mb]\n"
+                  "       ssbench delta-sync [size >= 64]\n"
+                  "       ssbench kv-bloom [pages] [lookups]\n"
+                  "       ssbench boot [limit_us] [crc_cpb]\n");
+  return 2;
+}
+
+//==============================================================================
+// Сохранение: SettingsStore на файле через mmap с msync измененных страниц
+// против "наивной" записи всего образа через fwrite + fflush + fsync.
+//------------------------------------------------------------------------------
+static int benchHostSave(int argc, char **argv) {
+  size_t size = argc > 0 ? strtoul(argv[0], nullptr, 0) : 1024;
+  int count = argc > 1 ? atoi(argv[1]) : 200;
+  std::string dir = argc > 2 ? argv[2] : ".";
+  if (size < 3 || count < 0) {
+    return usage(); // Меняется байт из первых size - 2 (последние 2 - CRC)
+  }
+  size_t aligned = (size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  std::vector<uint8_t> buf(size, 0);
+
+  std::string mmapPath = dir + "/ssbench_mmap.img";
+  std::string fwritePath = dir + "/ssbench_fwrite.img";
+  unlink(mmapPath.c_str());
+  unlink(fwritePath.c_str());
+
+  // SettingsStore на mmap
+  if (!SettingsFlash::hostOpen(mmapPath.c_str(), aligned, false)) {
+    fprintf(stderr, "cannot map %s\n", mmapPath.c_str());
+    return 1;
+  }
+  SettingsStore store(buf.data(), size, true, false);
+  Clock::time_point t0 = Clock::now();
+  for (int i = 0; i < count; ++i) {
+    buf[i % (size - 2)]++;
+    store.save();
+  }
+  double tMmap = secondsSince(t0);
+  SettingsFlash::hostClose();
+
+  // Наивная реализация: весь образ через stdio, затем fsync
+  std::vector<uint8_t> image(aligned, 0xFF);
+  FILE *f = fopen(fwritePath.c_str(), "w+b");
+  if (f == nullptr) {
+    fprintf(stderr, "cannot open %s\n", fwritePath.c_str());
+    return 1;
+  }
+  double tSync = 0;
+  t0 = Clock::now();
+  for (int i = 0; i < count; ++i) {
+    image[i % (size - 2)]++;
+    fseek(f, 0, SEEK_SET);
+    fwrite(image.data(), 1, image.size(), f);
+    fflush(f);
+    Clock::time_point ts = Clock::now();
+    fsync(fileno(f));
+    tSync += secondsSince(ts);
+  }
+  double tFwrite = secondsSince(t0);
+  fclose(f);
+
+  printf("size %zu (aligned %zu), %d saves\n", size, aligned, count);
+  printf("  mmap+msync:   %8.1f us/save, %8.1f saves/s\n", tMmap / count * 1e6, count / tMmap);
+  printf("  fwrite+fsync: %8.1f us/save, %8.1f saves/s (fsync %.1f us/save)\n", tFwrite / count * 1e6,
+         count / tFwrite, tSync / count * 1e6);
+  unlink(mmapPath.c_str());
+  unlink(fwritePath.c_str());
+  return 0;
+}
+
+//==============================================================================
+// Чтение снимков SettingsSnapshot из 1..threads потоков при работающем писателе.
+// Выводит суммарное количество чтений в секунду для каждого числа потоков.
+//------------------------------------------------------------------------------
+struct __attribute__((packed)) BenchConfig {
+  uint32_t values[16];
+  uint16_t crc;
+};
+
+static int benchRcuRead(int argc, char **argv) {
+  unsigned maxThreads = argc > 0 ? (unsigned)atoi(argv[0]) : std::thread::hardware_concurrency();
+  double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+  if (maxThreads == 0) {
+    maxThreads = 1;
+  }
+  unlink("ssbench_rcu.img");
+  if (!SettingsFlash::hostOpen("ssbench_rcu.img", 128, true)) {
+    fprintf(stderr, "cannot map ssbench_rcu.img\n");
+    return 1;
+  }
+  BenchConfig cfg = {};
+  SettingsStore store(&cfg, sizeof(cfg), true, true);
+  SettingsSnapshot<BenchConfig> snap(store, cfg);
+
+  for (unsigned n = 1; n <= maxThreads; n *= 2) {
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::vector<std::thread> readers;
+    for (unsigned t = 0; t < n; ++t) {
+      readers.emplace_back([&] {
+        uint64_t local = 0;
+        volatile uint32_t sink = 0;
+        while (!stop.load(std::memory_order_relaxed)) {
+          auto r = snap.read();
+          sink += r->values[local & 15];
+          local++;
+        }
+        reads += local;
+      });
+    }
+    std::thread writer([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        cfg.values[0]++;
+        snap.save();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    stop = true;
+    for (std::thread &t : readers) {
+      t.join();
+    }
+    writer.join();
+    printf("%3u readers: %8.2f Mreads/s\n", n, reads.load() / seconds / 1e6);
+  }
+  SettingsFlash::hostClose();
+  unlink("ssbench_rcu.img");
+  return 0;
+}
+
+//==============================================================================
+// Пропускная способность вариантов CRC16-CCITT из Crc16Fast.h
+//------------------------------------------------------------------------------
+static int benchCrc(int argc, char **argv) {
+  size_t size = (size_t)(argc > 0 ? atof(argv[0]) : 64) * 1024 * 1024;
+  std::vector<uint8_t> buf(size);
+  for (size_t i = 0; i < size; ++i) {
+    buf[i] = (uint8_t)(i * 2654435761u >> 24);
+  }
+  struct {
+    const char *name;
+    uint16_t (*fn)(uint16_t, const void *, size_t);
+    size_t size; // Побитовый вариант медленный - гоняем на части буфера
+  } variants[] = {
+      {"bitwise", crc16Bitwise, size / 16},
+      {"slice8", crc16Slice8, size},
+#ifdef CRC16_HAVE_CLMUL
+      {"clmul", crc16Clmul, size},
+#endif
+      {"fast", crc16Fast, size},
+  };
+  uint16_t expected = crc16Slice8(0xFFFF, buf.data(), size / 16);
+  for (const auto &v : variants) {
+    uint16_t check = v.fn(0xFFFF, buf.data(), size / 16);
+    Clock::time_point t0 = Clock::now();
+    uint16_t crc = v.fn(0xFFFF, buf.data(), v.size);
+    double t = secondsSince(t0);
+    printf("%-8s %8.2f GB/s  crc=%04X %s\n", v.name, v.size / t / 1e9, crc, check == expected ? "" : "MISMATCH");
+  }
+  return 0;
+}
+
+//==============================================================================
+// Синхронизация по CRC страниц: устройство (SettingsLink над хост-бэкендом) и хост
+// (LinkClient) соединены каналом в памяти. Для типичных правок сравниваются переданные
+// байты и записанные страницы при полной записи образа и при передаче только разницы.
+//------------------------------------------------------------------------------
+static std::deque<uint8_t> toNode, toHost; // Канал в памяти
+static SettingsLink *benchNode = nullptr;  // Устройство, обрабатывает запросы при чтении хостом
+
+static void nodePut(uint8_t b) {
+  toHost.push_back(b);
+}
+
+static int nodeGet() {
+  if (toNode.empty()) {
+    return -1;
+  }
+  int b = toNode.front();
+  toNode.pop_front();
+  return b;
+}
+
+static int benchDeltaSync(int argc, char **argv) {
+  size_t size = argc > 0 ? strtoul(argv[0], nullptr, 0) : 1024;
+  if (size < 64) {
+    return usage(); // Правки ниже меняют поля до size - 40 и середину образа
+  }
+  size_t aligned = (size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  unlink("ssbench_sync.img");
+  if (!SettingsFlash::hostOpen("ssbench_sync.img", aligned, false)) {
+    fprintf(stderr, "cannot map ssbench_sync.img\n");
+    return 1;
+  }
+  std::vector<uint8_t> buf(size, 0);
+  SettingsStore store(buf.data(), size, true, true);
+  SettingsLink node(store, nodePut, nodeGet);
+  benchNode = &node;
+  LinkClient host([](const uint8_t *d, size_t n) { toNode.insert(toNode.end(), d, d + n); },
+                  [](int) {
+                    if (toHost.empty()) {
+                      benchNode->poll();
+                    }
+                    if (toHost.empty()) {
+                      return -1;
+                    }
+                    int b = toHost.front();
+                    toHost.pop_front();
+                    return b;
+                  });
+
+  // Исходная конфигурация на устройстве
+  for (size_t i = 0; i < size; ++i) {
+    buf[i] = (uint8_t)(i * 7);
+  }
+  store.save();
+
+  struct Edit {
+    const char *name;
+    std::vector<std::pair<size_t, size_t>> ranges; // Измененные байты: смещение, длина
+  } edits[] = {
+      {"one field", {{10, 2}}},
+      {"three fields", {{10, 2}, {size / 2, 4}, {size - 40, 1}}},
+      {"string", {{size / 3, 16}}},
+      {"everything", {{0, size - 2}}},
+  };
+  printf("image %zu bytes, %zu pages\n", size, aligned / FLASH_PAGE_SIZE);
+  printf("%-14s %22s %22s\n", "edit", "full: bytes / pages", "delta: bytes / pages");
+  for (const Edit &e : edits) {
+    // Новый образ - как после save() с измененными полями
+    std::vector<uint8_t> next(buf);
+    for (const auto &r : e.ranges) {
+      for (size_t i = r.first; i < r.first + r.second && i < size - 2; ++i) {
+        next[i] ^= 0x5A;
+      }
+    }
+    uint16_t crc = SettingsStore::crc16Update(0xFFFF, next.data(), size - 2);
+    memcpy(&next[size - 2], &crc, 2);
+    std::vector<uint8_t> img(aligned, 0xFF);
+    memcpy(img.data(), next.data(), size);
+
+    uint64_t stat[2][2];
+    for (int delta = 0; delta < 2; ++delta) {
+      for (size_t i = 0; i < size; ++i) { // Откат к исходному образу
+        buf[i] = (uint8_t)(i * 7);
+      }
+      store.save();
+      host.bytesSent = host.bytesReceived = 0;
+      host.pagesWritten = 0;
+      if (!host.writeImage(img, delta != 0) || memcmp(SettingsFlash::ptr(store.getAddress()), img.data(), aligned)) {
+        fprintf(stderr, "%s: sync failed\n", e.name);
+        return 1;
+      }
+      stat[delta][0] = host.bytesSent + host.bytesReceived;
+      stat[delta][1] = host.pagesWritten;
+    }
+    printf("%-14s %14llu / %5llu %14llu / %5llu\n", e.name, (unsigned long long)stat[0][0],
+           (unsigned long long)stat[0][1], (unsigned long long)stat[1][0], (unsigned long long)stat[1][1]);
+  }
+  SettingsFlash::hostClose();
+  unlink("ssbench_sync.img");
+  return 0;
+}
+
+//==============================================================================
+// Поиск в FlashKv с фильтрами Блума страниц и без них: журнал из pages страниц
+// заполняется разными ключами, затем ищутся отсутствующие и имеющиеся ключи.
+//------------------------------------------------------------------------------
+static int benchKvBloom(int argc, char **argv) {
+  uint16_t pages = (uint16_t)(argc > 0 ? atoi(argv[0]) : 128);
+  int lookups = argc > 1 ? atoi(argv[1]) : 100000;
+  unlink("ssbench_kv.img");
+  if (pages < 3 || !SettingsFlash::hostOpen("ssbench_kv.img", (size_t)pages * FLASH_PAGE_SIZE, false)) {
+    fprintf(stderr, "cannot map ssbench_kv.img\n");
+    return 1;
+  }
+  uint32_t start = FLASH_END_ADDR - (uint32_t)pages * FLASH_PAGE_SIZE;
+  FlashKv kv(start, pages);
+  kv.open();
+  // Записи по 4 байта значения: (pages - 2) страниц без переноса старых записей
+  uint16_t keys = (uint16_t)((pages - 2) * ((FLASH_PAGE_SIZE - FKV_HEADER) / (FKV_RECORD_HEADER + 4)));
+  for (uint16_t k = 0; k < keys; ++k) {
+    uint32_t value = k * 2654435761u;
+    kv.set(k, &value, sizeof(value));
+  }
+  printf("%u pages, %u keys, %d lookups\n", pages, keys, lookups);
+  printf("%-8s %-8s %12s %14s\n", "filter", "keys", "ns/lookup", "pages scanned");
+  for (int bloom = 1; bloom >= 0; --bloom) {
+    FlashKv reader(start, pages, bloom != 0);
+    reader.open();
+    for (int present = 0; present < 2; ++present) {
+      reader.pagesScanned = 0;
+      uint32_t found = 0;
+      Clock::time_point t0 = Clock::now();
+      for (int i = 0; i < lookups; ++i) {
+        uint16_t key = present ? (uint16_t)(i * 7919u % keys) : (uint16_t)(keys + i % (0xFFFE - keys));
+        found += reader.find(key) != nullptr;
+      }
+      double t = secondsSince(t0);
+      if (found != (present ? (uint32_t)lookups : 0)) {
+        fprintf(stderr, "lookup mismatch\n");
+        return 1;
+      }
+      printf("%-8s %-8s %12.1f %14.2f\n", bloom ? "bloom" : "none", present ? "present" : "missing", t / lookups * 1e9,
+             (double)reader.pagesScanned / lookups);
+    }
+  }
+  SettingsFlash::hostClose();
+  unlink("ssbench_kv.img");
+  return 0;
+}
+
+//==============================================================================
+// Модель времени загрузки настроек при старте: для каждого режима и размера - такты
+// фаз load() на CH32V003 по числу обрабатываемых байт, время в мкс при SystemCoreClock
+// и сравнение с пределом. Если ssbench собран с -DSETTINGS_STORE_PROFILE, рядом - фазы,
+// измеренные профилем load() на хосте.
+// - crc+dma - load() с SETTINGS_STORE_DMA: от BOOT_DMA_THRESHOLD байт копирует DMA, а CRC
+//   считается параллельно, фаза копирования - max(DMA, CRC);
+// - lazy - SETTINGS_MODE_LAZY: при старте только метка и корень дерева, а проверка и
+//   копирование каждой страницы переносятся на первое обращение (столбец "page us").
+//------------------------------------------------------------------------------
+#define BOOT_COPY_CPB 1.0  // Тактов на байт копирования (ss_copy: ~0.7 команды на байт + ожидание flash)
+#define BOOT_CRC_CPB 48.0  // Тактов на байт CRC16 на C (ассемблерное ядро - ~19, см. ssrvbench)
+#define BOOT_OVERHEAD 200  // Постоянная часть load(), тактов
+#define BOOT_DMA_CPB 1.25      // Тактов на байт копирования DMA (слово за ~5 тактов с ожиданием flash)
+#define BOOT_DMA_SETUP 60      // Настройка канала DMA, тактов
+#define BOOT_DMA_THRESHOLD 256 // Как SS_DMA_THRESHOLD: меньше - копирует ядро
+
+static int benchBoot(int argc, char **argv) {
+  double limitUs = argc > 0 ? atof(argv[0]) : 200;
+  double crcCpb = argc > 1 ? atof(argv[1]) : BOOT_CRC_CPB;
+  const size_t sizes[] = {64, 256, 1024, 2048};
+  struct {
+    const char *name;
+    bool useCrc;
+    uint8_t mode;
+    bool dma; // Модель load() с SETTINGS_STORE_DMA
+  } modes[] = {{"raw", false, 0, false},
+               {"crc", true, 0, false},
+               {"crc+dma", true, 0, true},
+               {"crc+tree", true, SETTINGS_MODE_HASH_TREE, false},
+               {"lazy", true, SETTINGS_MODE_LAZY, false}};
+  double mhz = SystemCoreClock / 1e6;
+
+  printf("CH32V003 model at %.0f MHz: copy %.1f, crc %.1f cycles/byte; limit %.0f us\n", mhz, BOOT_COPY_CPB, crcCpb,
+         limitUs);
+  printf("%6s %-9s %9s %9s %9s %10s %8s", "size", "mode", "check us", "copy us", "crc us", "total us", "page us");
+#ifdef SETTINGS_STORE_PROFILE
+  printf(" %24s", "host: check/copy/crc ns");
+#endif
+  printf("\n");
+  for (size_t size : sizes) {
+    size_t aligned = (size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+    for (const auto &m : modes) {
+      unlink("ssbench_boot.img");
+      if (!SettingsFlash::hostOpen("ssbench_boot.img", aligned * 2 + FLASH_PAGE_SIZE * 2, false)) {
+        fprintf(stderr, "cannot map ssbench_boot.img\n");
+        return 1;
+      }
+      std::vector<uint8_t> buf(size);
+      for (size_t i = 0; i < size; ++i) {
+        buf[i] = (uint8_t)(i * 13);
+      }
+      SettingsStore store(buf.data(), size, m.useCrc, false, m.mode);
+      store.save();
+      if (!store.load()) {
+        fprintf(stderr, "%zu %s: load failed\n", size, m.name);
+        return 1;
+      }
+
+      // Модель: байты каждой фазы на такты на байт
+      size_t pages = aligned / FLASH_PAGE_SIZE, leaves = 1;
+      while (leaves < pages) {
+        leaves <<= 1;
+      }
+      double check = (m.mode & SETTINGS_MODE_HASH_TREE) ? (aligned + 4 * (leaves - 1)) * crcCpb : 0;
+      double copy = size * BOOT_COPY_CPB;
+      double crc = m.useCrc ? (size - 2) * crcCpb : 0;
+      double page = 0; // Ленивый режим: первое обращение к странице
+      if (m.dma && size >= BOOT_DMA_THRESHOLD) { // CRC считается, пока DMA копирует
+        copy = BOOT_DMA_SETUP + (size * BOOT_DMA_CPB > crc ? size * BOOT_DMA_CPB : crc);
+        crc = 0;
+      }
+      if (m.mode & SETTINGS_MODE_LAZY) { // Метка и корень; CRC всей структуры не считается
+        double depth = 0;
+        for (size_t l = leaves; l > 1; l >>= 1) {
+          depth++;
+        }
+        check = 4 * crcCpb;
+        copy = 0;
+        crc = 0;
+        page = (FLASH_PAGE_SIZE * (crcCpb + BOOT_COPY_CPB) + depth * 4 * crcCpb) / mhz;
+      }
+      double total = (check + copy + crc + BOOT_OVERHEAD) / mhz;
+      printf("%6zu %-9s %9.1f %9.1f %9.1f %10.1f", size, m.name, check / mhz, copy / mhz, crc / mhz, total);
+      if (page > 0) {
+        printf(" %8.1f", page);
+      } else {
+        printf(" %8s", "-");
+      }
+#ifdef SETTINGS_STORE_PROFILE
+      const int runs = 1000;
+      double phase[3] = {0, 0, 0};
+      for (int r = 0; r < runs; ++r) {
+        store.load();
+        const SettingsLoadProfile &p = store.getLoadProfile();
+        phase[0] += p.check;
+        phase[1] += p.copy;
+        phase[2] += p.crc;
+      }
+      printf(" %8.0f/%7.0f/%7.0f", phase[0] / runs / mhz * 1000, phase[1] / runs / mhz * 1000,
+             phase[2] / runs / mhz * 1000);
+#endif
+      printf("%s\n", total > limitUs ? "  OVER LIMIT" : "");
+      SettingsFlash::hostClose();
+    }
+  }
+  unlink("ssbench_boot.img");
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  std::string cmd = argc > 1 ? argv[1] : "";
+  if (cmd == "host-save") {
+    return benchHostSave(argc - 2, argv + 2);
+  }
+  if (cmd == "rcu-read") {
+    return benchRcuRead(argc - 2, argv + 2);
+  }
+  if (cmd == "crc") {
+    return benchCrc(argc - 2, argv + 2);
+  }
+  if (cmd == "delta-sync") {
+    return benchDeltaSync(argc - 2, argv + 2);
+  }
+  if (cmd == "kv-bloom") {
+    return benchKvBloom(argc - 2, argv + 2);
+  }
+  if (cmd == "boot") {
+    return benchBoot(argc - 2, argv + 2);
+  }
+  return usage();
+}
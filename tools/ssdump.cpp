@@ -0,0 +1,288 @@
+//============================================================= (c) A.Kolesov ==
+// ssdump.cpp
+// Анализ дампов flash с большого количества устройств (возвраты, полевые отказы).
+//
+// Из каждого дампа берутся последние alignedSize байт — область, которую занимает
+// SettingsStore (от FLASH_END_ADDR вниз). Поэтому на вход подходит как полный дамп flash,
+// так и дамп только области настроек. Файлы обрабатываются параллельно
+// (пул потоков с work-stealing), читаются через mmap.
+//
+// Сборка:
+//   g++ -O2 -std=c++17 -pthread tools/ssdump.cpp -o ssdump
+//
+// Использование:
+//   ssdump (--length N | --layout FILE) [--crc] [--threads T] [--top K] dump... | @list.txt
+//     --length N   размер структуры настроек, байт
+//     --layout F   раскладка структуры (см. SettingsImage.h), задает и размер
+//     --crc        последние 2 байта структуры - CRC16 (use_crc в SettingsStore)
+//     --threads T  количество потоков (по умолчанию - по числу ядер)
+//     --top K      сколько самых частых значений каждого поля выводить (по умолчанию 5)
+//     @list.txt    файл со списком дампов, по одному пути в строке
+//------------------------------------------------------------------------------
+#include "ParallelFor.h"
+#include "SettingsImage.h"
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_DISTINCT 4096 // Больше разных значений поля не запоминаем
+
+// Статистика по одному полю
+struct FieldStats {
+  uint64_t count = 0;
+  double min = 0, max = 0, sum = 0;
+  std::map<double, uint64_t> values; // Распределение значений
+  bool overflow = false;             // Разных значений больше MAX_DISTINCT
+
+  void add(double v) {
+    if (count == 0 || v < min) {
+      min = v;
+    }
+    if (count == 0 || v > max) {
+      max = v;
+    }
+    count++;
+    sum += v;
+    auto it = values.find(v);
+    if (it != values.end()) {
+      it->second++;
+    } else if (values.size() < MAX_DISTINCT) {
+      values[v] = 1;
+    } else {
+      overflow = true;
+    }
+  }
+
+  void merge(const FieldStats &o) {
+    if (o.count == 0) {
+      return;
+    }
+    min = count == 0 ? o.min : std::min(min, o.min);
+    max = count == 0 ? o.max : std::max(max, o.max);
+    count += o.count;
+    sum += o.sum;
+    overflow |= o.overflow;
+    for (const auto &v : o.values) {
+      auto it = values.find(v.first);
+      if (it != values.end()) {
+        it->second += v.second;
+      } else if (values.size() < MAX_DISTINCT) {
+        values[v.first] = v.second;
+      } else {
+        overflow = true;
+      }
+    }
+  }
+};
+
+// Статистика потока (сливается в общую в конце)
+struct DumpStats {
+  uint64_t images = 0;     // Обработано дампов
+  uint64_t unreadable = 0; // Не удалось прочитать или дамп меньше области
+  uint64_t blank = 0;      // Область стерта (только 0xFF) - настройки не сохранялись
+  uint64_t crcOk = 0;      // CRC совпала
+  uint64_t crcBad = 0;     // CRC не совпала
+  uint64_t padBad = 0;     // В заполнителе после данных не 0xFF
+  std::vector<FieldStats> fields;
+
+  void merge(const DumpStats &o) {
+    images += o.images;
+    unreadable += o.unreadable;
+    blank += o.blank;
+    crcOk += o.crcOk;
+    crcBad += o.crcBad;
+    padBad += o.padBad;
+    for (size_t i = 0; i < fields.size(); ++i) {
+      fields[i].merge(o.fields[i]);
+    }
+  }
+};
+
+//==============================================================================
+// Разбор одного образа области настроек
+//  @param img    - начало области (alignedSize байт)
+//  @param length - размер структуры
+//------------------------------------------------------------------------------
+static void analyzeImage(const uint8_t *img, size_t length, bool useCrc, const std::vector<FieldDef> &layout,
+                         DumpStats &st) {
+  size_t aligned = imageAlignedSize(length);
+  st.images++;
+
+  bool blank = true;
+  for (size_t i = 0; i < aligned && blank; ++i) {
+    blank = img[i] == 0xFF;
+  }
+  if (blank) {
+    st.blank++;
+    return;
+  }
+
+  // Старые версии библиотеки дописывали до 3 байт из RAM после структуры до целого слова,
+  // поэтому заполнитель проверяем с границы слова.
+  for (size_t i = (length + 3) & ~(size_t)3; i < aligned; ++i) {
+    if (img[i] != 0xFF) {
+      st.padBad++;
+      break;
+    }
+  }
+
+  if (useCrc) {
+    uint16_t stored = (uint16_t)(img[length - 2] | img[length - 1] << 8);
+    if (stored != imageCrc16(img, length - 2)) {
+      st.crcBad++;
+      return; // Значения полей из поврежденного образа не учитываем
+    }
+    st.crcOk++;
+  }
+  for (size_t i = 0; i < layout.size(); ++i) {
+    if (layout[i].type != FT_BYTES) {
+      st.fields[i].add(fieldValue(layout[i], img));
+    }
+  }
+}
+
+//==============================================================================
+// Отображение дампа в память и разбор его последних alignedSize байт
+//------------------------------------------------------------------------------
+static void analyzeFile(const std::string &path, size_t length, bool useCrc, const std::vector<FieldDef> &layout,
+                        DumpStats &st) {
+  size_t aligned = imageAlignedSize(length);
+  int fd = open(path.c_str(), O_RDONLY);
+  struct stat sb;
+  if (fd < 0 || fstat(fd, &sb) != 0 || (size_t)sb.st_size < aligned) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    st.images++;
+    st.unreadable++;
+    return;
+  }
+  void *map = mmap(nullptr, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    st.images++;
+    st.unreadable++;
+    return;
+  }
+  analyzeImage((const uint8_t *)map + sb.st_size - aligned, length, useCrc, layout, st);
+  munmap(map, (size_t)sb.st_size);
+}
+
+static double percent(uint64_t part, uint64_t total) {
+  return total ? 100.0 * (double)part / (double)total : 0.0;
+}
+
+static void printReport(const DumpStats &st, const std::vector<FieldDef> &layout, bool useCrc, unsigned top,
+                        double seconds) {
+  printf("images:     %llu (%.2f s, %.0f images/s)\n", (unsigned long long)st.images, seconds,
+         seconds > 0 ? st.images / seconds : 0.0);
+  printf("unreadable: %llu (%.2f%%)\n", (unsigned long long)st.unreadable, percent(st.unreadable, st.images));
+  printf("blank:      %llu (%.2f%%)\n", (unsigned long long)st.blank, percent(st.blank, st.images));
+  if (useCrc) {
+    uint64_t checked = st.crcOk + st.crcBad;
+    printf("crc ok:     %llu\n", (unsigned long long)st.crcOk);
+    printf("crc bad:    %llu (%.2f%% of written)\n", (unsigned long long)st.crcBad, percent(st.crcBad, checked));
+  }
+  printf("bad pad:    %llu (non-0xFF bytes after data)\n", (unsigned long long)st.padBad);
+  printf("erase counts: not recorded in this image format\n");
+
+  for (size_t i = 0; i < layout.size(); ++i) {
+    const FieldStats &f = st.fields[i];
+    if (layout[i].type == FT_BYTES || f.count == 0) {
+      continue;
+    }
+    printf("\n%s @%zu: n=%llu min=%g max=%g mean=%g distinct=%zu%s\n", layout[i].name.c_str(), layout[i].offset,
+           (unsigned long long)f.count, f.min, f.max, f.sum / (double)f.count, f.values.size(),
+           f.overflow ? "+" : "");
+    std::vector<std::pair<uint64_t, double>> byCount;
+    for (const auto &v : f.values) {
+      byCount.push_back({v.second, v.first});
+    }
+    std::sort(byCount.begin(), byCount.end(), [](const auto &a, const auto &b) { return a.first > b.first; });
+    for (size_t k = 0; k < byCount.size() && k < top; ++k) {
+      printf("  %12g  %10llu  %6.2f%%\n", byCount[k].second, (unsigned long long)byCount[k].first,
+             percent(byCount[k].first, f.count));
+    }
+  }
+}
+
+static int usage() {
+  fprintf(stderr, "usage: ssdump (--length N | --layout FILE) [--crc] [--threads T] [--top K] dump... | @list\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  size_t length = 0;
+  bool useCrc = false;
+  unsigned threads = 0, top = 5;
+  std::vector<FieldDef> layout;
+  std::vector<std::string> files;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    if (a == "--length" && i + 1 < argc) {
+      length = strtoul(argv[++i], nullptr, 0);
+    } else if (a == "--layout" && i + 1 < argc) {
+      std::string text, err;
+      if (!readTextFile(argv[++i], text) || !parseLayout(text, layout, err)) {
+        fprintf(stderr, "%s: %s\n", argv[i], err.empty() ? "cannot read" : err.c_str());
+        return 1;
+      }
+      length = layoutLength(layout);
+    } else if (a == "--crc") {
+      useCrc = true;
+    } else if (a == "--threads" && i + 1 < argc) {
+      threads = (unsigned)atoi(argv[++i]);
+    } else if (a == "--top" && i + 1 < argc) {
+      top = (unsigned)atoi(argv[++i]);
+    } else if (a[0] == '@') {
+      std::string text;
+      if (!readTextFile(a.c_str() + 1, text)) {
+        fprintf(stderr, "%s: cannot read\n", a.c_str() + 1);
+        return 1;
+      }
+      size_t pos = 0;
+      while (pos < text.size()) {
+        size_t eol = text.find('\n', pos);
+        std::string line = text.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+        pos = eol == std::string::npos ? text.size() : eol + 1;
+        if (!line.empty()) {
+          files.push_back(line);
+        }
+      }
+    } else if (a[0] == '-') {
+      return usage();
+    } else {
+      files.push_back(a);
+    }
+  }
+  if (length == 0 || (useCrc && length < 2) || files.empty()) {
+    return usage();
+  }
+
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+  std::vector<DumpStats> perThread(threads);
+  for (DumpStats &st : perThread) {
+    st.fields.resize(layout.size());
+  }
+
+  auto t0 = std::chrono::steady_clock::now();
+  parallelFor(files.size(), threads,
+              [&](size_t i, unsigned worker) { analyzeFile(files[i], length, useCrc, layout, perThread[worker]); });
+  for (unsigned t = 1; t < threads; ++t) {
+    perThread[0].merge(perThread[t]);
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  printReport(perThread[0], layout, useCrc, top, seconds);
+  return 0;
+}
@@ -0,0 +1,718 @@
+//============================================================= (c) A.Kolesov ==
+// ssgen.cpp
+// Генератор кода настроек по схеме: одна схема для прошивки, заводской утилиты и шлюза.
+//
+// Из файла схемы генерируются:
+//   <Name>.h       - packed-структура для SettingsStore с значениями по умолчанию
+//                    (constexpr), типизированными get/set, хешем схемы и размерами;
+//   <Name>Codec.h  - хостовый кодировщик/декодер образа области настроек (явный little-endian,
+//                    не зависит от порядка байт и упаковки структур на хосте);
+//   <Name>.layout  - раскладка для ssdump/ssprov.
+//
+// Для минимального размера (и числа страниц flash) поля bool и uN (N < 32) упаковываются
+// в общий битовый массив, остальные поля упорядочиваются по убыванию размера, чтобы
+// многобайтные поля по возможности попадали на естественное выравнивание.
+// CRC всегда последняя (так требует SettingsStore).
+//
+// Сборка:
+//   g++ -O2 -std=c++17 tools/ssgen.cpp -o ssgen
+//
+// Использование:
+//   ssgen SCHEMA [--out DIR] [--check]
+//     --check  не записывать файлы, а сравнить с существующими (эталонными);
+//              код возврата 1, если сгенерированное отличается
+//
+// Формат схемы (по одной директиве в строке, '#' - комментарий):
+//   struct <Name>                 имя структуры
+//   hash                          первым полем хранить хеш схемы (uint32_t schemaHash)
+//   crc                           последними 2 байтами хранить CRC16 (use_crc в SettingsStore)
+//   <name> <type> [default]       поле; типы: u8 i8 u16 i16 u32 i32 f32 bool u1..u31 bytes<N>
+//                                 значение bytes<N> - строка в кавычках или 0x<hex>
+//------------------------------------------------------------------------------
+#include <algorithm>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+enum Kind { K_INT, K_FLOAT, K_BITS, K_BYTES };
+
+struct Field {
+  std::string name;   // Имя
+  std::string type;   // Тип в схеме
+  Kind kind;          // Вид поля
+  bool isSigned;      // Знаковое целое
+  bool isBool;        // bool (1 бит)
+  size_t size;        // Размер, байт (для K_BITS - 0)
+  unsigned bits;      // Ширина битового поля
+  std::string def;    // Значение по умолчанию (текст схемы)
+  size_t offset;      // Смещение в структуре (для K_BITS - смещение битового массива)
+  unsigned bitOffset; // Смещение в битовом массиве
+  int order;          // Порядок в схеме
+};
+
+struct Schema {
+  std::string name;
+  bool hash = false;
+  bool crc = false;
+  std::vector<Field> fields; // Поля в порядке размещения (без битовых)
+  std::vector<Field> bitFields;
+  size_t bitsOffset = 0, bitsSize = 0; // Битовый массив
+  size_t size = 0, alignedSize = 0;
+  uint32_t schemaHash = 0;
+};
+
+#ifndef FLASH_PAGE_SIZE
+#define FLASH_PAGE_SIZE 64
+#endif
+
+static std::string trim(const std::string &s) {
+  size_t b = s.find_first_not_of(" \t\r"), e = s.find_last_not_of(" \t\r");
+  return b == std::string::npos ? "" : s.substr(b, e - b + 1);
+}
+
+static std::string capitalize(const std::string &s) {
+  std::string r = s;
+  if (!r.empty() && r[0] >= 'a' && r[0] <= 'z') {
+    r[0] = (char)(r[0] - 'a' + 'A');
+  }
+  return r;
+}
+
+static std::string upper(const std::string &s) {
+  std::string r;
+  for (size_t i = 0; i < s.size(); ++i) {
+    char c = s[i];
+    if (c >= 'A' && c <= 'Z' && i > 0 && s[i - 1] >= 'a' && s[i - 1] <= 'z') {
+      r += '_';
+    }
+    r += (char)(c >= 'a' && c <= 'z' ? c - 'a' + 'A' : c);
+  }
+  return r;
+}
+
+static const char *cType(const Field &f) {
+  if (f.isBool) return "bool";
+  if (f.kind == K_FLOAT) return "float";
+  size_t size = f.kind == K_BITS ? (f.bits <= 8 ? 1 : f.bits <= 16 ? 2 : 4) : f.size;
+  switch (size) {
+  case 1: return f.isSigned ? "int8_t" : "uint8_t";
+  case 2: return f.isSigned ? "int16_t" : "uint16_t";
+  default: return f.isSigned ? "int32_t" : "uint32_t";
+  }
+}
+
+//==============================================================================
+// Разбор типа поля
+//------------------------------------------------------------------------------
+static bool parseType(Field &f) {
+  const std::string &t = f.type;
+  f.isSigned = false;
+  f.isBool = false;
+  f.bits = 0;
+  f.size = 0;
+  if (t == "u8" || t == "i8" || t == "u16" || t == "i16" || t == "u32" || t == "i32") {
+    f.kind = K_INT;
+    f.isSigned = t[0] == 'i';
+    f.size = (size_t)atoi(t.c_str() + 1) / 8;
+  } else if (t == "f32") {
+    f.kind = K_FLOAT;
+    f.size = 4;
+  } else if (t == "bool") {
+    f.kind = K_BITS;
+    f.isBool = true;
+    f.bits = 1;
+  } else if (t[0] == 'u' && t.size() > 1 && t.find_first_not_of("0123456789", 1) == std::string::npos) {
+    f.kind = K_BITS;
+    f.bits = (unsigned)atoi(t.c_str() + 1);
+    return f.bits >= 1 && f.bits <= 31;
+  } else if (t.compare(0, 5, "bytes") == 0 && t.size() > 5) {
+    f.kind = K_BYTES;
+    f.size = (size_t)atoi(t.c_str() + 5);
+    return f.size > 0;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+//==============================================================================
+// Значение по умолчанию bytes<N> в виде массива байт
+//------------------------------------------------------------------------------
+static bool bytesDefault(const Field &f, std::vector<uint8_t> &out) {
+  out.assign(f.size, 0);
+  const std::string &d = f.def;
+  if (d.empty()) {
+    return true;
+  }
+  if (d.size() >= 2 && d.front() == '"' && d.back() == '"') {
+    if (d.size() - 2 > f.size) {
+      return false;
+    }
+    memcpy(out.data(), d.data() + 1, d.size() - 2);
+    return true;
+  }
+  if (d.size() > 2 && d[0] == '0' && (d[1] == 'x' || d[1] == 'X') && d.size() % 2 == 0 && (d.size() - 2) / 2 <= f.size) {
+    for (size_t i = 0; i < (d.size() - 2) / 2; ++i) {
+      out[i] = (uint8_t)strtoul(d.substr(2 + 2 * i, 2).c_str(), nullptr, 16);
+    }
+    return true;
+  }
+  return false;
+}
+
+//==============================================================================
+// Числовое значение по умолчанию (сырые биты little-endian)
+//------------------------------------------------------------------------------
+static bool numericDefault(const Field &f, uint32_t &raw) {
+  if (f.def.empty()) {
+    raw = 0;
+    return true;
+  }
+  char *end;
+  if (f.kind == K_FLOAT) {
+    float v = strtof(f.def.c_str(), &end);
+    memcpy(&raw, &v, 4);
+    return *end == 0;
+  }
+  if (f.isBool) {
+    raw = f.def == "true" || f.def == "1";
+    return f.def == "true" || f.def == "false" || f.def == "1" || f.def == "0";
+  }
+  long long v = strtoll(f.def.c_str(), &end, 0);
+  unsigned bits = f.kind == K_BITS ? f.bits : (unsigned)f.size * 8;
+  long long lo = f.isSigned ? -(1LL << (bits - 1)) : 0;
+  long long hi = f.isSigned ? (1LL << (bits - 1)) - 1 : (1LL << bits) - 1;
+  raw = (uint32_t)v & (bits == 32 ? 0xFFFFFFFFu : ((1u << bits) - 1));
+  return *end == 0 && v >= lo && v <= hi;
+}
+
+//==============================================================================
+// FNV-1a 32 - хеш схемы (раскладка: имена, типы, смещения)
+//------------------------------------------------------------------------------
+static uint32_t fnv1a(const std::string &s) {
+  uint32_t h = 2166136261u;
+  for (unsigned char c : s) {
+    h = (h ^ c) * 16777619u;
+  }
+  return h;
+}
+
+//==============================================================================
+// Разбор схемы и размещение полей
+//------------------------------------------------------------------------------
+static bool parseSchema(const std::string &text, Schema &s, std::string &err) {
+  size_t pos = 0;
+  int lineNo = 0, order = 0;
+  std::vector<Field> plain;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    std::string line = text.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+    pos = eol == std::string::npos ? text.size() : eol + 1;
+    lineNo++;
+    // Комментарий - '#' вне кавычек
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+      if (line[i] == '"') {
+        quoted = !quoted;
+      } else if (line[i] == '#' && !quoted) {
+        line.resize(i);
+        break;
+      }
+    }
+    line = trim(line);
+    if (line.empty()) {
+      continue;
+    }
+    std::string where = "line " + std::to_string(lineNo) + ": ";
+    size_t sp1 = line.find_first_of(" \t");
+    std::string word = line.substr(0, sp1);
+    std::string rest = sp1 == std::string::npos ? "" : trim(line.substr(sp1));
+    if (word == "struct") {
+      s.name = rest;
+      continue;
+    }
+    if (word == "hash" && rest.empty()) {
+      s.hash = true;
+      continue;
+    }
+    if (word == "crc" && rest.empty()) {
+      s.crc = true;
+      continue;
+    }
+    Field f;
+    f.name = word;
+    size_t sp2 = rest.find_first_of(" \t");
+    f.type = rest.substr(0, sp2);
+    f.def = sp2 == std::string::npos ? "" : trim(rest.substr(sp2));
+    f.order = order++;
+    f.offset = 0;
+    f.bitOffset = 0;
+    if (f.type.empty() || !parseType(f)) {
+      err = where + "bad type '" + f.type + "'";
+      return false;
+    }
+    uint32_t raw;
+    std::vector<uint8_t> bytes;
+    if (f.kind == K_BYTES ? !bytesDefault(f, bytes) : !numericDefault(f, raw)) {
+      err = where + "bad default '" + f.def + "'";
+      return false;
+    }
+    if (f.name == "crc" || f.name == "schemaHash" || f.name == "bits") {
+      err = where + "reserved field name '" + f.name + "'";
+      return false;
+    }
+    for (const Field &o : plain) {
+      if (o.name == f.name) {
+        err = where + "duplicate field '" + f.name + "'";
+        return false;
+      }
+    }
+    plain.push_back(f);
+  }
+  if (s.name.empty()) {
+    err = "no 'struct <Name>'";
+    return false;
+  }
+  if (plain.empty()) {
+    err = "no fields";
+    return false;
+  }
+
+  // Битовые поля - в общий массив, остальные - по убыванию размера
+  for (const Field &f : plain) {
+    if (f.kind == K_BITS) {
+      s.bitFields.push_back(f);
+    } else {
+      s.fields.push_back(f);
+    }
+  }
+  unsigned bit = 0;
+  for (Field &b : s.bitFields) {
+    b.bitOffset = bit;
+    bit += b.bits;
+  }
+  s.bitsSize = (bit + 7) / 8;
+  std::stable_sort(s.fields.begin(), s.fields.end(), [](const Field &a, const Field &b) {
+    size_t sa = a.kind == K_BYTES ? 1 : a.size, sb = b.kind == K_BYTES ? 1 : b.size;
+    return sa > sb;
+  });
+
+  size_t offset = s.hash ? 4 : 0;
+  for (Field &f : s.fields) {
+    f.offset = offset;
+    offset += f.size;
+  }
+  s.bitsOffset = offset;
+  offset += s.bitsSize;
+  for (Field &b : s.bitFields) {
+    b.offset = s.bitsOffset;
+  }
+  s.size = offset + (s.crc ? 2 : 0);
+  s.alignedSize = (s.size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+
+  std::string canon = s.name + (s.crc ? ";crc" : "") + (s.hash ? ";hash" : "");
+  for (const Field &f : s.fields) {
+    canon += ";" + f.name + ":" + f.type + "@" + std::to_string(f.offset);
+  }
+  for (const Field &b : s.bitFields) {
+    canon += ";" + b.name + ":" + b.type + "@" + std::to_string(b.offset) + "." + std::to_string(b.bitOffset);
+  }
+  s.schemaHash = fnv1a(canon);
+  return true;
+}
+
+static std::string fmt(const char *f, ...) __attribute__((format(printf, 1, 2)));
+static std::string fmt(const char *f, ...) {
+  char buf[1024];
+  va_list ap;
+  va_start(ap, f);
+  vsnprintf(buf, sizeof(buf), f, ap);
+  va_end(ap);
+  return buf;
+}
+
+static std::string literal(const Field &f) {
+  uint32_t raw = 0;
+  numericDefault(f, raw);
+  if (f.isBool) return raw ? "true" : "false";
+  if (f.kind == K_FLOAT) {
+    float v;
+    memcpy(&v, &raw, 4);
+    return fmt("%.9gf", v);
+  }
+  if (f.isSigned) {
+    unsigned bits = (unsigned)f.size * 8;
+    int32_t v = bits == 32 ? (int32_t)raw : (int32_t)(raw << (32 - bits)) >> (32 - bits);
+    return v == INT32_MIN ? "INT32_MIN" : fmt("%d", v);
+  }
+  return fmt("%uu", raw);
+}
+
+static std::string byteList(const std::vector<uint8_t> &b) {
+  std::string r;
+  for (size_t i = 0; i < b.size(); ++i) {
+    r += fmt("%s0x%02X", i ? ", " : "", b[i]);
+  }
+  return r;
+}
+
+// Значение битового массива по умолчанию
+static std::vector<uint8_t> bitsDefault(const Schema &s) {
+  std::vector<uint8_t> bits(s.bitsSize, 0);
+  for (const Field &b : s.bitFields) {
+    uint32_t raw = 0;
+    numericDefault(b, raw);
+    for (unsigned i = 0; i < b.bits; ++i) {
+      if (raw >> i & 1) {
+        bits[(b.bitOffset + i) / 8] |= (uint8_t)(1u << ((b.bitOffset + i) % 8));
+      }
+    }
+  }
+  return bits;
+}
+
+static std::string header(const std::string &schemaFile, const char *what) {
+  return fmt("// %s\n// Сгенерировано ssgen из %s - не редактировать вручную.\n", what, schemaFile.c_str());
+}
+
+//==============================================================================
+// <Name>.h - структура для прошивки
+//------------------------------------------------------------------------------
+static std::string genStruct(const Schema &s, const std::string &schemaFile) {
+  std::string guard = upper(s.name) + "_GEN_H";
+  std::string o = header(schemaFile, (s.name + ".h").c_str());
+  o += "#ifndef " + guard + "\n#define " + guard + "\n\n#include <stdint.h>\n#include <string.h>\n\n";
+  if (!s.bitFields.empty()) {
+    o += "#ifndef SSGEN_BITS_DEFINED\n#define SSGEN_BITS_DEFINED\n"
+         "// Чтение/запись битового поля шириной width с бита offset массива p\n"
+         "static inline uint32_t ssgenGetBits(const uint8_t *p, unsigned offset, unsigned width) {\n"
+         "  uint32_t v = 0;\n"
+         "  for (unsigned i = 0; i < width; ++i, ++offset) {\n"
+         "    v |= (uint32_t)(p[offset >> 3] >> (offset & 7) & 1) << i;\n"
+         "  }\n"
+         "  return v;\n"
+         "}\n\n"
+         "static inline void ssgenSetBits(uint8_t *p, unsigned offset, unsigned width, uint32_t v) {\n"
+         "  for (unsigned i = 0; i < width; ++i, ++offset) {\n"
+         "    uint8_t mask = (uint8_t)(1u << (offset & 7));\n"
+         "    p[offset >> 3] = (v >> i & 1) ? (uint8_t)(p[offset >> 3] | mask) : (uint8_t)(p[offset >> 3] & ~mask);\n"
+         "  }\n"
+         "}\n#endif\n\n";
+  }
+  o += fmt("// Размер %zu байт, во flash %zu байт (%zu стр. по %d байт)\n", s.size, s.alignedSize,
+           s.alignedSize / FLASH_PAGE_SIZE, FLASH_PAGE_SIZE);
+  o += "struct __attribute__((packed)) " + s.name + " {\n";
+  o += fmt("  static constexpr uint32_t SCHEMA_HASH = 0x%08Xu; // Хеш схемы (раскладки)\n", s.schemaHash);
+  o += fmt("  static constexpr uint32_t SIZE = %zu; // sizeof()\n", s.size);
+  o += fmt("  static constexpr uint32_t ALIGNED_SIZE = %zu; // Размер во flash\n", s.alignedSize);
+  o += fmt("  static constexpr bool USE_CRC = %s; // Параметр useCrc для SettingsStore\n\n",
+           s.crc ? "true" : "false");
+
+  // Значения по умолчанию
+  for (const Field &f : s.fields) {
+    if (f.kind != K_BYTES) {
+      o += fmt("  static constexpr %s %s_DEFAULT = %s;\n", cType(f), upper(f.name).c_str(), literal(f).c_str());
+    }
+  }
+  for (const Field &b : s.bitFields) {
+    o += fmt("  static constexpr %s %s_DEFAULT = %s;\n", cType(b), upper(b.name).c_str(), literal(b).c_str());
+  }
+  o += "\n";
+
+  // Поля
+  if (s.hash) {
+    o += "  uint32_t schemaHash = SCHEMA_HASH; // Хеш схемы, с которой записаны данные\n";
+  }
+  for (const Field &f : s.fields) {
+    if (f.kind == K_BYTES) {
+      std::vector<uint8_t> b;
+      bytesDefault(f, b);
+      o += fmt("  uint8_t %s[%zu] = {%s};\n", f.name.c_str(), f.size, byteList(b).c_str());
+    } else {
+      o += fmt("  %s %s = %s_DEFAULT;\n", cType(f), f.name.c_str(), upper(f.name).c_str());
+    }
+  }
+  if (!s.bitFields.empty()) {
+    std::string comment;
+    for (const Field &b : s.bitFields) {
+      comment += fmt("%s%s:%u@%u", comment.empty() ? "" : ", ", b.name.c_str(), b.bits, b.bitOffset);
+    }
+    o += fmt("  uint8_t bits[%zu] = {%s}; // %s\n", s.bitsSize, byteList(bitsDefault(s)).c_str(), comment.c_str());
+  }
+  if (s.crc) {
+    o += "  uint16_t crc = 0; // CRC16, заполняется SettingsStore::save()\n";
+  }
+  o += "\n";
+
+  // Доступ к полям
+  for (const Field &f : s.fields) {
+    std::string n = capitalize(f.name);
+    if (f.kind == K_BYTES) {
+      o += fmt("  const uint8_t *get%s() const { return %s; }\n", n.c_str(), f.name.c_str());
+      o += fmt("  void set%s(const void *v, size_t len) {\n"
+               "    memset(%s, 0, sizeof(%s));\n"
+               "    memcpy(%s, v, len < sizeof(%s) ? len : sizeof(%s));\n"
+               "  }\n",
+               n.c_str(), f.name.c_str(), f.name.c_str(), f.name.c_str(), f.name.c_str(), f.name.c_str());
+    } else {
+      o += fmt("  %s get%s() const { return %s; }\n", cType(f), n.c_str(), f.name.c_str());
+      o += fmt("  void set%s(%s v) { %s = v; }\n", n.c_str(), cType(f), f.name.c_str());
+    }
+  }
+  for (const Field &b : s.bitFields) {
+    std::string n = capitalize(b.name);
+    if (b.isBool) {
+      o += fmt("  bool get%s() const { return ssgenGetBits(bits, %u, 1) != 0; }\n", n.c_str(), b.bitOffset);
+    } else {
+      o += fmt("  %s get%s() const { return (%s)ssgenGetBits(bits, %u, %u); }\n", cType(b), n.c_str(), cType(b),
+               b.bitOffset, b.bits);
+    }
+    o += fmt("  void set%s(%s v) { ssgenSetBits(bits, %u, %u, (uint32_t)v); }\n", n.c_str(), cType(b), b.bitOffset,
+             b.bits);
+  }
+  o += "};\n\n";
+  o += fmt("static_assert(sizeof(%s) == %s::SIZE, \"%s layout mismatch\");\n\n", s.name.c_str(), s.name.c_str(),
+           s.name.c_str());
+  o += "#endif // " + guard + "\n";
+  return o;
+}
+
+//==============================================================================
+// <Name>Codec.h - хостовый кодировщик/декодер
+//------------------------------------------------------------------------------
+static std::string genCodec(const Schema &s, const std::string &schemaFile) {
+  std::string guard = upper(s.name) + "_CODEC_GEN_H";
+  std::string c = s.name + "Codec";
+  std::string o = header(schemaFile, (c + ".h").c_str());
+  o += "#ifndef " + guard + "\n#define " + guard + "\n\n#include <stdint.h>\n#include <string.h>\n\n";
+  o += "struct " + c + " {\n";
+  o += fmt("  static constexpr uint32_t SCHEMA_HASH = 0x%08Xu;\n", s.schemaHash);
+  o += fmt("  static constexpr uint32_t SIZE = %zu;\n", s.size);
+  o += fmt("  static constexpr uint32_t ALIGNED_SIZE = %zu;\n\n", s.alignedSize);
+
+  // Значения в удобном для хоста виде
+  std::vector<Field> all = s.fields;
+  all.insert(all.end(), s.bitFields.begin(), s.bitFields.end());
+  std::sort(all.begin(), all.end(), [](const Field &a, const Field &b) { return a.order < b.order; });
+  o += "  struct Values {\n";
+  for (const Field &f : all) {
+    if (f.kind == K_BYTES) {
+      o += fmt("    uint8_t %s[%zu];\n", f.name.c_str(), f.size);
+    } else {
+      o += fmt("    %s %s;\n", cType(f), f.name.c_str());
+    }
+  }
+  o += "  };\n\n";
+
+  o += "  // Значения по умолчанию\n  static Values defaults() {\n    Values v;\n";
+  for (const Field &f : all) {
+    if (f.kind == K_BYTES) {
+      std::vector<uint8_t> b;
+      bytesDefault(f, b);
+      o += fmt("    static const uint8_t %sDefault[%zu] = {%s};\n", f.name.c_str(), f.size, byteList(b).c_str());
+      o += fmt("    memcpy(v.%s, %sDefault, sizeof(v.%s));\n", f.name.c_str(), f.name.c_str(), f.name.c_str());
+    } else {
+      o += fmt("    v.%s = %s;\n", f.name.c_str(), literal(f).c_str());
+    }
+  }
+  o += "    return v;\n  }\n\n";
+
+  o += "  // CRC16-CCITT, как SettingsStore::crc16()\n"
+       "  static uint16_t crc16(const uint8_t *p, size_t len) {\n"
+       "    uint16_t crc = 0xFFFF;\n"
+       "    for (size_t i = 0; i < len; ++i) {\n"
+       "      crc ^= (uint16_t)(p[i] << 8);\n"
+       "      for (int j = 0; j < 8; ++j) {\n"
+       "        crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);\n"
+       "      }\n"
+       "    }\n"
+       "    return crc;\n"
+       "  }\n\n";
+
+  o += "  static void put(uint8_t *p, uint32_t v, size_t n) {\n"
+       "    for (size_t i = 0; i < n; ++i) {\n"
+       "      p[i] = (uint8_t)(v >> (8 * i));\n"
+       "    }\n"
+       "  }\n\n"
+       "  static uint32_t get(const uint8_t *p, size_t n) {\n"
+       "    uint32_t v = 0;\n"
+       "    for (size_t i = 0; i < n; ++i) {\n"
+       "      v |= (uint32_t)p[i] << (8 * i);\n"
+       "    }\n"
+       "    return v;\n"
+       "  }\n\n";
+
+  // encode
+  o += "  // Образ области настроек (ALIGNED_SIZE байт), как после SettingsStore::save()\n";
+  o += "  static void encode(const Values &v, uint8_t *img) {\n";
+  o += "    memset(img, 0xFF, ALIGNED_SIZE);\n    memset(img, 0, SIZE);\n    uint32_t raw;\n";
+  if (s.hash) {
+    o += "    put(img, SCHEMA_HASH, 4);\n";
+  }
+  for (const Field &f : s.fields) {
+    if (f.kind == K_BYTES) {
+      o += fmt("    memcpy(img + %zu, v.%s, %zu);\n", f.offset, f.name.c_str(), f.size);
+    } else if (f.kind == K_FLOAT) {
+      o += fmt("    memcpy(&raw, &v.%s, 4);\n    put(img + %zu, raw, 4);\n", f.name.c_str(), f.offset);
+    } else {
+      o += fmt("    put(img + %zu, (uint32_t)v.%s, %zu);\n", f.offset, f.name.c_str(), f.size);
+    }
+  }
+  for (const Field &b : s.bitFields) {
+    o += fmt("    raw = (uint32_t)v.%s;\n", b.name.c_str());
+    o += fmt("    for (unsigned i = 0; i < %u; ++i) {\n"
+             "      img[%zu + (%u + i) / 8] |= (uint8_t)((raw >> i & 1) << ((%u + i) %% 8));\n"
+             "    }\n",
+             b.bits, s.bitsOffset, b.bitOffset, b.bitOffset);
+  }
+  o += "    (void)raw;\n";
+  if (s.crc) {
+    o += fmt("    put(img + %zu, crc16(img, %zu), 2);\n", s.size - 2, s.size - 2);
+  }
+  o += "  }\n\n";
+
+  // decode
+  o += "  // Разбор образа; false - не совпала CRC или хеш схемы\n";
+  o += "  static bool decode(const uint8_t *img, Values &v) {\n";
+  if (s.crc) {
+    o += fmt("    if (get(img + %zu, 2) != crc16(img, %zu)) {\n      return false;\n    }\n", s.size - 2, s.size - 2);
+  }
+  if (s.hash) {
+    o += "    if (get(img, 4) != SCHEMA_HASH) {\n      return false;\n    }\n";
+  }
+  o += "    uint32_t raw;\n";
+  for (const Field &f : s.fields) {
+    if (f.kind == K_BYTES) {
+      o += fmt("    memcpy(v.%s, img + %zu, %zu);\n", f.name.c_str(), f.offset, f.size);
+    } else if (f.kind == K_FLOAT) {
+      o += fmt("    raw = get(img + %zu, 4);\n    memcpy(&v.%s, &raw, 4);\n", f.offset, f.name.c_str());
+    } else {
+      o += fmt("    v.%s = (%s)get(img + %zu, %zu);\n", f.name.c_str(), cType(f), f.offset, f.size);
+    }
+  }
+  for (const Field &b : s.bitFields) {
+    o += fmt("    raw = 0;\n"
+             "    for (unsigned i = 0; i < %u; ++i) {\n"
+             "      raw |= (uint32_t)(img[%zu + (%u + i) / 8] >> ((%u + i) %% 8) & 1) << i;\n"
+             "    }\n",
+             b.bits, s.bitsOffset, b.bitOffset, b.bitOffset);
+    o += fmt("    v.%s = %s;\n", b.name.c_str(), b.isBool ? "raw != 0" : fmt("(%s)raw", cType(b)).c_str());
+  }
+  o += "    (void)raw;\n    return true;\n  }\n};\n\n";
+  o += "#endif // " + guard + "\n";
+  return o;
+}
+
+//==============================================================================
+// <Name>.layout - раскладка для ssdump/ssprov
+//------------------------------------------------------------------------------
+static std::string genLayout(const Schema &s, const std::string &schemaFile) {
+  std::string o = fmt("# %s.layout\n# Сгенерировано ssgen из %s - не редактировать вручную.\n", s.name.c_str(),
+                      schemaFile.c_str());
+  if (s.hash) {
+    o += fmt("schemaHash u32 0x%08X\n", s.schemaHash);
+  }
+  for (const Field &f : s.fields) {
+    std::string def = f.def;
+    if (f.kind == K_BYTES) {
+      std::vector<uint8_t> b;
+      bytesDefault(f, b);
+      def = "0x";
+      for (uint8_t x : b) {
+        def += fmt("%02X", x);
+      }
+    } else if (f.kind == K_INT && def.empty()) {
+      def = "0";
+    }
+    o += fmt("%s %s%s%s\n", f.name.c_str(), f.type.c_str(), def.empty() ? "" : " ", def.c_str());
+  }
+  if (s.bitsSize) {
+    std::string def = "0x";
+    for (uint8_t x : bitsDefault(s)) {
+      def += fmt("%02X", x);
+    }
+    o += fmt("bits bytes%zu %s\n", s.bitsSize, def.c_str());
+  }
+  if (s.crc) {
+    o += "crc u16\n";
+  }
+  return o;
+}
+
+static bool readFile(const std::string &path, std::string &out) {
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    out.append(buf, n);
+  }
+  fclose(f);
+  return true;
+}
+
+int main(int argc, char **argv) {
+  std::string schemaPath, outDir = ".";
+  bool check = false;
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    if (a == "--out" && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (a == "--check") {
+      check = true;
+    } else if (a[0] != '-' && schemaPath.empty()) {
+      schemaPath = a;
+    } else {
+      schemaPath.clear();
+      break;
+    }
+  }
+  if (schemaPath.empty()) {
+    fprintf(stderr, "usage: ssgen SCHEMA [--out DIR] [--check]\n");
+    return 2;
+  }
+  std::string text, err;
+  Schema s;
+  if (!readFile(schemaPath, text) || !parseSchema(text, s, err)) {
+    fprintf(stderr, "%s: %s\n", schemaPath.c_str(), err.empty() ? "cannot read" : err.c_str());
+    return 1;
+  }
+  std::string schemaFile = schemaPath.substr(schemaPath.find_last_of('/') + 1);
+  struct {
+    std::string path, body;
+  } outputs[] = {
+      {outDir + "/" + s.name + ".h", genStruct(s, schemaFile)},
+      {outDir + "/" + s.name + "Codec.h", genCodec(s, schemaFile)},
+      {outDir + "/" + s.name + ".layout", genLayout(s, schemaFile)},
+  };
+  int rc = 0;
+  for (const auto &out : outputs) {
+    if (check) {
+      std::string old;
+      if (!readFile(out.path, old) || old != out.body) {
+        fprintf(stderr, "%s: differs from generated\n", out.path.c_str());
+        rc = 1;
+      }
+      continue;
+    }
+    FILE *f = fopen(out.path.c_str(), "wb");
+    if (f == nullptr || fwrite(out.body.data(), 1, out.body.size(), f) != out.body.size()) {
+      fprintf(stderr, "%s: cannot write\n", out.path.c_str());
+      rc = 1;
+    }
+    if (f != nullptr) {
+      fclose(f);
+    }
+  }
+  if (rc == 0) {
+    printf("%s: %zu bytes, %zu page(s), schema hash 0x%08X\n", s.name.c_str(), s.size, s.alignedSize / FLASH_PAGE_SIZE,
+           s.schemaHash);
+  }
+  return rc;
+}
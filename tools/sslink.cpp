@@ -0,0 +1,229 @@
+//============================================================= (c) A.Kolesov ==
+// sslink.cpp
+// Хостовая сторона двоичного обмена настройками по USART (см. src/SettingsLink.h).
+//
+// Сборка:
+//   g++ -O2 -std=c++17 -DSETTINGS_STORE_HOST -Isrc -Itools tools/sslink.cpp src/*.cpp -o sslink
+//
+// Использование:
+//   sslink [--baud B] info  DEV               - параметры области настроек устройства
+//   sslink [--baud B] read  DEV OUT.bin       - чтение всей области настроек
+//   sslink [--baud B] write DEV IN.bin        - постраничная запись образа (например, из ssprov)
+//   sslink [--baud B] sync  DEV IN.bin        - запись только страниц, отличающихся от устройства
+//   sslink [--baud B] serve DEV IMAGE LENGTH  - эмуляция устройства: SettingsLink над файлом-образом
+//                                               (хост-бэкенд flash) на последовательном порту DEV
+//------------------------------------------------------------------------------
+#include "LinkClient.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+static int portFd = -1;           // Открытый последовательный порт
+static std::vector<uint8_t> txBuf; // Буфер передачи (сбрасывается в flushTx())
+
+static void portPut(uint8_t b) {
+  txBuf.push_back(b);
+}
+
+static void flushTx() {
+  size_t done = 0;
+  while (done < txBuf.size()) {
+    ssize_t n = write(portFd, txBuf.data() + done, txBuf.size() - done);
+    if (n < 0 && errno != EINTR && errno != EAGAIN) {
+      break;
+    }
+    done += n > 0 ? (size_t)n : 0;
+  }
+  txBuf.clear();
+}
+
+//==============================================================================
+// Прием байта с ожиданием
+//  @param timeoutMs - время ожидания (0 - не ждать)
+//  @return          - байт или -1 по таймауту
+//------------------------------------------------------------------------------
+static int portGetWait(int timeoutMs) {
+  struct pollfd pfd = {portFd, POLLIN, 0};
+  if (poll(&pfd, 1, timeoutMs) <= 0) {
+    return -1;
+  }
+  uint8_t b;
+  return read(portFd, &b, 1) == 1 ? b : -1;
+}
+
+static int portGet() {
+  return portGetWait(0);
+}
+
+static speed_t baudConst(long baud) {
+  switch (baud) {
+  case 9600: return B9600;
+  case 19200: return B19200;
+  case 38400: return B38400;
+  case 57600: return B57600;
+  case 115200: return B115200;
+  case 230400: return B230400;
+  case 460800: return B460800;
+  case 921600: return B921600;
+  default: return 0;
+  }
+}
+
+static bool portOpen(const char *dev, long baud) {
+  portFd = open(dev, O_RDWR | O_NOCTTY);
+  if (portFd < 0) {
+    perror(dev);
+    return false;
+  }
+  struct termios tio;
+  if (tcgetattr(portFd, &tio) == 0) {
+    cfmakeraw(&tio);
+    speed_t sp = baudConst(baud);
+    if (sp != 0) {
+      cfsetispeed(&tio, sp);
+      cfsetospeed(&tio, sp);
+    }
+    tio.c_cflag |= CLOCAL | CREAD;
+    tcsetattr(portFd, TCSANOW, &tio);
+    tcflush(portFd, TCIOFLUSH);
+  }
+  return true;
+}
+
+static void portWrite(const uint8_t *data, size_t len) {
+  txBuf.insert(txBuf.end(), data, data + len);
+  flushTx();
+}
+
+static bool readFile(const char *path, std::vector<uint8_t> &img) {
+  FILE *f = fopen(path, "rb");
+  if (f == nullptr) {
+    perror(path);
+    return false;
+  }
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+    img.insert(img.end(), chunk, chunk + n);
+  }
+  fclose(f);
+  return true;
+}
+
+static int cmdInfo(LinkClient &link) {
+  LinkInfo info;
+  if (!link.info(info)) {
+    fprintf(stderr, "no reply\n");
+    return 1;
+  }
+  printf("address 0x%08X, length %u, aligned %u, page %u\n", info.address, info.length, info.alignedSize,
+         info.pageSize);
+  return 0;
+}
+
+static int cmdRead(LinkClient &link, const char *path) {
+  std::vector<uint8_t> img;
+  if (!link.readImage(img)) {
+    fprintf(stderr, "no reply\n");
+    return 1;
+  }
+  FILE *f = fopen(path, "wb");
+  if (f == nullptr || fwrite(img.data(), 1, img.size(), f) != img.size()) {
+    perror(path);
+    return 1;
+  }
+  fclose(f);
+  printf("%zu bytes read\n", img.size());
+  return 0;
+}
+
+static int cmdWrite(LinkClient &link, const char *path, bool delta) {
+  std::vector<uint8_t> img;
+  LinkInfo info;
+  if (!readFile(path, img)) {
+    return 1;
+  }
+  if (!link.info(info)) {
+    fprintf(stderr, "no reply\n");
+    return 1;
+  }
+  if (img.size() != info.alignedSize || info.pageSize != FLASH_PAGE_SIZE) {
+    fprintf(stderr, "%s: %zu bytes, device area is %u (page %u)\n", path, img.size(), info.alignedSize,
+            info.pageSize);
+    return 1;
+  }
+  if (!link.writeImage(img, delta)) {
+    fprintf(stderr, "write failed after %u pages\n", link.pagesWritten);
+    return 1;
+  }
+  printf("%u of %u pages written, %llu bytes sent, %llu received\n", link.pagesWritten,
+         info.alignedSize / FLASH_PAGE_SIZE, (unsigned long long)link.bytesSent,
+         (unsigned long long)link.bytesReceived);
+  return 0;
+}
+
+static int cmdServe(const char *image, size_t length) {
+  size_t aligned = (length + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  if (length == 0 || !SettingsFlash::hostOpen(image, aligned, false)) {
+    fprintf(stderr, "%s: cannot map\n", image);
+    return 1;
+  }
+  std::vector<uint8_t> buf(length);
+  SettingsStore store(buf.data(), length, false, true);
+  SettingsLink link(store, portPut, portGet);
+  printf("serving %s (%zu bytes) at 0x%08X\n", image, length, store.getAddress());
+  fflush(stdout);
+  for (;;) {
+    struct pollfd pfd = {portFd, POLLIN, 0};
+    if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+      break;
+    }
+    if (pfd.revents & (POLLERR | POLLHUP)) {
+      break;
+    }
+    if (link.poll()) {
+      printf("page written\n");
+      fflush(stdout);
+    }
+    flushTx();
+  }
+  SettingsFlash::hostClose();
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  long baud = 115200;
+  int i = 1;
+  if (i + 1 < argc && std::string(argv[i]) == "--baud") {
+    baud = atol(argv[i + 1]);
+    i += 2;
+  }
+  if (argc - i < 2) {
+    fprintf(stderr, "usage: sslink [--baud B] info DEV | read DEV OUT | write|sync DEV IN | serve DEV IMAGE LENGTH\n");
+    return 2;
+  }
+  std::string cmd = argv[i];
+  if (!portOpen(argv[i + 1], baud)) {
+    return 1;
+  }
+  LinkClient link(portWrite, portGetWait);
+  if (cmd == "info") {
+    return cmdInfo(link);
+  }
+  if (cmd == "read" && argc - i >= 3) {
+    return cmdRead(link, argv[i + 2]);
+  }
+  if ((cmd == "write" || cmd == "sync") && argc - i >= 3) {
+    return cmdWrite(link, argv[i + 2], cmd == "sync");
+  }
+  if (cmd == "serve" && argc - i >= 4) {
+    return cmdServe(argv[i + 2], strtoul(argv[i + 3], nullptr, 0));
+  }
+  fprintf(stderr, "unknown command\n");
+  return 2;
+}
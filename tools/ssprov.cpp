@@ -0,0 +1,228 @@
+//============================================================= (c) A.Kolesov ==
+// ssprov.cpp
+// Генерация образов области настроек для заводского программирования
+// (калибровки, серийные номера и т.п. для каждого устройства).
+//
+// Каждый образ побайтно совпадает с тем, что записал бы SettingsStore::save():
+// данные структуры, CRC16 в последних 2 байтах структуры (--crc), заполнение 0xFF
+// до alignedSize; размещение - с адреса flashStartAddr() = FLASH_END_ADDR - alignedSize.
+// С --firmware для каждого устройства формируется общий HEX (прошивка + настройки),
+// чтобы программировать за один проход. Образы генерируются параллельно.
+//
+// Сборка:
+//   g++ -O2 -std=c++17 -pthread tools/ssprov.cpp -o ssprov
+//   (для другой flash: -DFLASH_END_ADDR=0x08008000U -DFLASH_PAGE_SIZE=64)
+//
+// Использование:
+//   ssprov --layout FILE --csv FILE [--crc] [--out DIR] [--firmware FW.hex|FW.bin] [--threads T]
+//     --layout F   раскладка структуры с значениями по умолчанию (см. SettingsImage.h)
+//     --csv F      значения для устройств: первая строка - имена столбцов, столбец "unit" -
+//                  имя устройства (имя выходных файлов), остальные - имена полей раскладки
+//     --crc        последние 2 байта структуры - CRC16 (use_crc в SettingsStore)
+//     --out D      каталог для результатов (по умолчанию текущий)
+//     --firmware F прошивка (.hex или .bin с адреса FLASH_BASE_ADDR) для общего HEX
+//
+// HEX из SDK CH32 скомпонован по отображению flash с нуля (0x00000000), а настройки
+// считаются в адресах 0x08000000. Перекрытие проверяется в обоих отображениях, а
+// настройки в общий HEX пишутся в адресах прошивки, чтобы файл не смешивал два пространства.
+//
+// Результат для каждого устройства: <unit>.bin - образ области (alignedSize байт),
+// <unit>.hex - HEX с настройками по адресу flashStartAddr() (и прошивкой, если задана).
+//------------------------------------------------------------------------------
+#include "IntelHex.h"
+#include "ParallelFor.h"
+#include "SettingsImage.h"
+#include <atomic>
+
+#ifndef FLASH_BASE_ADDR
+#define FLASH_BASE_ADDR 0x08000000U // Начало flash (для прошивки в .bin)
+#endif
+
+//==============================================================================
+// Разбор строки CSV (запятая, поля в кавычках допускаются)
+//------------------------------------------------------------------------------
+static std::vector<std::string> splitCsv(const std::string &line) {
+  std::vector<std::string> cells(1);
+  bool quoted = false;
+  for (size_t i = 0; i < line.size(); ++i) {
+    char c = line[i];
+    if (quoted) {
+      if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+        cells.back() += '"';
+        i++;
+      } else if (c == '"') {
+        quoted = false;
+      } else {
+        cells.back() += c;
+      }
+    } else if (c == '"') {
+      quoted = true;
+    } else if (c == ',') {
+      cells.emplace_back();
+    } else if (c != '\r') {
+      cells.back() += c;
+    }
+  }
+  return cells;
+}
+
+static bool writeFile(const std::string &path, const void *data, size_t len) {
+  FILE *f = fopen(path.c_str(), "wb");
+  if (f == nullptr) {
+    return false;
+  }
+  bool ok = fwrite(data, 1, len, f) == len;
+  return fclose(f) == 0 && ok;
+}
+
+static int usage() {
+  fprintf(stderr, "usage: ssprov --layout FILE --csv FILE [--crc] [--out DIR] [--firmware FW.hex|FW.bin] "
+                  "[--threads T]\n");
+  return 2;
+}
+
+int main(int argc, char **argv) {
+  const char *layoutPath = nullptr, *csvPath = nullptr, *fwPath = nullptr;
+  std::string outDir = ".";
+  bool useCrc = false;
+  unsigned threads = 0;
+  for (int i = 1; i < argc; ++i) {
+    std::string a = argv[i];
+    if (a == "--layout" && i + 1 < argc) {
+      layoutPath = argv[++i];
+    } else if (a == "--csv" && i + 1 < argc) {
+      csvPath = argv[++i];
+    } else if (a == "--out" && i + 1 < argc) {
+      outDir = argv[++i];
+    } else if (a == "--firmware" && i + 1 < argc) {
+      fwPath = argv[++i];
+    } else if (a == "--threads" && i + 1 < argc) {
+      threads = (unsigned)atoi(argv[++i]);
+    } else if (a == "--crc") {
+      useCrc = true;
+    } else {
+      return usage();
+    }
+  }
+  if (layoutPath == nullptr || csvPath == nullptr) {
+    return usage();
+  }
+
+  // Раскладка структуры
+  std::string text, err;
+  std::vector<FieldDef> layout;
+  if (!readTextFile(layoutPath, text) || !parseLayout(text, layout, err)) {
+    fprintf(stderr, "%s: %s\n", layoutPath, err.empty() ? "cannot read" : err.c_str());
+    return 1;
+  }
+  size_t length = layoutLength(layout);
+  size_t aligned = imageAlignedSize(length);
+  uint32_t startAddr = imageStartAddr(length);
+  if (useCrc && length < 2) {
+    fprintf(stderr, "structure too small for CRC\n");
+    return 1;
+  }
+
+  // Значения по устройствам
+  text.clear();
+  if (!readTextFile(csvPath, text)) {
+    fprintf(stderr, "%s: cannot read\n", csvPath);
+    return 1;
+  }
+  std::vector<std::vector<std::string>> rows;
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t eol = text.find('\n', pos);
+    std::string line = text.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+    pos = eol == std::string::npos ? text.size() : eol + 1;
+    if (!line.empty() && line != "\r") {
+      rows.push_back(splitCsv(line));
+    }
+  }
+  if (rows.size() < 2) {
+    fprintf(stderr, "%s: no units\n", csvPath);
+    return 1;
+  }
+  // Столбец CSV -> поле раскладки
+  int unitCol = -1;
+  std::vector<int> colField(rows[0].size(), -1);
+  for (size_t c = 0; c < rows[0].size(); ++c) {
+    if (rows[0][c] == "unit") {
+      unitCol = (int)c;
+      continue;
+    }
+    for (size_t f = 0; f < layout.size(); ++f) {
+      if (layout[f].name == rows[0][c]) {
+        colField[c] = (int)f;
+      }
+    }
+    if (colField[c] < 0) {
+      fprintf(stderr, "%s: column '%s' is not in layout\n", csvPath, rows[0][c].c_str());
+      return 1;
+    }
+  }
+  if (unitCol < 0) {
+    fprintf(stderr, "%s: no 'unit' column\n", csvPath);
+    return 1;
+  }
+
+  // Прошивка
+  HexImage firmware;
+  uint32_t hexAddr = startAddr; // Адрес настроек в пространстве адресов прошивки
+  if (fwPath != nullptr) {
+    std::string fw;
+    if (!readTextFile(fwPath, fw)) {
+      fprintf(stderr, "%s: cannot read\n", fwPath);
+      return 1;
+    }
+    std::string path = fwPath;
+    if (path.size() > 4 && path.compare(path.size() - 4, 4, ".bin") == 0) {
+      firmware.put(FLASH_BASE_ADDR, (const uint8_t *)fw.data(), fw.size());
+    } else if (!parseIntelHex(fw, firmware, err)) {
+      fprintf(stderr, "%s: %s\n", fwPath, err.c_str());
+      return 1;
+    }
+    uint32_t aliasAddr = startAddr - FLASH_BASE_ADDR; // Те же страницы в отображении с нуля
+    if (firmware.overlaps(startAddr, aligned) || firmware.overlaps(aliasAddr, aligned)) {
+      fprintf(stderr, "%s: firmware overlaps settings area 0x%08X..0x%08X\n", fwPath, startAddr,
+              (unsigned)(startAddr + aligned));
+      return 1;
+    }
+    if (!firmware.data.empty() && firmware.base < FLASH_BASE_ADDR) {
+      hexAddr = aliasAddr;
+    }
+  }
+
+  std::atomic<unsigned> failed{0};
+  parallelFor(rows.size() - 1, threads, [&](size_t i, unsigned) {
+    const std::vector<std::string> &row = rows[i + 1];
+    const std::string unit = (size_t)unitCol < row.size() ? row[unitCol] : "";
+    std::vector<uint8_t> data(length, 0);
+    bool ok = !unit.empty();
+    for (size_t f = 0; f < layout.size() && ok; ++f) {
+      ok = encodeField(layout[f], layout[f].def, data.data());
+    }
+    for (size_t c = 0; c < row.size() && c < colField.size() && ok; ++c) {
+      if (colField[c] >= 0 && !row[c].empty()) {
+        ok = encodeField(layout[colField[c]], row[c], data.data());
+      }
+    }
+    if (!ok) {
+      fprintf(stderr, "%s: row %zu: bad value\n", csvPath, i + 2);
+      failed++;
+      return;
+    }
+    std::vector<uint8_t> img = buildImage(data.data(), length, useCrc);
+    HexImage hex = firmware;
+    hex.put(hexAddr, img.data(), img.size());
+    std::string hexText = formatIntelHex(hex);
+    std::string base = outDir + "/" + unit;
+    if (!writeFile(base + ".bin", img.data(), img.size()) || !writeFile(base + ".hex", hexText.data(), hexText.size())) {
+      fprintf(stderr, "%s: cannot write\n", base.c_str());
+      failed++;
+    }
+  });
+
+  printf("%zu units, %zu bytes at 0x%08X, %u failed\n", rows.size() - 1, aligned, startAddr, failed.load());
+  return failed ? 1 : 0;
+}
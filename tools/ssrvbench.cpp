@@ -0,0 +1,236 @@
+//============================================================= (c) A.Kolesov ==
+// ssrvbench.cpp
+// Замеры горячих путей библиотеки в числе выполненных команд RV32EC под симулятором
+// RvSim, со сравнением с сохраненным эталоном. Число команд детерминировано, поэтому
+// замер можно гонять на каждом коммите без платы - для тех операций, эталон которых
+// получен тем же компилятором (в tools/rvbench/ пока только эталон ассемблерных ядер).
+//
+// Сборка драйвера:
+//   g++ -O2 -std=c++17 -Isrc -Itools tools/ssrvbench.cpp src/SettingsKernels.cpp -o ssrvbench
+//
+// Сборка библиотеки под симулятор (C++-ядра; для ассемблерных добавить
+// -DSETTINGS_STORE_ASM src/SettingsStoreAsm.S):
+//   riscv-none-elf-g++ -march=rv32ec -mabi=ilp32e -Os -mno-relax -fno-exceptions -fno-rtti
+//     -Itools/rvbench -Isrc tools/rvbench/RvBench.cpp src/*.cpp -nostartfiles --specs=nano.specs
+//     -Wl,--no-relax -T tools/rvbench/rvbench.ld -o rvbench.elf
+// Только ассемблерные ядра (без C++-компилятора под RISC-V) - объектный файл, как для ssrvcheck:
+//   cpp -P -DSETTINGS_STORE_ASM src/SettingsStoreAsm.S | llvm-mc -triple=riscv32 -mattr=+e,+c,-relax -filetype=obj -o kernels.o
+//
+// Использование:
+//   ssrvbench <elf> [--baseline file] [--update] [--tolerance pct]
+//     --baseline  - файл эталона (строки "<операция> <размер> <команд>")
+//     --update    - записать текущие результаты в файл эталона
+//     --tolerance - допустимый рост числа команд, % (по умолчанию 0)
+// Код возврата 1, если какая-то операция стала дороже эталона сверх допуска, а с --baseline -
+// и если для замеренной операции нет строки в эталоне или строка эталона не замерена:
+// без эталона операция ничего не проверяет. Операции, для которых в файле нет символа
+// (например, bench_* в объекте с одними ядрами), не замеряются.
+//------------------------------------------------------------------------------
+#include "RvSim.h"
+#include "SettingsKernels.h"
+#include <map>
+#include <stdlib.h>
+
+#define FLASH_PAGE_SIZE 64         // Как в SettingsFlash.h
+#define FLASH_END_ADDR 0x08004000U // Как в SettingsFlash.h
+
+static const uint32_t BUF_A = RvSim::RAM_BASE + 0x8000; // Буферы выше .data/.bss сборки
+static const uint32_t BUF_B = RvSim::RAM_BASE + 0xA000;
+static const uint32_t BUF_MAX = 0x2000;
+
+// Виды операций: как готовить данные и с какими аргументами вызывать
+enum OpKind { OP_CRC, OP_COPY, OP_COMPARE, OP_BLANK, OP_INIT, OP_LOAD, OP_SAVE_SKIP, OP_SAVE, OP_FRAME };
+
+struct Op {
+  const char *name;   // Имя в отчете и эталоне
+  const char *symbol; // Вызываемая функция
+  OpKind kind;
+  uint32_t sizes[4];  // Размеры данных
+  int count;          // Сколько размеров из sizes замерять
+};
+
+static const Op ops[] = {
+    {"crc16", "ss_crc16", OP_CRC, {16, 64, 256, 1024}, 4},
+    {"copy", "ss_copy", OP_COPY, {16, 64, 256, 1024}, 4},
+    {"compare", "ss_compare", OP_COMPARE, {16, 64, 256, 1024}, 4},
+    {"blank", "ss_blank", OP_BLANK, {16, 64, 256, 1024}, 4},
+    {"store-init", "bench_store_init", OP_INIT, {64, 256, 1024}, 3},
+    {"load", "bench_load", OP_LOAD, {64, 256, 1024}, 3},
+    {"save-skip", "bench_save", OP_SAVE_SKIP, {64, 256, 1024}, 3},
+    {"save", "bench_save", OP_SAVE, {64, 256, 1024}, 3},
+    {"frame-parse", "bench_frame", OP_FRAME, {0, 16, 64}, 3},
+};
+
+//==============================================================================
+// Образ настроек размера size с верной CRC в последних 2 байтах
+//------------------------------------------------------------------------------
+static void makeImage(uint8_t *p, uint32_t size) {
+  for (uint32_t i = 0; i < size - 2; ++i) {
+    p[i] = (uint8_t)(i * 7 + 3);
+  }
+  uint16_t crc = ss_crc16(0xFFFF, p, size - 2);
+  memcpy(p + size - 2, &crc, 2);
+}
+
+//==============================================================================
+// Подготовка данных и вызов одной операции
+//  @return - число выполненных команд; при ошибке симулятора - выход из программы
+//------------------------------------------------------------------------------
+static uint64_t measure(RvSim &sim, uint32_t fn, OpKind kind, uint32_t size) {
+  uint8_t *a = sim.at(BUF_A, BUF_MAX), *b = sim.at(BUF_B, BUF_MAX);
+  uint32_t area = FLASH_END_ADDR - (size + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * FLASH_PAGE_SIZE;
+  uint8_t *flash = sim.at(area, size);
+  makeImage(a, size < 2 ? 2 : size);
+  memcpy(b, a, BUF_MAX > size ? size : BUF_MAX);
+
+  switch (kind) {
+  case OP_CRC:
+    sim.call(fn, {0xFFFF, BUF_A, size});
+    break;
+  case OP_COPY:
+    sim.call(fn, {BUF_B, BUF_A, size});
+    break;
+  case OP_COMPARE: // Совпадающие данные - худший случай, без раннего выхода
+    sim.call(fn, {BUF_A, BUF_B, size});
+    break;
+  case OP_BLANK:
+    memset(a, 0xFF, size);
+    sim.call(fn, {BUF_A, size});
+    break;
+  case OP_INIT:
+    sim.call(fn, {BUF_A, size});
+    break;
+  case OP_LOAD: // Во flash - верный образ
+    memcpy(flash, a, size);
+    sim.call(fn, {BUF_A, size});
+    break;
+  case OP_SAVE_SKIP: // Данные не изменились - только сравнение
+    memcpy(flash, a, size);
+    sim.call(fn, {BUF_A, size});
+    break;
+  case OP_SAVE: // Данные изменились - стирание и программирование через заглушку
+    memset(flash, 0xFF, size);
+    a[0] ^= 0x5A;
+    sim.call(fn, {BUF_A, size});
+    break;
+  case OP_FRAME: { // Кадр LINK_CMD_WRITE с size байт данных
+    uint8_t *f = b;
+    uint8_t head[3] = {0x03, (uint8_t)size, (uint8_t)(size >> 8)};
+    uint16_t crc = ss_crc16(ss_crc16(0xFFFF, head, 3), a, size);
+    f[0] = 0xA5;
+    memcpy(f + 1, head, 3);
+    memcpy(f + 4, a, size);
+    f[4 + size] = (uint8_t)crc;
+    f[5 + size] = (uint8_t)(crc >> 8);
+    uint32_t frames = sim.call(fn, {BUF_B, size + 6});
+    if (sim.error.empty() && frames != 1) {
+      sim.error = "frame not accepted";
+    }
+    break;
+  }
+  }
+  if (!sim.error.empty()) {
+    fprintf(stderr, "simulator: %s\n", sim.error.c_str());
+    exit(1);
+  }
+  return sim.instret;
+}
+
+int main(int argc, char **argv) {
+  const char *elf = nullptr, *baselinePath = nullptr;
+  bool update = false;
+  double tolerance = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (!strcmp(argv[i], "--baseline") && i + 1 < argc) {
+      baselinePath = argv[++i];
+    } else if (!strcmp(argv[i], "--update")) {
+      update = true;
+    } else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc) {
+      tolerance = atof(argv[++i]);
+    } else {
+      elf = argv[i];
+    }
+  }
+  if (!elf || (update && !baselinePath)) {
+    fprintf(stderr, "usage: ssrvbench <elf> [--baseline file] [--update] [--tolerance pct]\n");
+    return 2;
+  }
+  RvSim sim;
+  if (!sim.load(elf)) {
+    fprintf(stderr, "%s: %s\n", elf, sim.error.c_str());
+    return 1;
+  }
+
+  // Эталон: "<операция> <размер> <команд>", строки с '#' - комментарии
+  std::map<std::string, uint64_t> baseline;
+  if (baselinePath && !update) {
+    FILE *f = fopen(baselinePath, "r");
+    if (!f) {
+      fprintf(stderr, "cannot open %s\n", baselinePath);
+      return 1;
+    }
+    char line[128], name[64];
+    unsigned size;
+    unsigned long long count;
+    while (fgets(line, sizeof(line), f)) {
+      if (line[0] != '#' && sscanf(line, "%63s %u %llu", name, &size, &count) == 3) {
+        baseline[std::string(name) + " " + std::to_string(size)] = count;
+      }
+    }
+    fclose(f);
+  }
+
+  FILE *out = nullptr;
+  if (update) {
+    out = fopen(baselinePath, "w");
+    if (!out) {
+      fprintf(stderr, "cannot write %s\n", baselinePath);
+      return 1;
+    }
+    const char *name = strrchr(elf, '/') ? strrchr(elf, '/') + 1 : elf;
+    fprintf(out, "# ssrvbench %s: <operation> <size> <instret>\n", name);
+  }
+
+  int regressions = 0, missing = 0;
+  printf("%-12s %6s %10s %10s %8s\n", "operation", "size", "instret", "baseline", "delta");
+  for (const Op &op : ops) {
+    uint32_t fn = sim.symbol(op.symbol);
+    if (!fn) {
+      continue;
+    }
+    for (int i = 0; i < op.count; ++i) {
+      uint32_t size = op.sizes[i];
+      uint64_t count = measure(sim, fn, op.kind, size);
+      printf("%-12s %6u %10llu", op.name, size, (unsigned long long)count);
+      if (out) {
+        fprintf(out, "%s %u %llu\n", op.name, size, (unsigned long long)count);
+      }
+      auto it = baseline.find(std::string(op.name) + " " + std::to_string(size));
+      if (it != baseline.end()) {
+        double delta = 100.0 * ((double)count - (double)it->second) / (double)it->second;
+        bool worse = delta > tolerance;
+        regressions += worse;
+        printf(" %10llu %+7.1f%%%s", (unsigned long long)it->second, delta, worse ? "  REGRESSION" : "");
+        baseline.erase(it);
+      } else if (baselinePath && !update) {
+        missing++;
+        printf(" %10s %8s  NO BASELINE", "-", "-");
+      }
+      printf("\n");
+    }
+  }
+  if (out) {
+    fclose(out);
+  }
+  for (const auto &entry : baseline) { // Строки эталона, которые не удалось замерить
+    printf("%-19s %10s %10llu %8s  NOT MEASURED\n", entry.first.c_str(), "-", (unsigned long long)entry.second, "-");
+    missing++;
+  }
+  if (regressions) {
+    printf("%d regression(s)\n", regressions);
+  }
+  if (missing) {
+    printf("%d operation(s) without a baseline match\n", missing);
+  }
+  return regressions || missing ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+//============================================================= (c) A.Kolesov ==
+// ssrvcheck.cpp
+// Проверка ассемблерных ядер RV32EC (src/SettingsStoreAsm.S) в симуляторе RvSim:
+// результаты сверяются с C++-версиями (src/SettingsKernels.cpp) на случайных данных,
+// длинах и выравниваниях, затем печатается число выполненных команд по размерам.
+//
+// Сборка:
+//   g++ -O2 -std=c++17 -Isrc -Itools tools/ssrvcheck.cpp src/SettingsKernels.cpp -o ssrvcheck
+//
+// Объект с ядрами (любым из способов):
+//   riscv-none-elf-gcc -march=rv32ec -mabi=ilp32e -mno-relax -DSETTINGS_STORE_ASM -c src/SettingsStoreAsm.S -o kernels.o
+//   cpp -P -DSETTINGS_STORE_ASM src/SettingsStoreAsm.S | llvm-mc -triple=riscv32 -mattr=+e,+c,-relax -filetype=obj -o kernels.o
+//
+// Использование:
+//   ssrvcheck kernels.o [iterations]
+//------------------------------------------------------------------------------
+#include "RvSim.h"
+#include "SettingsKernels.h"
+#include <stdlib.h>
+
+static const uint32_t BUF_A = RvSim::RAM_BASE + 0x1000; // Буферы данных в RAM симулятора
+static const uint32_t BUF_B = RvSim::RAM_BASE + 0x4000;
+static const uint32_t MAX_LEN = 0x2000;
+
+//==============================================================================
+// Один вызов ядра в симуляторе с проверкой ошибок
+//------------------------------------------------------------------------------
+static uint32_t run(RvSim &sim, uint32_t fn, std::initializer_list<uint32_t> args) {
+  uint32_t r = sim.call(fn, args);
+  if (!sim.error.empty()) {
+    fprintf(stderr, "simulator: %s\n", sim.error.c_str());
+    exit(1);
+  }
+  return r;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: ssrvcheck kernels.o [iterations]\n");
+    return 2;
+  }
+  int iterations = argc > 2 ? atoi(argv[2]) : 2000;
+  RvSim sim;
+  if (!sim.load(argv[1])) {
+    fprintf(stderr, "%s: %s\n", argv[1], sim.error.c_str());
+    return 1;
+  }
+  uint32_t fnCopy = sim.symbol("ss_copy"), fnCompare = sim.symbol("ss_compare");
+  uint32_t fnBlank = sim.symbol("ss_blank"), fnCrc = sim.symbol("ss_crc16");
+  if (!fnCopy || !fnCompare || !fnBlank || !fnCrc) {
+    fprintf(stderr, "%s: kernel symbols not found (assembled without SETTINGS_STORE_ASM?)\n", argv[1]);
+    return 1;
+  }
+
+  uint8_t *a = sim.at(BUF_A, MAX_LEN), *b = sim.at(BUF_B, MAX_LEN);
+  uint8_t ref[MAX_LEN];
+  int errors = 0;
+  srand(1);
+  for (int it = 0; it < iterations; ++it) {
+    uint32_t len = rand() % 300;
+    uint32_t offA = rand() % 4, offB = rand() % 4;
+    if (it % 3 == 0) {
+      offA = offB = 0; // Треть проверок - на выровненных адресах (пословные циклы)
+    }
+    for (uint32_t i = 0; i < len + 8; ++i) {
+      a[i] = (uint8_t)rand();
+      b[i] = (uint8_t)rand();
+    }
+
+    // Копирование: включая байты вокруг приемника, которые трогать нельзя
+    memcpy(ref, b, len + 8);
+    ss_copy(ref + offB, a + offA, len);
+    run(sim, fnCopy, {BUF_B + offB, BUF_A + offA, len});
+    if (memcmp(ref, b, len + 8) != 0) {
+      printf("ss_copy mismatch: len %u, offsets %u/%u\n", len, offA, offB);
+      errors++;
+    }
+
+    // Сравнение: совпадающие данные и отличие в случайном байте
+    if (len && rand() % 2) {
+      b[offB + rand() % len] ^= (uint8_t)(1 + rand() % 255);
+    }
+    uint32_t r = run(sim, fnCompare, {BUF_A + offA, BUF_B + offB, len});
+    if (r != (uint32_t)ss_compare(a + offA, b + offB, len)) {
+      printf("ss_compare mismatch: len %u, offsets %u/%u\n", len, offA, offB);
+      errors++;
+    }
+
+    // Проверка на 0xFF: пустой буфер и буфер с одним испорченным байтом
+    memset(a + offA, 0xFF, len);
+    if (len && rand() % 2) {
+      a[offA + rand() % len] = (uint8_t)(rand() % 255);
+    }
+    r = run(sim, fnBlank, {BUF_A + offA, len});
+    if (r != (uint32_t)ss_blank(a + offA, len)) {
+      printf("ss_blank mismatch: len %u, offset %u\n", len, offA);
+      errors++;
+    }
+
+    // CRC16 от случайного начального значения
+    uint16_t crc = (uint16_t)rand();
+    r = run(sim, fnCrc, {crc, BUF_B + offB, len});
+    if (r != ss_crc16(crc, b + offB, len)) {
+      printf("ss_crc16 mismatch: len %u, offset %u\n", len, offB);
+      errors++;
+    }
+  }
+  printf("%d iterations, %d mismatches\n", iterations, errors);
+
+  // Число команд по размерам (выровненные буферы, данные совпадают, flash "чистая")
+  printf("\n%-12s", "instret");
+  static const uint32_t sizes[] = {16, 64, 256, 1024};
+  for (uint32_t size : sizes) {
+    printf("%10u", size);
+  }
+  printf("\n");
+  memset(a, 0xFF, MAX_LEN);
+  memset(b, 0xFF, MAX_LEN);
+  struct {
+    const char *name;
+    uint32_t fn;
+    int args;
+  } kernels[] = {{"ss_copy", fnCopy, 3}, {"ss_compare", fnCompare, 3}, {"ss_blank", fnBlank, 2}, {"ss_crc16", fnCrc, 3}};
+  for (auto &k : kernels) {
+    printf("%-12s", k.name);
+    for (uint32_t size : sizes) {
+      if (k.fn == fnCrc) {
+        run(sim, k.fn, {0xFFFF, BUF_A, size});
+      } else if (k.args == 2) {
+        run(sim, k.fn, {BUF_A, size});
+      } else {
+        run(sim, k.fn, {BUF_B, BUF_A, size});
+      }
+      printf("%10llu", (unsigned long long)sim.instret);
+    }
+    printf("\n");
+  }
+  return errors ? 1 : 0;
+}